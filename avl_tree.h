@@ -1,43 +1,75 @@
 #ifndef AVL_TREE_H  // Check if AVL_TREE_H is not defined, to prevent multiple inclusions of this header file
 #define AVL_TREE_H  // Define AVL_TREE_H to prevent multiple inclusions in the future
 
+#include "binary_io.h"  // Include the buffered binary reader/writer and the Serializer<T> traits
+#include "epoch_reclaimer.h"  // Include epoch-based reclamation for persistent (path-copying) trees
+#include <atomic>  // Include atomics for publishing the root to concurrent readers
 #include <memory>  // Include memory management library for smart pointers (e.g., shared_ptr)
 #include <string>  // Include the string library for string manipulation
-#include <vector>  // Include the vector library for using dynamic arrays (not used directly, but often included for such purposes)
+#include <vector>  // Include the vector library for using dynamic arrays (used as the iterator stack)
 #include <fstream>  // Include the fstream library for file input/output operations
 #include <unordered_map>  // Include the unordered_map library to use hash maps for efficient key-value storage
+#include <algorithm>  // Include algorithms such as std::max used when updating node heights
+#include <iterator>  // Include iterator utilities for accepting arbitrary sorted ranges
+#include <type_traits>  // Include type traits for detecting forward-iterable input ranges
+#include <stdexcept>  // Include standard exceptions for reporting unsorted input and unreadable files
+#include <utility>  // Include utilities such as std::pair and std::move
+#include <thread>  // Include threads for decoding chunks of a tree file in parallel
+#include <exception>  // Include exception_ptr for reporting errors from decoding threads
+#include <mutex>  // Include mutexes for recording the first decoding error
+#include <cstring>  // Include memcmp for recognizing the chunk table
+
+// Tree files end with a chunk table so a loader can decode ranges of entries on several threads: the byte
+// offset of every treeFileChunkEntries-th entry (u64 each), the entries per chunk, the chunk count, then
+// treeFileChunkMagic. Readers that stop after the last entry never see the table, and files without it
+// still load, one entry after another.
+constexpr uint64_t treeFileChunkEntries = 4096;  // Entries per independently decodable chunk
+constexpr char treeFileChunkMagic[8] = {'A', 'V', 'L', 'C', 'H', 'N', 'K', '1'};  // Marks a file with a chunk table
+
+// Collects the chunk table while entries are written, and finds it again in a loaded file
+class TreeFileChunks {
+private:
+    std::vector<uint64_t> offsets;  // Byte offset of the first entry of each chunk
+    uint64_t entries = 0;  // Entries seen so far
 
-// Template function to save an unordered_map to a binary file
-template<typename K, typename V>
-void saveMap(const std::unordered_map<K, V>& map, std::ofstream& out) {
-    size_t size = map.size();  // Get the size of the map
-    out.write(reinterpret_cast<const char*>(&size), sizeof(size));  // Write the size of the map to the file
-
-    // Iterate over each key-value pair in the map
-    for (const auto& pair : map) {
-        size_t keyLength = pair.first.length();  // Get the length of the key (string)
-        out.write(reinterpret_cast<const char*>(&keyLength), sizeof(keyLength));  // Write key length to file
-        out.write(pair.first.c_str(), keyLength);  // Write the key to the file
-        out.write(reinterpret_cast<const char*>(&pair.second), sizeof(pair.second));  // Write the value to the file
-    }
-}
-
-// Template function to load an unordered_map from a binary file
-template<typename K, typename V>
-void loadMap(std::unordered_map<K, V>& map, std::ifstream& in) {
-    size_t size;
-    in.read(reinterpret_cast<char*>(&size), sizeof(size));  // Read the size of the map from the file
-    map.clear();  // Clear the current map to reload data
-    for (size_t i = 0; i < size; i++) {  // Loop to read each key-value pair from the file
-        size_t keyLength;
-        in.read(reinterpret_cast<char*>(&keyLength), sizeof(keyLength));  // Read the length of the key
-        std::string key(keyLength, '\0');  // Create a string to hold the key
-        in.read(&key[0], keyLength);  // Read the key from the file into the string
-        V value;  // Create a variable to hold the value
-        in.read(reinterpret_cast<char*>(&value), sizeof(value));  // Read the value from the file
-        map[key] = value;  // Insert the key-value pair into the map
-    }
-}
+public:
+    // Call before writing each entry
+    void beforeEntry(const BinaryWriter& out) {
+        if (entries++ % treeFileChunkEntries == 0) offsets.push_back(out.position());
+    }
+
+    // Call after the last entry to append the table
+    void write(BinaryWriter& out) const {
+        for (uint64_t offset : offsets) out.writeFixed(offset);
+        out.writeFixed(treeFileChunkEntries);
+        out.writeFixed<uint64_t>(offsets.size());
+        out.writeBytes(treeFileChunkMagic, sizeof(treeFileChunkMagic));
+    }
+
+    // Reads the table at the end of a file image holding count entries. Returns false, leaving the
+    // arguments unspecified, if the file has no usable table. tableStart is where the entries end.
+    static bool read(const char* data, size_t size, uint64_t count, std::vector<uint64_t>& chunkOffsets,
+                     uint64_t& chunkEntries, uint64_t& tableStart) {
+        const size_t footer = 2 * sizeof(uint64_t) + sizeof(treeFileChunkMagic);
+        if (size < footer || std::memcmp(data + size - sizeof(treeFileChunkMagic), treeFileChunkMagic, sizeof(treeFileChunkMagic)) != 0) {
+            return false;
+        }
+        BinaryReader trailer(data + size - footer, footer);
+        chunkEntries = trailer.readFixed<uint64_t>();
+        uint64_t chunks = trailer.readFixed<uint64_t>();
+        if (chunkEntries == 0 || chunks != (count + chunkEntries - 1) / chunkEntries || chunks > (size - footer) / sizeof(uint64_t)) {
+            return false;
+        }
+        tableStart = size - footer - chunks * sizeof(uint64_t);
+        BinaryReader table(data + tableStart, chunks * sizeof(uint64_t));
+        chunkOffsets.resize(chunks);
+        for (auto& offset : chunkOffsets) {
+            offset = table.readFixed<uint64_t>();
+            if (offset > tableStart) return false;
+        }
+        return std::is_sorted(chunkOffsets.begin(), chunkOffsets.end());
+    }
+};
 
 // Template class to represent a node in the AVL tree
 template<typename T>
@@ -53,18 +85,14 @@ public:
     AVLNode(const std::string& k, const T& v)
         : key(k), value(v), height(1), left(nullptr), right(nullptr) {}
 
-    // Method to save the node's data to a file
-    void save(std::ofstream& out) const {
-        if constexpr (std::is_same_v<T, std::unordered_map<std::string, int>>) {  // Check if value is a map
-            saveMap(value, out);  // Save the map using the saveMap function
-        }
+    // Method to save the node's value; Serializer<T> decides the encoding
+    void save(BinaryWriter& out) const {
+        Serializer<T>::write(out, value);
     }
 
-    // Method to load the node's data from a file
-    void load(std::ifstream& in) {
-        if constexpr (std::is_same_v<T, std::unordered_map<std::string, int>>) {  // Check if value is a map
-            loadMap(value, in);  // Load the map using the loadMap function
-        }
+    // Method to load the node's value written by save
+    void load(BinaryReader& in) {
+        Serializer<T>::read(in, value);
     }
 };
 
@@ -73,6 +101,10 @@ template<typename T>
 class AVLTree {
 private:
     std::shared_ptr<AVLNode<T>> root;  // Root of the AVL tree
+    std::vector<std::shared_ptr<std::vector<AVLNode<T>>>> arenas;  // Contiguous node blocks created by bulk loading
+    std::atomic<const AVLNode<T>*> published{nullptr};  // Root visible to readers; equals root.get() between writes
+    bool persistent = false;  // When set, writes path-copy instead of mutating nodes readers may hold
+    EpochReclaimer reclaimer;  // Keeps replaced versions alive until no pinned reader can reach them
 
     // Helper method to get the height of a node
     int height(std::shared_ptr<AVLNode<T>> node) {
@@ -120,6 +152,10 @@ private:
     std::shared_ptr<AVLNode<T>> insert(std::shared_ptr<AVLNode<T>> node, const std::string& key, const T& value) {
         if (!node) return std::make_shared<AVLNode<T>>(key, value);  // If the node is nullptr, create a new node
 
+        // Persistent trees never modify a published node: copy each node on the search path instead.
+        // AVL rotations only touch nodes on that path, so the rebalancing below works on copies too.
+        if (persistent) node = std::make_shared<AVLNode<T>>(*node);
+
         if (key < node->key)  // If the key is smaller than the current node's key, insert into the left subtree
             node->left = insert(node->left, key, value);
         else if (key > node->key)  // If the key is greater than the current node's key, insert into the right subtree
@@ -162,24 +198,269 @@ private:
         return find(node->right, key);  // Otherwise, search the right subtree
     }
 
-    // Helper method to save the AVL tree to a file
-    void save(std::ofstream& out) const {
-        if (root) {
-            root->save(out);  // If the tree is not empty, save the root node
+    // Helper method that links arena[lo, hi) into a perfectly balanced subtree and returns its root.
+    // Arena nodes are owned by the arena itself, so the links are non-owning aliases with no refcount.
+    static std::shared_ptr<AVLNode<T>> linkBalanced(std::vector<AVLNode<T>>& arena, size_t lo, size_t hi) {
+        if (lo >= hi) return nullptr;
+        size_t mid = lo + (hi - lo) / 2;  // Middle key becomes the subtree root
+        AVLNode<T>& node = arena[mid];
+        node.left = linkBalanced(arena, lo, mid);  // Children are linked first so heights are known bottom-up
+        node.right = linkBalanced(arena, mid + 1, hi);
+        node.height = 1 + std::max(node.left ? node.left->height : 0, node.right ? node.right->height : 0);
+        return std::shared_ptr<AVLNode<T>>(std::shared_ptr<AVLNode<T>>(), &node);  // Aliasing an empty owner
+    }
+
+    // Helper method that replaces the tree with the nodes of an arena already in strictly ascending key order
+    void adoptArena(std::vector<AVLNode<T>>&& sorted) {
+        for (size_t i = 1; i < sorted.size(); i++) {
+            if (!(sorted[i - 1].key < sorted[i].key)) {
+                throw std::invalid_argument("AVLTree::bulkLoad requires strictly ascending keys");
+            }
+        }
+        auto arena = std::make_shared<std::vector<AVLNode<T>>>(std::move(sorted));
+        auto previousRoot = std::move(root);
+        auto previousArenas = std::move(arenas);
+        root = linkBalanced(*arena, 0, arena->size());
+        arenas.clear();
+        arenas.push_back(std::move(arena));
+        publish(std::make_shared<std::pair<std::shared_ptr<AVLNode<T>>, decltype(arenas)>>(
+            std::move(previousRoot), std::move(previousArenas)));  // The previous contents are no longer reachable
+    }
+
+    // Helper method that makes the current root visible to readers and retires what the old version owned
+    void publish(std::shared_ptr<void> previous) {
+        published.store(root.get());
+        if (persistent) {
+            reclaimer.retire(std::move(previous));  // Pinned readers may still be walking the old version
+            reclaimer.reclaim();
         }
     }
 
-    // Helper method to load the AVL tree from a file
-    void load(std::ifstream& in) {
-        if (root) {
-            root->load(in);  // If the tree is not empty, load the root node
+    // Helper method to find a node by key without touching reference counts
+    static const AVLNode<T>* findAt(const AVLNode<T>* node, const std::string& key) {
+        while (node && node->key != key) {
+            node = key < node->key ? node->left.get() : node->right.get();
         }
+        return node;
+    }
+
+    // Helper method to save the AVL tree to a file as a node count followed by keys and values in order,
+    // then the chunk table
+    void save(BinaryWriter& out) const {
+        uint64_t count = 0;
+        for (auto it = begin(); it != end(); ++it) count++;  // Count nodes so the loader can size its arena
+        out.writeFixed(count);
+        TreeFileChunks chunks;
+        for (const auto& node : *this) {
+            chunks.beforeEntry(out);
+            out.writeString(node.key);  // Write the key
+            node.save(out);  // Write the node's value
+        }
+        chunks.write(out);
+    }
+
+    // Helper method to load the AVL tree from a file image written by save, reading nodes straight into
+    // one arena. With a chunk table and more than one thread, chunks are decoded concurrently.
+    void load(const char* data, size_t size, size_t threads) {
+        BinaryReader header(data, size);
+        uint64_t count = header.readFixed<uint64_t>();  // Read the number of nodes
+        if (!header || count > size) throw std::runtime_error("AVLTree: truncated index file");  // Every entry takes bytes
+        std::vector<AVLNode<T>> arena;
+        arena.reserve(static_cast<size_t>(count));  // One allocation for every node, laid out in key order
+
+        std::vector<uint64_t> chunkOffsets;
+        uint64_t chunkEntries = 0, tableStart = 0;
+        if (threads > 1 && count > treeFileChunkEntries &&
+            TreeFileChunks::read(data, size, count, chunkOffsets, chunkEntries, tableStart)) {
+            for (uint64_t i = 0; i < count; i++) arena.emplace_back(std::string(), T());
+            std::atomic<size_t> nextChunk{0};
+            std::atomic<bool> truncated{false};
+            std::exception_ptr error;
+            std::mutex errorLock;
+            auto decode = [&]() {
+                try {
+                    for (size_t c = nextChunk++; c < chunkOffsets.size() && !truncated; c = nextChunk++) {
+                        uint64_t stop = c + 1 < chunkOffsets.size() ? chunkOffsets[c + 1] : tableStart;
+                        BinaryReader in(data + chunkOffsets[c], static_cast<size_t>(stop - chunkOffsets[c]));
+                        uint64_t last = std::min<uint64_t>(count, (c + 1) * chunkEntries);
+                        for (uint64_t i = c * chunkEntries; i < last && in; i++) {
+                            arena[i].key = in.readString();  // Read the key
+                            arena[i].load(in);  // Read the node's value in place
+                        }
+                        if (!in) truncated = true;
+                    }
+                } catch (...) {
+                    std::lock_guard<std::mutex> guard(errorLock);
+                    if (!error) error = std::current_exception();
+                    truncated = true;
+                }
+            };
+            std::vector<std::thread> workers;
+            for (size_t t = 1; t < std::min(threads, chunkOffsets.size()); t++) workers.emplace_back(decode);
+            decode();  // The calling thread decodes too
+            for (auto& worker : workers) worker.join();
+            if (error) std::rethrow_exception(error);
+            if (truncated) throw std::runtime_error("AVLTree: truncated index file");
+        } else {
+            BinaryReader in(data + sizeof(uint64_t), size - sizeof(uint64_t));
+            for (uint64_t i = 0; i < count && in; i++) {
+                arena.emplace_back(in.readString(), T());  // Read the key
+                arena.back().load(in);  // Read the node's value in place
+            }
+            if (!in) throw std::runtime_error("AVLTree: truncated index file");
+        }
+        adoptArena(std::move(arena));
     }
 
 public:
+    // Forward iterator that walks the tree in sorted key order without recursion
+    class const_iterator {
+    private:
+        std::vector<const AVLNode<T>*> stack;  // Ancestors still to be visited; the top is the current node
+
+        // Pushes a node and its chain of left children so the smallest key ends up on top
+        void pushLeft(const AVLNode<T>* node) {
+            while (node) {
+                stack.push_back(node);
+                node = node->left.get();
+            }
+        }
+
+        friend class AVLTree<T>;  // The tree seeds the stack directly for begin() and lowerBound()
+
+    public:
+        const_iterator() = default;  // Default-constructed iterator equals end()
+
+        const AVLNode<T>& operator*() const { return *stack.back(); }  // Access the current node
+        const AVLNode<T>* operator->() const { return stack.back(); }  // Access the current node's members
+
+        // Advances to the in-order successor of the current node
+        const_iterator& operator++() {
+            const AVLNode<T>* node = stack.back();  // Node we are leaving
+            stack.pop_back();
+            pushLeft(node->right.get());  // The successor is the leftmost node of the right subtree, or an ancestor
+            return *this;
+        }
+
+        // Two iterators are equal when they point at the same node (or are both exhausted)
+        bool operator==(const const_iterator& other) const {
+            if (stack.empty() || other.stack.empty()) return stack.empty() == other.stack.empty();
+            return stack.back() == other.stack.back();
+        }
+
+        bool operator!=(const const_iterator& other) const { return !(*this == other); }
+    };
+
+    // Half-open [first, last) pair of iterators, usable directly in range-based for loops
+    struct Range {
+        const_iterator first;  // First node in the range
+        const_iterator last;  // One past the last node in the range
+
+        const_iterator begin() const { return first; }
+        const_iterator end() const { return last; }
+    };
+
+private:
+    // Iterator to the smallest key below the given root
+    static const_iterator beginAt(const AVLNode<T>* node) {
+        const_iterator it;
+        it.pushLeft(node);
+        return it;
+    }
+
+    // Iterator to the first node below the given root whose key is not less than the given key
+    static const_iterator lowerBoundAt(const AVLNode<T>* node, const std::string& key) {
+        const_iterator it;
+        while (node) {
+            if (node->key < key) {
+                node = node->right.get();  // Everything here and to the left is too small
+            } else {
+                it.stack.push_back(node);  // Candidate; an even smaller match may exist on the left
+                node = node->left.get();
+            }
+        }
+        return it;
+    }
+
+    // All nodes below the given root whose key starts with the given prefix, in sorted order
+    static Range rangeAt(const AVLNode<T>* node, const std::string& prefix) {
+        // The end of the range is the lower bound of the smallest string greater than every prefixed key
+        std::string upper = prefix;
+        while (!upper.empty() && static_cast<unsigned char>(upper.back()) == 0xFF) {
+            upper.pop_back();  // A trailing 0xFF cannot be incremented, so drop it and carry left
+        }
+        if (upper.empty()) {
+            return {lowerBoundAt(node, prefix), const_iterator()};  // Empty prefix (or all 0xFF): run to the end
+        }
+        upper.back() = static_cast<char>(static_cast<unsigned char>(upper.back()) + 1);
+        return {lowerBoundAt(node, prefix), lowerBoundAt(node, upper)};
+    }
+
+public:
+    // Consistent read-only view of one version of the tree. While a Snapshot is alive the version it
+    // captured stays intact, even if a writer keeps inserting into a persistent tree concurrently.
+    class Snapshot {
+    private:
+        EpochReclaimer::Guard guard;  // Pins the epoch so the captured version is not reclaimed
+        const AVLNode<T>* root;  // Root of the captured version
+
+    public:
+        Snapshot(EpochReclaimer::Guard&& g, const AVLNode<T>* r) : guard(std::move(g)), root(r) {}
+
+        // Copies the value stored under a key; returns false if the key is absent
+        bool find(const std::string& key, T& value) const {
+            const AVLNode<T>* node = findAt(root, key);
+            if (!node) return false;
+            value = node->value;
+            return true;
+        }
+
+        const_iterator begin() const { return beginAt(root); }  // Smallest key in the snapshot
+        const_iterator end() const { return const_iterator(); }  // Past-the-end iterator
+        const_iterator lowerBound(const std::string& key) const { return lowerBoundAt(root, key); }
+        Range range(const std::string& prefix) const { return rangeAt(root, prefix); }
+    };
+
+    AVLTree() = default;
+    AVLTree(const AVLTree&) = delete;  // Readers hold raw pointers into the tree, so it must stay put
+    AVLTree& operator=(const AVLTree&) = delete;
+
+    // Switches between in-place updates (default) and path-copying updates that are safe to run
+    // alongside Snapshot readers. Only one thread may write at a time in either mode.
+    void setPersistent(bool enabled) { persistent = enabled; }
+
+    // Captures the currently published version for lock-free reading from any thread
+    Snapshot snapshot() const {
+        EpochReclaimer::Guard guard = reclaimer.pin();  // Pin before loading the root it protects
+        return Snapshot(std::move(guard), published.load());
+    }
+
+    // Iterator to the smallest key in the tree
+    const_iterator begin() const { return beginAt(root.get()); }
+
+    // Past-the-end iterator
+    const_iterator end() const { return const_iterator(); }
+
+    // Iterator to the first node whose key is not less than the given key
+    const_iterator lowerBound(const std::string& key) const { return lowerBoundAt(root.get(), key); }
+
+    // All nodes whose key starts with the given prefix, in sorted order
+    Range range(const std::string& prefix) const { return rangeAt(root.get(), prefix); }
+
+    // Calls visit(node) for every node whose key starts with prefix, in sorted order, stopping early
+    // when visit returns false (the same contract as ShardedIndex::forEachWithPrefix)
+    template<typename Visit>
+    void forEachWithPrefix(const std::string& prefix, Visit&& visit) const {
+        for (const auto& node : range(prefix)) {
+            if (!visit(node)) return;
+        }
+    }
+
     // Public method to insert a new node into the tree
     void insert(const std::string& key, const T& value) {
+        auto previous = root;  // Kept so a persistent tree can retire the version it replaces
         root = insert(root, key, value);  // Insert into the tree and update the root
+        publish(std::move(previous));
     }
 
     // Public method to find a node by key
@@ -187,16 +468,78 @@ public:
         return find(root, key);  // Find the node starting from the root
     }
 
+    // Public method to copy the value stored under a key; returns false if the key is absent
+    bool find(const std::string& key, T& value) const {
+        return snapshot().find(key, value);
+    }
+
+    // Public method that replaces the tree's contents with [first, last), a range of (key, value) pairs
+    // in strictly ascending key order. Builds a perfectly balanced tree in O(n) with no rotations.
+    template<typename InputIt>
+    void bulkLoad(InputIt first, InputIt last) {
+        std::vector<AVLNode<T>> arena;
+        if constexpr (std::is_base_of_v<std::forward_iterator_tag,
+                                        typename std::iterator_traits<InputIt>::iterator_category>) {
+            arena.reserve(std::distance(first, last));  // Size the arena up front when the range allows it
+        }
+        for (; first != last; ++first) {
+            arena.emplace_back(first->first, first->second);
+        }
+        adoptArena(std::move(arena));
+    }
+
+    // Public method that takes over nodes already in strictly ascending key order, without copying them
+    void bulkLoad(std::vector<AVLNode<T>>&& sorted) {
+        adoptArena(std::move(sorted));
+    }
+
+    // Public method to bulk load from any container of sorted (key, value) pairs
+    template<typename SortedRange>
+    void bulkLoad(const SortedRange& sorted) {
+        bulkLoad(std::begin(sorted), std::end(sorted));
+    }
+
+    // Public method that merges another tree into this one in O(n + m) by walking both in order and
+    // bulk loading the result. combine(mine, theirs) produces the value for keys present in both.
+    template<typename Combine>
+    void merge(const AVLTree<T>& other, Combine combine) {
+        std::vector<AVLNode<T>> arena;
+        auto a = begin(), b = other.begin();
+        while (a != end() || b != other.end()) {
+            if (b == other.end() || (a != end() && a->key < b->key)) {
+                arena.emplace_back(a->key, a->value);
+                ++a;
+            } else if (a == end() || b->key < a->key) {
+                arena.emplace_back(b->key, b->value);
+                ++b;
+            } else {
+                arena.emplace_back(a->key, combine(a->value, b->value));  // Same key in both trees
+                ++a;
+                ++b;
+            }
+        }
+        adoptArena(std::move(arena));
+    }
+
     // Public method to save the tree to a file
     void saveToFile(const std::string& filename) const {
         std::ofstream out(filename, std::ios::binary);  // Open the file for binary writing
-        save(out);  // Save the tree to the file
+        if (!out) throw std::runtime_error("AVLTree: cannot write " + filename);
+        BinaryWriter writer(out);
+        save(writer);  // Save the tree to the file
+        writer.flush();
+        if (!out) throw std::runtime_error("AVLTree: cannot write " + filename);
     }
 
-    // Public method to load the tree from a file
-    void loadFromFile(const std::string& filename) {
-        std::ifstream in(filename, std::ios::binary);  // Open the file for binary reading
-        load(in);  // Load the tree from the file
+    // Public method to load the tree from a file, decoding it on up to threads threads
+    void loadFromFile(const std::string& filename, size_t threads = std::thread::hardware_concurrency()) {
+        std::ifstream in(filename, std::ios::binary | std::ios::ate);  // Open the file for binary reading
+        if (!in) throw std::runtime_error("AVLTree: cannot read " + filename);
+        std::vector<char> image(static_cast<size_t>(in.tellg()));
+        in.seekg(0);
+        in.read(image.data(), image.size());  // One read for the whole file
+        if (!in) throw std::runtime_error("AVLTree: cannot read " + filename);
+        load(image.data(), image.size(), threads);  // Load the tree from the file
     }
 };
 
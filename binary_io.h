@@ -0,0 +1,378 @@
+// binary_io.h
+#ifndef BINARY_IO_H  // Include guard to prevent multiple inclusions of this header file
+#define BINARY_IO_H
+
+#include <cstdint>  // For fixed-width primitives
+#include <cstring>  // For std::memcpy
+#include <istream>  // For the underlying input stream
+#include <memory>  // For shared_ptr values
+#include <ostream>  // For the underlying output stream
+#include <stdexcept>  // For reporting malformed varints
+#include <string>  // For length-prefixed strings
+#include <type_traits>  // For selecting serializers
+#include <unordered_map>  // For map serializers
+#include <utility>  // For std::pair
+#include <vector>  // For buffers and vector serializers
+
+// Buffered binary encoding shared by every index file. Values are gathered in a large user-space buffer
+// and handed to the stream in big chunks instead of one write()/read() call per field. Fixed-width
+// integers are little-endian on every host; varints are LEB128 (7 bits per byte, high bit = more follow).
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+constexpr bool hostIsLittleEndian = false;
+#else
+constexpr bool hostIsLittleEndian = true;
+#endif
+
+constexpr size_t binaryBufferSize = 1 << 20;  // Default user-space buffer per reader or writer
+
+// Decodes a varint from memory, advancing p
+inline uint64_t decodeVarint(const char*& p, const char* end) {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        uint8_t byte = static_cast<uint8_t>(*p++);
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return value;
+    }
+    throw std::runtime_error("Truncated varint");
+}
+
+class BinaryWriter {
+private:
+    std::ostream& out;  // Destination
+    std::vector<char> buffer;  // Pending bytes
+    size_t used = 0;  // Bytes of buffer in use
+    uint64_t flushed = 0;  // Bytes handed to the stream so far
+
+public:
+    explicit BinaryWriter(std::ostream& stream, size_t bufferSize = binaryBufferSize)
+        : out(stream), buffer(bufferSize > 16 ? bufferSize : 16) {}
+    BinaryWriter(const BinaryWriter&) = delete;
+    BinaryWriter& operator=(const BinaryWriter&) = delete;
+    ~BinaryWriter() { flush(); }
+
+    // Hands buffered bytes to the stream
+    void flush() {
+        if (used) out.write(buffer.data(), used);
+        flushed += used;
+        used = 0;
+    }
+
+    uint64_t position() const { return flushed + used; }  // Bytes written through this writer
+
+    // Appends raw bytes
+    void writeBytes(const void* data, size_t size) {
+        if (size > buffer.size() - used) {
+            flush();
+            if (size >= buffer.size()) {  // Large blocks skip the buffer
+                out.write(static_cast<const char*>(data), size);
+                flushed += size;
+                return;
+            }
+        }
+        std::memcpy(buffer.data() + used, data, size);
+        used += size;
+    }
+
+    // Appends an integer or floating-point value as little-endian bytes
+    template<typename U>
+    void writeFixed(U value) {
+        static_assert(std::is_arithmetic_v<U>, "writeFixed takes arithmetic types");
+        char bytes[sizeof(U)];
+        std::memcpy(bytes, &value, sizeof(U));
+        if constexpr (!hostIsLittleEndian) {
+            for (size_t i = 0; i < sizeof(U) / 2; i++) std::swap(bytes[i], bytes[sizeof(U) - 1 - i]);
+        }
+        writeBytes(bytes, sizeof(U));
+    }
+
+    // Appends an unsigned integer as a varint
+    void writeVarint(uint64_t value) {
+        char bytes[10];
+        size_t n = 0;
+        do {
+            bytes[n] = static_cast<char>(value & 0x7F);
+            value >>= 7;
+            if (value) bytes[n] |= static_cast<char>(0x80);
+            n++;
+        } while (value);
+        writeBytes(bytes, n);
+    }
+
+    // Appends a string as a 64-bit length followed by its bytes
+    void writeString(const std::string& value) {
+        writeFixed<uint64_t>(value.size());
+        writeBytes(value.data(), value.size());
+    }
+
+    // Appends a string as a varint length followed by its bytes
+    void writeShortString(const std::string& value) {
+        writeVarint(value.size());
+        writeBytes(value.data(), value.size());
+    }
+
+    // Overwrites a fixed-width value at an absolute stream position, e.g. a count written as a placeholder
+    template<typename U>
+    void patchFixed(std::streampos position, U value) {
+        flush();
+        uint64_t written = flushed;  // The patch overwrites bytes, it does not add any
+        std::streampos end = out.tellp();
+        out.seekp(position);
+        writeFixed(value);
+        flush();
+        out.seekp(end);
+        flushed = written;
+    }
+
+    std::ostream& stream() { return out; }  // Underlying stream, e.g. to check for errors after flush()
+};
+
+class BinaryReader {
+private:
+    std::istream* in = nullptr;  // Source stream; null when reading from memory
+    std::vector<char> buffer;  // Bytes read ahead from the stream
+    const char* window = nullptr;  // Bytes available to read: the buffer, or the caller's memory
+    size_t pos = 0;  // Next unread byte of window
+    size_t end = 0;  // Bytes of window holding data
+    uint64_t windowStart = 0;  // Input offset of window[0], relative to where reading began
+    bool failed = false;  // Set once a read ran past the end of the input
+
+    // Refills the buffer from the stream; returns false at end of input
+    bool refill() {
+        if (!in) return false;
+        windowStart += end;
+        in->read(buffer.data(), buffer.size());
+        end = static_cast<size_t>(in->gcount());
+        pos = 0;
+        return end > 0;
+    }
+
+public:
+    explicit BinaryReader(std::istream& stream, size_t bufferSize = binaryBufferSize)
+        : in(&stream), buffer(bufferSize > 16 ? bufferSize : 16), window(buffer.data()) {}
+
+    // Reads from a block of memory the caller keeps alive, e.g. a whole file read at once
+    BinaryReader(const char* data, size_t size) : window(data), end(size) {}
+
+    BinaryReader(const BinaryReader&) = delete;
+    BinaryReader& operator=(const BinaryReader&) = delete;
+
+    explicit operator bool() const { return !failed; }  // False once any read came up short
+
+    // Reads raw bytes; on a short read the rest is zero-filled and the reader fails
+    void readBytes(void* data, size_t size) {
+        char* target = static_cast<char*>(data);
+        while (size > 0) {
+            if (pos == end) {
+                if (in && size >= buffer.size()) {  // Large blocks skip the buffer
+                    in->read(target, size);
+                    size_t got = static_cast<size_t>(in->gcount());
+                    windowStart += end + got;
+                    pos = end = 0;
+                    if (got < size) {
+                        std::memset(target + got, 0, size - got);
+                        failed = true;
+                    }
+                    return;
+                }
+                if (!refill()) {
+                    std::memset(target, 0, size);
+                    failed = true;
+                    return;
+                }
+            }
+            size_t chunk = end - pos < size ? end - pos : size;
+            std::memcpy(target, window + pos, chunk);
+            pos += chunk;
+            target += chunk;
+            size -= chunk;
+        }
+    }
+
+    // Skips bytes without copying them; a stream seeks over whatever is not buffered
+    void skip(uint64_t size) {
+        if (size <= end - pos) {
+            pos += static_cast<size_t>(size);
+            return;
+        }
+        if (!in) {
+            pos = end;
+            failed = true;
+            return;
+        }
+        uint64_t target = windowStart + pos + size;
+        in->seekg(static_cast<std::streamoff>(size - (end - pos)), std::ios::cur);
+        windowStart = target;
+        pos = end = 0;
+        if (!*in) failed = true;
+    }
+
+    uint64_t position() const { return windowStart + pos; }  // Bytes consumed since reading began
+
+    // Reads a little-endian integer or floating-point value
+    template<typename U>
+    U readFixed() {
+        static_assert(std::is_arithmetic_v<U>, "readFixed takes arithmetic types");
+        char bytes[sizeof(U)];
+        readBytes(bytes, sizeof(U));
+        if constexpr (!hostIsLittleEndian) {
+            for (size_t i = 0; i < sizeof(U) / 2; i++) std::swap(bytes[i], bytes[sizeof(U) - 1 - i]);
+        }
+        U value;
+        std::memcpy(&value, bytes, sizeof(U));
+        return value;
+    }
+
+    // Reads a varint
+    uint64_t readVarint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            uint8_t byte;
+            readBytes(&byte, 1);
+            if (failed) return 0;
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) return value;
+        }
+        throw std::runtime_error("Malformed varint");
+    }
+
+    // Reads a string written by writeString
+    std::string readString() {
+        return readBytesOf(readFixed<uint64_t>());
+    }
+
+    // Reads a string written by writeShortString
+    std::string readShortString() {
+        return readBytesOf(readVarint());
+    }
+
+    // Reads a string of a known length. A length larger than what remains only fails the reader,
+    // without first allocating the bogus size.
+    std::string readBytesOf(uint64_t length) {
+        std::string value;
+        if (failed) return value;
+        if (!in && length > end - pos) {  // Memory input: the length can be checked up front
+            pos = end;
+            failed = true;
+            return value;
+        }
+        size_t step = in ? buffer.size() : end - pos;
+        while (length > 0 && !failed) {
+            size_t chunk = static_cast<size_t>(length < step ? length : step);
+            size_t before = value.size();
+            value.resize(before + chunk);
+            readBytes(&value[before], chunk);
+            length -= chunk;
+        }
+        return value;
+    }
+};
+
+// Serializer<T> describes how a value type is written and read. Specialize it (or give the type
+// save(BinaryWriter&) const and load(BinaryReader&) members) to make AVLTree<T> persistable.
+template<typename T, typename = void>
+struct Serializer;  // Deliberately undefined: unsupported types fail to compile
+
+// Detects types with save(BinaryWriter&) const and load(BinaryReader&) members
+template<typename T, typename = void>
+struct HasSaveLoad : std::false_type {};
+
+template<typename T>
+struct HasSaveLoad<T, std::void_t<decltype(std::declval<const T&>().save(std::declval<BinaryWriter&>())),
+                                  decltype(std::declval<T&>().load(std::declval<BinaryReader&>()))>>
+    : std::true_type {};
+
+// Integers and floating point: fixed width, little-endian
+template<typename T>
+struct Serializer<T, std::enable_if_t<std::is_arithmetic_v<T>>> {
+    static void write(BinaryWriter& out, const T& value) { out.writeFixed(value); }
+    static void read(BinaryReader& in, T& value) { value = in.readFixed<T>(); }
+};
+
+// Strings: 64-bit length, then bytes
+template<>
+struct Serializer<std::string> {
+    static void write(BinaryWriter& out, const std::string& value) { out.writeString(value); }
+    static void read(BinaryReader& in, std::string& value) { value = in.readString(); }
+};
+
+// Types that serialize themselves
+template<typename T>
+struct Serializer<T, std::enable_if_t<HasSaveLoad<T>::value>> {
+    static void write(BinaryWriter& out, const T& value) { value.save(out); }
+    static void read(BinaryReader& in, T& value) { value.load(in); }
+};
+
+// Pairs: first, then second
+template<typename A, typename B>
+struct Serializer<std::pair<A, B>> {
+    static void write(BinaryWriter& out, const std::pair<A, B>& value) {
+        Serializer<A>::write(out, value.first);
+        Serializer<B>::write(out, value.second);
+    }
+    static void read(BinaryReader& in, std::pair<A, B>& value) {
+        Serializer<A>::read(in, value.first);
+        Serializer<B>::read(in, value.second);
+    }
+};
+
+// Vectors: 64-bit count, then elements; storage is reserved once
+template<typename T>
+struct Serializer<std::vector<T>> {
+    static void write(BinaryWriter& out, const std::vector<T>& value) {
+        out.writeFixed<uint64_t>(value.size());
+        for (const auto& element : value) Serializer<T>::write(out, element);
+    }
+    static void read(BinaryReader& in, std::vector<T>& value) {
+        uint64_t count = in.readFixed<uint64_t>();
+        value.clear();
+        if (!in) return;
+        value.reserve(static_cast<size_t>(count < (1u << 20) ? count : (1u << 20)));  // Don't trust huge counts blindly
+        for (uint64_t i = 0; i < count && in; i++) {
+            value.emplace_back();
+            Serializer<T>::read(in, value.back());
+        }
+    }
+};
+
+// Hash maps: 64-bit count, then (key, value) entries; buckets are reserved once so loading never rehashes
+template<typename K, typename V>
+struct Serializer<std::unordered_map<K, V>> {
+    static void write(BinaryWriter& out, const std::unordered_map<K, V>& value) {
+        out.writeFixed<uint64_t>(value.size());
+        for (const auto& entry : value) {
+            Serializer<K>::write(out, entry.first);
+            Serializer<V>::write(out, entry.second);
+        }
+    }
+    static void read(BinaryReader& in, std::unordered_map<K, V>& value) {
+        uint64_t count = in.readFixed<uint64_t>();
+        value.clear();
+        if (!in) return;
+        value.reserve(static_cast<size_t>(count < (1u << 20) ? count : (1u << 20)));
+        for (uint64_t i = 0; i < count && in; i++) {
+            K key;
+            V mapped;
+            Serializer<K>::read(in, key);
+            Serializer<V>::read(in, mapped);
+            value.emplace(std::move(key), std::move(mapped));
+        }
+    }
+};
+
+// Shared values: the pointee, with a missing value written as a default-constructed one
+template<typename T>
+struct Serializer<std::shared_ptr<T>> {
+    using Value = std::remove_const_t<T>;
+    static void write(BinaryWriter& out, const std::shared_ptr<T>& value) {
+        if (value) Serializer<Value>::write(out, *value);
+        else Serializer<Value>::write(out, Value());
+    }
+    static void read(BinaryReader& in, std::shared_ptr<T>& value) {
+        auto loaded = std::make_shared<Value>();  // Load into a fresh object, then share it
+        Serializer<Value>::read(in, *loaded);
+        value = std::move(loaded);
+    }
+};
+
+#endif  // End of include guard
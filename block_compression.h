@@ -0,0 +1,119 @@
+// block_compression.h
+#ifndef BLOCK_COMPRESSION_H  // Include guard to prevent multiple inclusions of this header file
+#define BLOCK_COMPRESSION_H
+
+#include <cstdint>  // For fixed-width hash and offset values
+#include <cstring>  // For std::memcpy
+#include <stdexcept>  // For reporting corrupt blocks
+#include <string>  // For byte buffers
+#include <vector>  // For the match-finder hash table
+
+// A small LZ77 block compressor in the style of LZ4, used for document text. Fast to decode, needs no
+// external library, and typically halves news text. The format is a sequence of:
+//   token (high nibble: literal count, low nibble: match length - 4; 15 means more length bytes follow),
+//   extra literal-count bytes, the literals, a 2-byte little-endian match offset, extra match-length bytes.
+// The last sequence has literals only.
+namespace blockcompression {
+
+constexpr size_t minMatch = 4;  // Shortest match worth encoding
+constexpr size_t hashBits = 14;  // Match-finder table of 16K positions
+constexpr size_t maxOffset = 65535;  // Matches must start within a 64 KiB window
+
+// Appends a length continuation: runs of 255 then the remainder
+inline void putLength(std::string& out, size_t length) {
+    while (length >= 255) {
+        out.push_back(static_cast<char>(255));
+        length -= 255;
+    }
+    out.push_back(static_cast<char>(length));
+}
+
+// Hash of the 4 bytes at p
+inline uint32_t hash4(const char* p) {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return (v * 2654435761u) >> (32 - hashBits);
+}
+
+// Writes one sequence: literals [literal, literal + literals) followed by a match (if matchLength > 0)
+inline void putSequence(std::string& out, const char* literal, size_t literals, size_t offset, size_t matchLength) {
+    size_t extraMatch = matchLength ? matchLength - minMatch : 0;
+    uint8_t token = static_cast<uint8_t>((literals < 15 ? literals : 15) << 4);
+    token |= static_cast<uint8_t>(matchLength ? (extraMatch < 15 ? extraMatch : 15) : 0);
+    out.push_back(static_cast<char>(token));
+    if (literals >= 15) putLength(out, literals - 15);
+    out.append(literal, literals);
+    if (!matchLength) return;
+    out.push_back(static_cast<char>(offset & 0xFF));
+    out.push_back(static_cast<char>(offset >> 8));
+    if (extraMatch >= 15) putLength(out, extraMatch - 15);
+}
+
+// Compresses a block; the raw size must be stored alongside to decompress it
+inline std::string compress(const std::string& raw) {
+    std::string out;
+    out.reserve(raw.size() / 2 + 16);
+    std::vector<uint32_t> table(size_t(1) << hashBits, UINT32_MAX);  // Last position of each 4-byte hash
+    const char* base = raw.data();
+    size_t size = raw.size(), pos = 0, anchor = 0;  // anchor: start of pending literals
+    while (size >= minMatch && pos + minMatch <= size) {
+        uint32_t h = hash4(base + pos);
+        uint32_t candidate = table[h];
+        table[h] = static_cast<uint32_t>(pos);
+        if (candidate == UINT32_MAX || pos - candidate > maxOffset ||
+            std::memcmp(base + candidate, base + pos, minMatch) != 0) {
+            pos++;
+            continue;
+        }
+        size_t length = minMatch;
+        while (pos + length < size && base[candidate + length] == base[pos + length]) length++;
+        putSequence(out, base + anchor, pos - anchor, pos - candidate, length);
+        pos += length;
+        anchor = pos;
+    }
+    putSequence(out, base + anchor, size - anchor, 0, 0);  // Trailing literals
+    return out;
+}
+
+// Reads a length continuation
+inline size_t getLength(const char*& in, const char* end) {
+    size_t length = 0;
+    uint8_t byte;
+    do {
+        if (in >= end) throw std::runtime_error("Corrupt compressed block");
+        byte = static_cast<uint8_t>(*in++);
+        length += byte;
+    } while (byte == 255);
+    return length;
+}
+
+// Decompresses a block produced by compress() whose raw size is rawSize
+inline std::string decompress(const char* in, size_t size, size_t rawSize) {
+    std::string out;
+    out.reserve(rawSize);
+    const char* end = in + size;
+    while (in < end) {
+        uint8_t token = static_cast<uint8_t>(*in++);
+        size_t literals = token >> 4;
+        if (literals == 15) literals += getLength(in, end);
+        if (literals > static_cast<size_t>(end - in)) throw std::runtime_error("Corrupt compressed block");
+        out.append(in, literals);
+        in += literals;
+        if (in >= end) break;  // The last sequence has no match
+        if (end - in < 2) throw std::runtime_error("Corrupt compressed block");
+        size_t offset = static_cast<uint8_t>(in[0]) | (static_cast<size_t>(static_cast<uint8_t>(in[1])) << 8);
+        in += 2;
+        size_t length = token & 0x0F;
+        if (length == 15) length += getLength(in, end);
+        length += minMatch;
+        if (offset == 0 || offset > out.size()) throw std::runtime_error("Corrupt compressed block");
+        size_t from = out.size() - offset;
+        for (size_t i = 0; i < length; i++) out.push_back(out[from + i]);  // Byte by byte: matches may overlap
+    }
+    if (out.size() != rawSize) throw std::runtime_error("Corrupt compressed block");
+    return out;
+}
+
+}  // namespace blockcompression
+
+#endif  // End of include guard
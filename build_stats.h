@@ -0,0 +1,185 @@
+// build_stats.h
+#ifndef BUILD_STATS_H  // Include guard to prevent multiple inclusions of this header file
+#define BUILD_STATS_H
+
+#include <chrono>  // For the phase timers
+#include <cstdint>  // For counters
+#include <iomanip>  // For formatting the report
+#include <memory>  // For the per-thread slots
+#include <mutex>  // For registering threads
+#include <ostream>  // For writing the report
+#include <vector>  // For the per-thread slots
+
+// Per-phase timers and counters for an index build. Each indexing thread attaches to the BuildStats
+// and then accumulates into its own cache-line-aligned slot, so recording costs a thread-local load,
+// a branch and, for timers, two clock reads; threads never share a counter. Code running on a thread
+// that is not attached (queries, incremental updates) records nothing. The slots are summed when the
+// report is written, so phase times are thread-seconds: with N threads they add up to about N times
+// the wall time.
+class BuildStats {
+public:
+    enum Phase {  // Where build time goes
+        ListFiles,  // Walking the folder for documents
+        OrderByDate,  // Reading each document's published date to number documents in publication order
+        ReadFile,  // Reading a document into memory
+        ParseJson,  // Parsing the JSON
+        Tokenize,  // Splitting the text into lowercase words
+        HashFile,  // Size, modification time and content hash for the manifest
+        StoreDocument,  // Compressing and appending the displayable fields to the document store
+        Stem,  // Stopword removal and stemming
+        Insert,  // Adding postings to the dictionaries
+        FlushRun,  // Writing a sorted run when the memory budget is exceeded
+        SaveIndex,  // Writing (or merging runs into) the final index files
+        PhaseCount
+    };
+
+    enum Counter {  // What the build processed
+        Files,  // Documents indexed
+        Bytes,  // Bytes of JSON read
+        Tokens,  // Words in the text, before duplicates within a document are dropped
+        Terms,  // Distinct terms added to the dictionaries (summed over runs when runs are flushed)
+        Postings,  // (term, document) pairs added
+        Allocations,  // Heap allocations while attached, when the binary counts them (see countAllocation)
+        CounterCount
+    };
+
+private:
+    struct alignas(64) Slot {  // One thread's totals, on its own cache lines
+        uint64_t nanos[PhaseCount] = {};
+        uint64_t counts[CounterCount] = {};
+    };
+
+    std::vector<std::unique_ptr<Slot>> slots;  // One per attached thread
+    std::mutex slotsLock;  // Guards slots while threads attach
+    std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();  // For the wall time
+    double wallSeconds = 0;  // Set by finish()
+    size_t threadCount = 0;  // Threads that indexed documents
+
+    static Slot*& current() {  // The calling thread's slot, or null when not attached
+        static thread_local Slot* slot = nullptr;
+        return slot;
+    }
+
+    static uint64_t& allocationCounter() {  // Allocations made by the calling thread so far
+        static thread_local uint64_t allocations = 0;
+        return allocations;
+    }
+
+    static const char* phaseName(int phase) {
+        static const char* names[] = {"list_files", "order_by_date", "read_file", "parse_json", "tokenize", "hash_file",
+                                      "store_document", "stem", "insert", "flush_run", "save_index"};
+        return names[phase];
+    }
+
+    static const char* counterName(int counter) {
+        static const char* names[] = {"files", "bytes", "tokens", "terms", "postings", "allocations"};
+        return names[counter];
+    }
+
+    // Sum of every thread's slot
+    Slot total() const {
+        Slot sum;
+        for (const auto& slot : slots) {
+            for (int p = 0; p < PhaseCount; p++) sum.nanos[p] += slot->nanos[p];
+            for (int c = 0; c < CounterCount; c++) sum.counts[c] += slot->counts[c];
+        }
+        return sum;
+    }
+
+public:
+    // While alive, the constructing thread records into its own slot of stats
+    class Attach {
+    private:
+        Slot* previous;  // Restored on destruction, so attachments nest
+        uint64_t allocationsAtStart;  // To attribute only this attachment's allocations
+
+    public:
+        explicit Attach(BuildStats& stats) : previous(current()), allocationsAtStart(allocationCounter()) {
+            std::lock_guard<std::mutex> guard(stats.slotsLock);
+            stats.slots.push_back(std::make_unique<Slot>());
+            current() = stats.slots.back().get();
+        }
+        ~Attach() {
+            current()->counts[Allocations] += allocationCounter() - allocationsAtStart;
+            current() = previous;
+        }
+        Attach(const Attach&) = delete;
+        Attach& operator=(const Attach&) = delete;
+    };
+
+    // Adds the time until the end of the enclosing scope to a phase of the calling thread
+    class Timer {
+    private:
+        Slot* slot;  // Null when the thread is not attached
+        Phase phase;
+        std::chrono::steady_clock::time_point start;
+
+    public:
+        explicit Timer(Phase timed) : slot(current()), phase(timed) {
+            if (slot) start = std::chrono::steady_clock::now();
+        }
+        ~Timer() {
+            if (slot) slot->nanos[phase] += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        }
+        Timer(const Timer&) = delete;
+        Timer& operator=(const Timer&) = delete;
+    };
+
+    BuildStats() = default;
+    BuildStats(const BuildStats&) = delete;
+    BuildStats& operator=(const BuildStats&) = delete;
+
+    // Adds n to a counter of the calling thread
+    static void count(Counter counter, uint64_t n = 1) {
+        if (Slot* slot = current()) slot->counts[counter] += n;
+    }
+
+    // Called by a replacement operator new, in binaries that count allocations
+    static void countAllocation() { allocationCounter()++; }
+
+    void setThreads(size_t threads) { threadCount = threads; }  // How many threads indexed in parallel
+
+    // Stops the wall clock
+    void finish() {
+        wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    }
+
+    double phaseSeconds(Phase phase) const { return total().nanos[phase] / 1e9; }  // Thread-seconds spent in a phase
+    uint64_t counter(Counter counter) const { return total().counts[counter]; }  // Total of a counter
+
+    // Writes the phases and counters as an aligned table
+    void writeTable(std::ostream& out) const {
+        Slot sum = total();
+        uint64_t timed = 0;
+        for (int p = 0; p < PhaseCount; p++) timed += sum.nanos[p];
+        out << "Build phases (thread-seconds over " << threadCount << " threads, " << std::fixed << std::setprecision(3)
+            << wallSeconds << " s wall):\n";
+        for (int p = 0; p < PhaseCount; p++) {
+            out << "  " << std::left << std::setw(16) << phaseName(p) << std::right << std::setw(10) << sum.nanos[p] / 1e9
+                << " s " << std::setprecision(1) << std::setw(6) << (timed ? 100.0 * sum.nanos[p] / timed : 0.0) << "%\n"
+                << std::setprecision(3);
+        }
+        out << "Build counters:\n";
+        for (int c = 0; c < CounterCount; c++) {
+            if (c == Allocations && sum.counts[c] == 0) continue;  // Not counted by this binary
+            out << "  " << std::left << std::setw(16) << counterName(c) << std::right << std::setw(14) << sum.counts[c];
+            if (c == Bytes && wallSeconds > 0) out << "  (" << std::setprecision(1) << sum.counts[c] / 1e6 / wallSeconds << " MB/s)";
+            if (c == Files && wallSeconds > 0) out << "  (" << std::setprecision(0) << sum.counts[c] / wallSeconds << " files/s)";
+            out << "\n";
+        }
+        out.unsetf(std::ios::floatfield);
+        out << std::setprecision(6);
+    }
+
+    // Writes the phases and counters as one JSON object
+    void writeJson(std::ostream& out) const {
+        Slot sum = total();
+        out << "{\"wall_seconds\": " << wallSeconds << ", \"threads\": " << threadCount << ", \"phase_seconds\": {";
+        for (int p = 0; p < PhaseCount; p++) out << (p ? ", " : "") << "\"" << phaseName(p) << "\": " << sum.nanos[p] / 1e9;
+        out << "}, \"counters\": {";
+        for (int c = 0; c < CounterCount; c++) out << (c ? ", " : "") << "\"" << counterName(c) << "\": " << sum.counts[c];
+        out << "}}\n";
+    }
+};
+
+#endif  // End of include guard
@@ -0,0 +1,296 @@
+// corpus_generator.cpp
+// Writes a synthetic financial-news corpus for reproducible scale testing, plus a matching query log.
+// Articles use the JSON schema the indexer reads (title, published, thread.site, text and
+// entities.organizations/persons[].name). Words, organizations and persons are drawn from Zipf
+// distributions, and everything derives from one seed, so a given seed and size always produce
+// byte-identical output.
+// Usage: supersearch_corpus <output-directory> <documents: e.g. 10k, 100k, 1m> [--seed N] [--queries N]
+//                           [--vocabulary N] [--zipf S] [--query-log FILE]
+#include <algorithm> // For binary searching the Zipf tables
+#include <cmath> // For the Zipf weights
+#include <cstdint> // For the seed
+#include <cstdio> // For snprintf
+#include <ctime> // For formatting publication times
+#include <filesystem> // For creating the output directories
+#include <fstream> // For writing articles and the query log
+#include <iostream> // For usage and progress
+#include <random> // For the seeded generator
+#include <stdexcept> // For reporting bad arguments
+#include <string> // For building articles
+#include <unordered_set> // For keeping generated names unique
+#include <vector> // For vocabularies and sampling tables
+
+namespace fs = std::filesystem;
+
+// Draws ranks 0..n-1 with probability proportional to 1 / (rank + 1)^exponent
+class ZipfSampler {
+private:
+    std::vector<double> cumulative; // Running sum of the weights, normalized to end at 1
+
+public:
+    ZipfSampler(size_t n, double exponent) : cumulative(n) {
+        double total = 0;
+        for (size_t rank = 0; rank < n; rank++) {
+            total += 1.0 / std::pow(static_cast<double>(rank + 1), exponent);
+            cumulative[rank] = total;
+        }
+        for (double& c : cumulative) c /= total;
+    }
+
+    template<typename Rng>
+    size_t operator()(Rng& rng) const {
+        double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+        size_t rank = static_cast<size_t>(std::lower_bound(cumulative.begin(), cumulative.end(), u) - cumulative.begin());
+        return std::min(rank, cumulative.size() - 1);
+    }
+};
+
+// Escapes a string for a JSON string literal
+static std::string jsonString(const std::string& value) {
+    std::string out = "\"";
+    for (char c : value) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char escaped[8];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                    out += escaped;
+                } else {
+                    out += c;
+                }
+        }
+    }
+    return out + "\"";
+}
+
+// Parses a document count such as 10000, 10k or 1m
+static size_t parseCount(const std::string& text) {
+    size_t end = 0;
+    double value = std::stod(text, &end);
+    std::string suffix = text.substr(end);
+    if (suffix == "k" || suffix == "K") value *= 1e3;
+    else if (suffix == "m" || suffix == "M") value *= 1e6;
+    else if (!suffix.empty()) throw std::invalid_argument("Bad count " + text);
+    return static_cast<size_t>(value);
+}
+
+// Builds the vocabulary: common financial words first (they get the most frequent ranks), then
+// generated English-like words with inflected endings for the long tail
+static std::vector<std::string> makeVocabulary(size_t size, std::mt19937_64& rng) {
+    std::vector<std::string> words = {
+        "the", "of", "and", "to", "in", "a", "said", "for", "on", "percent", "market", "shares", "stock",
+        "company", "year", "billion", "million", "bank", "investors", "price", "prices", "trade", "rates",
+        "growth", "quarter", "earnings", "revenue", "profit", "oil", "dollar", "bond", "bonds", "yields",
+        "economy", "fed", "inflation", "deal", "merger", "acquisition", "fund", "funds", "index", "sales",
+        "analysts", "expected", "report", "rose", "fell", "higher", "lower", "shareholders", "debt", "credit",
+        "central", "policy", "interest", "tariffs", "exports", "imports", "currency", "euro", "yen", "gold",
+        "futures", "trading", "traders", "equity", "capital", "chief", "executive", "officer", "board",
+        "regulators", "securities", "exchange", "dividend", "forecast", "outlook", "demand", "supply",
+        "crude", "energy", "technology", "retail", "consumer", "housing", "jobs", "unemployment", "wages",
+        "banks", "lending", "loans", "mortgage", "treasury", "government", "budget", "deficit", "tax",
+    };
+    static const char* onsets[] = {"b", "c", "d", "f", "g", "h", "l", "m", "n", "p", "r", "s", "t", "v", "st", "tr", "pr", "gr", "ch", "sh"};
+    static const char* vowels[] = {"a", "e", "i", "o", "u", "ea", "ou", "io"};
+    static const char* codas[] = {"", "n", "r", "t", "s", "l", "nd", "st", "ck", "m"};
+    static const char* endings[] = {"", "", "", "s", "ed", "ing", "ation", "ness", "ly", "er", "ies", "ment"};
+    std::unordered_set<std::string> seen(words.begin(), words.end());
+    while (words.size() < size) {
+        std::string word;
+        size_t syllables = 1 + rng() % 3;
+        for (size_t s = 0; s < syllables; s++) {
+            word += onsets[rng() % 20];
+            word += vowels[rng() % 8];
+            word += codas[rng() % 10];
+        }
+        word += endings[rng() % 12];
+        if (seen.insert(word).second) words.push_back(std::move(word));
+    }
+    words.resize(size);
+    return words;
+}
+
+// Capitalizes the first letter of a word
+static std::string capitalize(std::string word) {
+    if (!word.empty() && word[0] >= 'a' && word[0] <= 'z') word[0] = static_cast<char>(word[0] - 'a' + 'A');
+    return word;
+}
+
+// Builds unique organization names such as "Trelmont Capital Holdings"
+static std::vector<std::string> makeOrganizations(size_t count, const std::vector<std::string>& vocabulary, std::mt19937_64& rng) {
+    static const char* kinds[] = {"Capital", "Holdings", "Group", "Bank", "Partners", "Industries", "Energy",
+                                  "Technologies", "Financial", "Motors", "Pharmaceuticals", "Resources"};
+    static const char* forms[] = {"", " Inc", " Corp", " plc", " AG", " Ltd"};
+    std::unordered_set<std::string> seen;
+    std::vector<std::string> names;
+    while (names.size() < count) {
+        std::string name = capitalize(vocabulary[100 + rng() % (vocabulary.size() - 100)]) + " " + kinds[rng() % 12] + forms[rng() % 6];
+        if (seen.insert(name).second) names.push_back(std::move(name));
+    }
+    return names;
+}
+
+// Builds unique person names from first and last names
+static std::vector<std::string> makePersons(size_t count, const std::vector<std::string>& vocabulary, std::mt19937_64& rng) {
+    static const char* firstNames[] = {"James", "Mary", "John", "Patricia", "Robert", "Jennifer", "Michael", "Linda",
+                                       "David", "Elizabeth", "Wei", "Yuki", "Ahmed", "Sofia", "Lars", "Priya",
+                                       "Carlos", "Olga", "Kwame", "Ana"};
+    std::unordered_set<std::string> seen;
+    std::vector<std::string> names;
+    while (names.size() < count) {
+        std::string name = std::string(firstNames[rng() % 20]) + " " + capitalize(vocabulary[100 + rng() % (vocabulary.size() - 100)]);
+        if (seen.insert(name).second) names.push_back(std::move(name));
+    }
+    return names;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <output-directory> <documents: e.g. 10k, 100k, 1m> [--seed N]\n"
+                  << "       [--queries N] [--vocabulary N] [--zipf S] [--query-log FILE]\n";
+        return 1;
+    }
+    fs::path output = argv[1];
+    size_t documents = 0;
+    uint64_t seed = 42;
+    size_t queries = 10000;
+    size_t vocabularySize = 0; // 0: scale with the corpus
+    double exponent = 1.0;
+    fs::path queryLog;
+    try {
+        documents = parseCount(argv[2]);
+        for (int i = 3; i + 1 < argc; i += 2) {
+            std::string option = argv[i];
+            if (option == "--seed") seed = std::stoull(argv[i + 1]);
+            else if (option == "--queries") queries = parseCount(argv[i + 1]);
+            else if (option == "--vocabulary") vocabularySize = parseCount(argv[i + 1]);
+            else if (option == "--zipf") exponent = std::stod(argv[i + 1]);
+            else if (option == "--query-log") queryLog = argv[i + 1];
+            else throw std::invalid_argument("Unknown option " + option);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    if (vocabularySize == 0) vocabularySize = std::max<size_t>(20000, std::min<size_t>(500000, documents / 2)); // Heaps' law, roughly
+    if (queryLog.empty()) queryLog = output / "queries.log";
+
+    std::mt19937_64 rng(seed);
+    std::vector<std::string> vocabulary = makeVocabulary(vocabularySize, rng);
+    std::vector<std::string> organizations = makeOrganizations(std::max<size_t>(100, vocabularySize / 10), vocabulary, rng);
+    std::vector<std::string> persons = makePersons(std::max<size_t>(100, vocabularySize / 5), vocabulary, rng);
+    static const char* sites[] = {"reuters.com", "cnbc.com", "wsj.com", "ft.com", "bloomberg.com", "marketwatch.com",
+                                  "economist.com", "forbes.com", "businessinsider.com", "fortune.com"};
+    ZipfSampler pickWord(vocabulary.size(), exponent);
+    ZipfSampler pickOrganization(organizations.size(), exponent);
+    ZipfSampler pickPerson(persons.size(), exponent);
+    ZipfSampler pickSite(10, exponent);
+
+    const size_t perDirectory = 10000; // Keeps directories small at 1M documents
+    long long timestamp = 1514764800; // 2018-01-01T00:00:00Z; articles are published in file order
+    for (size_t doc = 0; doc < documents; doc++) {
+        fs::path directory = output / ("part_" + std::to_string(doc / perDirectory));
+        if (doc % perDirectory == 0) fs::create_directories(directory);
+
+        // Entities: up to four of each, mentioned in the text as well
+        std::vector<std::string> orgs, people;
+        for (size_t n = rng() % 5; orgs.size() < n;) {
+            const std::string& name = organizations[pickOrganization(rng)];
+            if (std::find(orgs.begin(), orgs.end(), name) == orgs.end()) orgs.push_back(name);
+        }
+        for (size_t n = rng() % 4; people.size() < n;) {
+            const std::string& name = persons[pickPerson(rng)];
+            if (std::find(people.begin(), people.end(), name) == people.end()) people.push_back(name);
+        }
+
+        std::string title;
+        for (size_t w = 0, n = 5 + rng() % 6; w < n; w++) {
+            title += (w ? " " : "") + (w == 0 ? capitalize(vocabulary[pickWord(rng)]) : vocabulary[pickWord(rng)]);
+        }
+        if (!orgs.empty()) title = orgs[0] + ": " + title;
+
+        std::string text;
+        size_t words = 120 + rng() % 480;
+        for (size_t w = 0, sentence = 0; w < words; w++, sentence++) {
+            std::string word = vocabulary[pickWord(rng)];
+            if (sentence == 0) word = capitalize(word);
+            if (rng() % 40 == 0 && !orgs.empty()) word = orgs[rng() % orgs.size()];
+            else if (rng() % 60 == 0 && !people.empty()) word = people[rng() % people.size()];
+            text += word;
+            if (sentence >= 8 && rng() % 8 == 0) {
+                text += w + 1 < words ? ". " : ".";
+                sentence = static_cast<size_t>(-1); // Next word starts a sentence
+            } else if (w + 1 < words) {
+                text += rng() % 15 == 0 ? ", " : " ";
+            } else {
+                text += ".";
+            }
+        }
+
+        timestamp += 30 + static_cast<long long>(rng() % 600);
+        std::time_t seconds = static_cast<std::time_t>(timestamp);
+        char published[40];
+        std::strftime(published, sizeof(published), "%Y-%m-%dT%H:%M:%S.000+00:00", std::gmtime(&seconds));
+
+        std::string json = "{\"uuid\": " + jsonString(std::to_string(seed) + "-" + std::to_string(doc)) +
+                           ", \"thread\": {\"site\": " + jsonString(sites[pickSite(rng)]) +
+                           ", \"published\": " + jsonString(published) + "}" +
+                           ", \"title\": " + jsonString(title) + ", \"published\": " + jsonString(published) +
+                           ", \"text\": " + jsonString(text) + ", \"entities\": {\"organizations\": [";
+        for (size_t i = 0; i < orgs.size(); i++) json += (i ? ", " : "") + ("{\"name\": " + jsonString(orgs[i]) + "}");
+        json += "], \"persons\": [";
+        for (size_t i = 0; i < people.size(); i++) json += (i ? ", " : "") + ("{\"name\": " + jsonString(people[i]) + "}");
+        json += "]}}\n";
+
+        char fileName[32];
+        std::snprintf(fileName, sizeof(fileName), "news_%07zu.json", doc);
+        std::ofstream file(directory / fileName, std::ios::binary);
+        file << json;
+        if (!file) {
+            std::cerr << "Error: cannot write " << (directory / fileName).string() << "\n";
+            return 1;
+        }
+        if ((doc + 1) % 100000 == 0) std::cerr << (doc + 1) << " documents written\n";
+    }
+
+    // Query log, one query per line, with terms drawn from the same distributions as the articles:
+    // single words, conjunctions, organizations, persons, negations and prefixes
+    fs::create_directories(queryLog.parent_path().empty() ? fs::path(".") : queryLog.parent_path());
+    std::ofstream log(queryLog);
+    auto lowerFirstToken = [](const std::string& name) { // Entity queries use the first word of a name
+        std::string token = name.substr(0, name.find(' '));
+        std::transform(token.begin(), token.end(), token.begin(), ::tolower);
+        return token;
+    };
+    for (size_t q = 0; q < queries; q++) {
+        std::string query;
+        unsigned kind = static_cast<unsigned>(rng() % 100);
+        if (kind < 40) {
+            query = vocabulary[pickWord(rng)];
+        } else if (kind < 65) {
+            query = vocabulary[pickWord(rng)] + " " + vocabulary[pickWord(rng)];
+        } else if (kind < 75) {
+            query = vocabulary[pickWord(rng)] + " " + vocabulary[pickWord(rng)] + " " + vocabulary[pickWord(rng)];
+        } else if (kind < 85) {
+            query = "ORG:" + lowerFirstToken(organizations[pickOrganization(rng)]) + "*";
+        } else if (kind < 90) {
+            query = "PERSON:" + lowerFirstToken(persons[pickPerson(rng)]) + "*";
+        } else if (kind < 95) {
+            query = vocabulary[pickWord(rng)] + " -" + vocabulary[pickWord(rng)];
+        } else {
+            const std::string& word = vocabulary[pickWord(rng)];
+            query = word.substr(0, std::max<size_t>(3, word.size() / 2)) + "*";
+        }
+        log << query << "\n";
+    }
+    if (!log) {
+        std::cerr << "Error: cannot write " << queryLog.string() << "\n";
+        return 1;
+    }
+    std::cout << "Wrote " << documents << " documents to " << output.string() << " and " << queries
+              << " queries to " << queryLog.string() << "\n";
+    return 0;
+}
@@ -0,0 +1,268 @@
+// date_index.h
+#ifndef DATE_INDEX_H  // Include guard to prevent multiple inclusions of this header file
+#define DATE_INDEX_H
+
+#include "binary_io.h"  // For the dates file
+#include <algorithm>  // For block minima and maxima
+#include <cstdint>  // For timestamps and document IDs
+#include <cstdio>  // For replacing the dates file atomically
+#include <fstream>  // For the dates file
+#include <mutex>  // For exclusive locks while indexing
+#include <shared_mutex>  // For queries running while documents are added
+#include <stdexcept>  // For reporting unreadable files
+#include <string>  // For dates as written
+#include <utility>  // For std::pair
+#include <vector>  // For the timestamps and ranges
+
+// Publication time of every document, as uint32 seconds since 1970-01-01 UTC (0 = unknown), with the
+// minimum and maximum of each block of blockSize document IDs. A date filter becomes a list of document
+// ID ranges: blocks entirely inside the filter are taken whole, blocks entirely outside are skipped, and
+// only blocks straddling a bound are read document by document. Builds number documents in publication
+// order, so a filter over the base index is one contiguous range found from a handful of blocks.
+//
+// File: document count, then one uint32 timestamp per document ID. Little-endian.
+class DateIndex {
+public:
+    using Range = std::pair<uint32_t, uint32_t>;  // Inclusive range of document IDs
+
+    static constexpr size_t blockSize = 1024;  // Document IDs per min/max block
+    static constexpr uint32_t unknown = 0;  // Timestamp of documents without a readable date
+    static constexpr Range allDocuments{0, UINT32_MAX};  // Every document ID, when a query has no date filter
+
+    // Seconds since 1970-01-01 UTC of an ISO 8601 date or date-time ("2018-01-01",
+    // "2018-01-01T00:05:01.000+00:00", "2018-01-01T00:05:01Z"), which may be negative or beyond the uint32
+    // range; false if the text is not such a date
+    static bool parseSeconds(const std::string& text, int64_t& seconds) {
+        auto digits = [&](size_t pos, size_t count, int& value) {
+            if (pos + count > text.size()) return false;
+            value = 0;
+            for (size_t i = pos; i < pos + count; i++) {
+                if (text[i] < '0' || text[i] > '9') return false;
+                value = value * 10 + (text[i] - '0');
+            }
+            return true;
+        };
+        int year, month, day, hour = 0, minute = 0, second = 0;
+        if (!digits(0, 4, year) || text.size() < 10 || text[4] != '-' || !digits(5, 2, month) || text[7] != '-' ||
+            !digits(8, 2, day) || month < 1 || month > 12 || day < 1) {
+            return false;
+        }
+        static const int monthDays[] = {31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+        bool leap = year % 4 == 0 && (year % 100 != 0 || year % 400 == 0);
+        if (day > monthDays[month - 1] || (month == 2 && day == 29 && !leap)) return false;
+        int64_t offset = 0;  // Seconds east of UTC
+        if (text.size() > 10) {
+            if ((text[10] != 'T' && text[10] != 't' && text[10] != ' ') || !digits(11, 2, hour) || text[13] != ':' || !digits(14, 2, minute)) return false;
+            size_t pos = 16;
+            if (pos < text.size() && text[pos] == ':') {
+                if (!digits(pos + 1, 2, second)) return false;
+                pos += 3;
+            }
+            if (pos < text.size() && text[pos] == '.') {  // Fractional seconds are dropped
+                for (pos++; pos < text.size() && text[pos] >= '0' && text[pos] <= '9'; pos++) {}
+            }
+            if (pos < text.size() && (text[pos] == '+' || text[pos] == '-')) {
+                int zoneHours, zoneMinutes = 0;
+                if (!digits(pos + 1, 2, zoneHours)) return false;
+                bool colon = pos + 3 < text.size() && text[pos + 3] == ':';
+                size_t minutes = colon ? pos + 4 : pos + 3;
+                if ((colon || minutes < text.size()) && !digits(minutes, 2, zoneMinutes)) return false;  // "+hh", "+hhmm" or "+hh:mm"
+                offset = (zoneHours * 3600 + zoneMinutes * 60) * (text[pos] == '-' ? -1 : 1);
+            }
+        }
+
+        // Days since 1970-01-01 in the proleptic Gregorian calendar (Howard Hinnant's days_from_civil)
+        int64_t y = year - (month <= 2);
+        int64_t era = (y >= 0 ? y : y - 399) / 400;
+        int64_t yearOfEra = y - era * 400;
+        int64_t dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+        int64_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+        int64_t days = era * 146097 + dayOfEra - 719468;
+        seconds = days * 86400 + hour * 3600 + minute * 60 + second - offset;
+        return true;
+    }
+
+    // Timestamp of a document's date as parseSeconds reads it; unknown if it cannot be read or is not
+    // after 1970-01-01T00:00:00Z and within the uint32 range
+    static uint32_t parseTimestamp(const std::string& text) {
+        int64_t seconds;
+        if (!parseSeconds(text, seconds)) return unknown;
+        return seconds > 0 && seconds <= UINT32_MAX ? static_cast<uint32_t>(seconds) : unknown;
+    }
+
+    // Value of a top-level string member of a JSON object, found by skipping over the other members
+    // without building a document; "" if it is absent or not a string. Used to order a build's files by
+    // date before they are parsed in full.
+    static std::string topLevelString(const std::string& json, const std::string& name) {
+        const char* p = json.data();
+        const char* end = p + json.size();
+        auto skipSpace = [&]() { while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) p++; };
+        auto readString = [&](std::string* out) {  // p is on the opening quote; escapes are kept as written
+            for (p++; p < end && *p != '"'; p++) {
+                if (*p == '\\' && p + 1 < end) {
+                    if (out) out->push_back(*p);
+                    p++;
+                }
+                if (out) out->push_back(*p);
+            }
+            p++;
+        };
+        skipSpace();
+        if (p >= end || *p != '{') return std::string();
+        p++;
+        while (true) {
+            skipSpace();
+            if (p >= end || *p != '"') return std::string();
+            std::string key;
+            readString(&key);
+            skipSpace();
+            if (p >= end || *p != ':') return std::string();
+            p++;
+            skipSpace();
+            if (p >= end) return std::string();
+            if (*p == '"') {
+                std::string value;
+                readString(key == name ? &value : nullptr);
+                if (key == name) return value;
+            } else {
+                int depth = 0;  // Nested objects and arrays are skipped whole
+                for (; p < end; p++) {
+                    if (*p == '"') {
+                        readString(nullptr);
+                        p--;
+                    } else if (*p == '{' || *p == '[') {
+                        depth++;
+                    } else if (*p == '}' || *p == ']') {
+                        if (depth == 0) break;
+                        depth--;
+                    } else if (*p == ',' && depth == 0) {
+                        break;
+                    }
+                }
+            }
+            skipSpace();
+            if (p >= end || *p != ',') return std::string();
+            p++;
+        }
+    }
+
+private:
+    std::vector<uint32_t> timestamps;  // By document ID
+    std::vector<uint32_t> blockMin;  // Earliest known timestamp of each block (UINT32_MAX if none)
+    std::vector<uint32_t> blockMax;  // Latest known timestamp of each block (0 if none)
+    std::vector<uint32_t> blockUnknown;  // Undated documents in each block; such blocks are never taken whole
+    std::string path;  // Where flush() writes
+    bool dirty = false;  // Dates were set since the file was last written
+    mutable std::shared_mutex lock;  // Exclusive while setting, shared while filtering
+
+    // Extends the table with undated documents up to size. Callers hold the lock exclusively.
+    void grow(size_t size) {
+        size_t blocks = (size + blockSize - 1) / blockSize;
+        blockMin.resize(blocks, UINT32_MAX);
+        blockMax.resize(blocks, 0);
+        blockUnknown.resize(blocks, 0);
+        for (size_t doc = timestamps.size(); doc < size; doc++) blockUnknown[doc / blockSize]++;
+        timestamps.resize(size, unknown);
+    }
+
+    // Records a timestamp in the table and its block's bounds. Callers hold the lock exclusively.
+    void store(size_t docId, uint32_t timestamp) {
+        size_t block = docId / blockSize;
+        if (timestamps[docId] == unknown && timestamp != unknown) blockUnknown[block]--;
+        if (timestamps[docId] != unknown && timestamp == unknown) blockUnknown[block]++;
+        timestamps[docId] = timestamp;
+        if (timestamp == unknown) return;
+        blockMin[block] = std::min(blockMin[block], timestamp);  // Bounds only widen, so they stay safe to skip on
+        blockMax[block] = std::max(blockMax[block], timestamp);
+    }
+
+public:
+    DateIndex() = default;
+    DateIndex(const DateIndex&) = delete;
+    DateIndex& operator=(const DateIndex&) = delete;
+
+    // Opens the dates file. With reset set, or when there is no file (an index built before dates were
+    // indexed), every document starts undated.
+    void open(const std::string& filePath, bool reset) {
+        std::unique_lock<std::shared_mutex> guard(lock);
+        path = filePath;
+        timestamps.clear();
+        blockMin.clear();
+        blockMax.clear();
+        blockUnknown.clear();
+        dirty = reset;
+        if (reset) return;
+        std::ifstream file(path, std::ios::binary);
+        if (!file) return;
+        BinaryReader in(file);
+        uint64_t count = in.readFixed<uint64_t>();
+        grow(in ? static_cast<size_t>(count) : 0);
+        for (size_t doc = 0; doc < timestamps.size(); doc++) store(doc, in.readFixed<uint32_t>());
+        if (!in) throw std::runtime_error("Truncated dates file " + path);
+    }
+
+    // Records a document's publication time. Thread-safe.
+    void set(uint32_t docId, uint32_t timestamp) {
+        std::unique_lock<std::shared_mutex> guard(lock);
+        if (docId >= timestamps.size()) grow(static_cast<size_t>(docId) + 1);
+        store(docId, timestamp);
+        dirty = true;
+    }
+
+    // Publication time of a document, or unknown
+    uint32_t timestamp(uint32_t docId) const {
+        std::shared_lock<std::shared_mutex> guard(lock);
+        return docId < timestamps.size() ? timestamps[docId] : unknown;
+    }
+
+    // Ascending, disjoint ranges of the documents published in [from, until]; undated documents never match
+    std::vector<Range> ranges(uint32_t from, uint32_t until) const {
+        std::shared_lock<std::shared_mutex> guard(lock);
+        std::vector<Range> result;
+        auto append = [&](uint32_t first, uint32_t last) {
+            if (!result.empty() && result.back().second + 1 == first) result.back().second = last;
+            else result.emplace_back(first, last);
+        };
+        from = std::max<uint32_t>(from, unknown + 1);
+        if (from > until) return result;
+        // Blocks whose bounds are unset (no dated document) have blockMin > blockMax and are skipped below
+        for (size_t block = 0; block < blockMin.size(); block++) {
+            if (blockMax[block] < from || blockMin[block] > until) continue;  // Nothing in the block matches
+            size_t first = block * blockSize;
+            size_t last = std::min(first + blockSize, timestamps.size());
+            if (blockUnknown[block] == 0 && blockMin[block] >= from && blockMax[block] <= until) {  // Everything matches
+                append(static_cast<uint32_t>(first), static_cast<uint32_t>(last - 1));
+                continue;
+            }
+            for (size_t doc = first; doc < last; doc++) {
+                if (timestamps[doc] >= from && timestamps[doc] <= until) append(static_cast<uint32_t>(doc), static_cast<uint32_t>(doc));
+            }
+        }
+        return result;
+    }
+
+    // Writes the file if dates were set, through a temporary file so a crash never leaves it torn
+    void flush() {
+        std::unique_lock<std::shared_mutex> guard(lock);
+        if (!dirty) return;
+        std::string temporary = path + ".tmp";
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            BinaryWriter out(file);
+            out.writeFixed<uint64_t>(timestamps.size());
+            for (uint32_t timestamp : timestamps) out.writeFixed(timestamp);
+            out.flush();
+            if (!file) throw std::runtime_error("Cannot write dates file " + temporary);
+        }
+        std::rename(temporary.c_str(), path.c_str());
+        dirty = false;
+    }
+
+    // Bytes held in memory: the timestamps and the block bounds
+    size_t memoryBytes() const {
+        std::shared_lock<std::shared_mutex> guard(lock);
+        return (timestamps.capacity() + blockMin.capacity() + blockMax.capacity() + blockUnknown.capacity()) * sizeof(uint32_t);
+    }
+};
+
+#endif  // End of include guard
@@ -0,0 +1,248 @@
+// doc_store.h
+#ifndef DOC_STORE_H  // Include guard to prevent multiple inclusions of this header file
+#define DOC_STORE_H
+
+#include "binary_io.h"  // For encoding records, text blocks and the offsets table
+#include "block_compression.h"  // Compresses document text in blocks
+#include <cstdint>  // For fixed-width offsets
+#include <fstream>  // For the data and offsets files
+#include <initializer_list>  // For walking both name lists of a record
+#include <mutex>  // For serializing writers and the shared read stream
+#include <stdexcept>  // For reporting unreadable stores
+#include <string>  // For fields and file names
+#include <utility>  // For std::pair and std::move
+#include <vector>  // For the offsets table and pending documents
+
+// Fields kept for displaying a document without re-reading its JSON
+struct StoredDocument {
+    std::string title;  // Headline
+    std::string published;  // Publication timestamp as written in the article
+    std::string publication;  // Site or outlet that published the article
+    std::string path;  // File path of the article
+    std::vector<std::string> organizations;  // Organization names, as written
+    std::vector<std::string> persons;  // Person names, as written
+    std::string text;  // Body; stored compressed and read separately by text()
+};
+
+// Binary store of displayable document fields, keyed by document ID.
+//
+// "<prefix>.dat" holds metadata records and compressed text blocks; "<prefix>.idx" is the offsets table
+// (one 64-bit record offset per document ID), so a lookup is one seek and one read. Metadata records are
+// stored uncompressed so listing results never decompresses anything. Text is gathered into blocks of
+// about textBlockBytes and compressed together, which compresses far better than articles one by one.
+//
+// Record: title, published, publication, path (each uint32 length + bytes), organization and person
+// counts and names (same encoding), then the uint64 offset of the text block and the uint32 slot within it.
+// Text block: uint32 document count, raw size and compressed size, one uint32 end offset per document,
+// then the compressed bytes. Integers are little-endian. Offsets, lengths and counts read back are
+// checked against the size of the data file before they are used.
+class DocStore {
+public:
+    static constexpr size_t textBlockBytes = 64 * 1024;  // Raw text gathered before a block is compressed
+    static constexpr uint64_t missing = UINT64_MAX;  // Offset of document IDs without a record
+
+private:
+    std::string prefix;  // Path prefix of the two files
+    std::vector<uint64_t> offsets;  // Record offset of each document ID
+    std::vector<std::pair<uint32_t, StoredDocument>> pending;  // Documents waiting for their text block
+    size_t pendingBytes = 0;  // Raw text bytes in pending
+    uint64_t dataBytes = 0;  // Size of the data file, including records not flushed yet
+    bool dirty = false;  // Documents were added since the offsets table was last written
+    std::ofstream out;  // Append stream for new records and blocks
+    mutable std::ifstream in;  // Read stream shared by lookups
+    mutable std::mutex lock;  // Guards everything above
+
+    static constexpr size_t readBuffer = 4096;  // Enough for most records in one read
+
+    static void putString(BinaryWriter& writer, const std::string& value) {
+        writer.writeFixed<uint32_t>(static_cast<uint32_t>(value.size()));
+        writer.writeBytes(value.data(), value.size());
+    }
+
+    // Compresses the pending text into one block, then writes each pending document's record.
+    // Callers hold the lock.
+    void writePending() {
+        if (pending.empty()) return;
+        std::string raw;
+        raw.reserve(pendingBytes);
+        std::vector<uint32_t> ends;
+        for (const auto& entry : pending) {
+            raw += entry.second.text;
+            ends.push_back(static_cast<uint32_t>(raw.size()));
+        }
+        std::string compressed = blockcompression::compress(raw);
+
+        uint64_t blockOffset = dataBytes;  // The stream is always at the end of the file
+        BinaryWriter writer(out, textBlockBytes);
+        writer.writeFixed<uint32_t>(static_cast<uint32_t>(pending.size()));
+        writer.writeFixed<uint32_t>(static_cast<uint32_t>(raw.size()));
+        writer.writeFixed<uint32_t>(static_cast<uint32_t>(compressed.size()));
+        for (uint32_t end : ends) writer.writeFixed(end);
+        writer.writeBytes(compressed.data(), compressed.size());
+        for (uint32_t slot = 0; slot < pending.size(); slot++) {
+            const StoredDocument& doc = pending[slot].second;
+            uint32_t docId = pending[slot].first;
+            if (docId >= offsets.size()) offsets.resize(docId + 1, missing);
+            offsets[docId] = blockOffset + writer.position();
+            putString(writer, doc.title);
+            putString(writer, doc.published);
+            putString(writer, doc.publication);
+            putString(writer, doc.path);
+            writer.writeFixed<uint32_t>(static_cast<uint32_t>(doc.organizations.size()));
+            for (const auto& name : doc.organizations) putString(writer, name);
+            writer.writeFixed<uint32_t>(static_cast<uint32_t>(doc.persons.size()));
+            for (const auto& name : doc.persons) putString(writer, name);
+            writer.writeFixed<uint64_t>(blockOffset);
+            writer.writeFixed<uint32_t>(slot);
+        }
+        writer.flush();
+        dataBytes = blockOffset + writer.position();
+        pending.clear();
+        pendingBytes = 0;
+    }
+
+    // Reads a document's record and where its text is; returns false if it has none, or if an offset,
+    // count or length in it points past the end of the data file. Callers hold the lock.
+    bool readRecord(uint32_t docId, StoredDocument& document, uint64_t& blockOffset, uint32_t& slot) const {
+        if (docId >= offsets.size() || offsets[docId] >= dataBytes) return false;  // Also rejects missing
+        uint64_t start = offsets[docId];
+        in.clear();
+        in.seekg(static_cast<std::streamoff>(start));
+        BinaryReader reader(in, readBuffer);
+        bool intact = static_cast<bool>(in);
+        auto fits = [&](uint64_t bytes) {  // Whether bytes more can follow what was read so far
+            intact = intact && reader && bytes <= dataBytes - start - reader.position();
+            return intact;
+        };
+        auto getString = [&]() {
+            uint32_t length = reader.readFixed<uint32_t>();
+            return fits(length) ? reader.readBytesOf(length) : std::string();
+        };
+        document.title = getString();
+        document.published = getString();
+        document.publication = getString();
+        document.path = getString();
+        for (auto* names : {&document.organizations, &document.persons}) {
+            uint32_t count = reader.readFixed<uint32_t>();
+            names->clear();
+            if (!fits(uint64_t(count) * sizeof(uint32_t))) break;  // Every name takes at least its length
+            for (uint32_t i = 0; i < count && intact; i++) names->push_back(getString());
+        }
+        blockOffset = reader.readFixed<uint64_t>();
+        slot = reader.readFixed<uint32_t>();
+        return fits(0) && blockOffset < start;  // Blocks are written before their records
+    }
+
+public:
+    DocStore() = default;
+    DocStore(const DocStore&) = delete;
+    DocStore& operator=(const DocStore&) = delete;
+
+    // Opens the store under a path prefix. With reset set, any existing store is discarded.
+    void open(const std::string& filePrefix, bool reset) {
+        std::lock_guard<std::mutex> guard(lock);
+        prefix = filePrefix;
+        offsets.clear();
+        pending.clear();
+        pendingBytes = 0;
+        dirty = reset;  // A reset store is written out even if nothing is added
+        if (!reset) {
+            std::ifstream index(prefix + ".idx", std::ios::binary | std::ios::ate);
+            if (index) {
+                std::vector<char> image(static_cast<size_t>(index.tellg()));  // Whole file, so the count is checked against it
+                index.seekg(0);
+                index.read(image.data(), image.size());
+                BinaryReader reader(image.data(), index ? image.size() : 0);
+                uint64_t count = reader.readFixed<uint64_t>();
+                if (!reader || count > (image.size() - sizeof(uint64_t)) / sizeof(uint64_t)) {
+                    throw std::runtime_error("Truncated document store index " + prefix + ".idx");
+                }
+                offsets.resize(static_cast<size_t>(count));
+                for (uint64_t& offset : offsets) offset = reader.readFixed<uint64_t>();
+            }
+        }
+        if (out.is_open()) out.close();
+        out.clear();
+        if (!reset) out.open(prefix + ".dat", std::ios::binary | std::ios::in | std::ios::out);  // Keep existing records
+        if (!out.is_open()) {
+            out.clear();
+            out.open(prefix + ".dat", std::ios::binary | std::ios::trunc);
+        }
+        out.seekp(0, std::ios::end);  // New records are appended
+        if (!out) throw std::runtime_error("Cannot write document store " + prefix + ".dat");
+        dataBytes = static_cast<uint64_t>(out.tellp());
+        if (in.is_open()) in.close();
+        in.clear();
+        in.open(prefix + ".dat", std::ios::binary);
+    }
+
+    // Queues a document for storage; it becomes readable after the next flush(). Thread-safe.
+    void add(uint32_t docId, StoredDocument document) {
+        std::lock_guard<std::mutex> guard(lock);
+        pendingBytes += document.text.size();
+        pending.emplace_back(docId, std::move(document));
+        dirty = true;
+        if (pendingBytes >= textBlockBytes) writePending();
+    }
+
+    // Writes queued documents and the offsets table, making everything added so far readable
+    void flush() {
+        std::lock_guard<std::mutex> guard(lock);
+        if (!dirty) return;
+        dirty = false;
+        writePending();
+        out.flush();
+        std::ofstream index(prefix + ".idx", std::ios::binary | std::ios::trunc);
+        BinaryWriter writer(index);
+        writer.writeFixed<uint64_t>(offsets.size());
+        for (uint64_t offset : offsets) writer.writeFixed(offset);
+    }
+
+    // Bytes held in memory: the offsets table and the documents waiting for their text block
+    size_t memoryBytes() const {
+        std::lock_guard<std::mutex> guard(lock);
+        return offsets.capacity() * sizeof(uint64_t) + pending.capacity() * sizeof(pending[0]) + pendingBytes;
+    }
+
+    // Reads a document's metadata (everything but text); returns false if it is not stored
+    bool find(uint32_t docId, StoredDocument& document) const {
+        std::lock_guard<std::mutex> guard(lock);
+        uint64_t blockOffset = 0;
+        uint32_t slot = 0;
+        return readRecord(docId, document, blockOffset, slot);
+    }
+
+    // Reads a document's text by decompressing its block; returns false if it is not stored or its block
+    // is damaged
+    bool text(uint32_t docId, std::string& text) const {
+        std::lock_guard<std::mutex> guard(lock);
+        StoredDocument record;
+        uint64_t blockOffset = 0;
+        uint32_t slot = 0;
+        if (!readRecord(docId, record, blockOffset, slot)) return false;
+
+        in.clear();
+        in.seekg(static_cast<std::streamoff>(blockOffset));
+        BinaryReader reader(in, readBuffer);
+        uint32_t count = reader.readFixed<uint32_t>();
+        uint32_t rawSize = reader.readFixed<uint32_t>();
+        uint32_t compressedSize = reader.readFixed<uint32_t>();
+        uint64_t available = dataBytes - blockOffset - reader.position();  // readRecord checked blockOffset
+        if (!reader || slot >= count || uint64_t(count) * sizeof(uint32_t) + compressedSize > available) return false;
+        if (rawSize > uint64_t(compressedSize) * 255) return false;  // No compressed byte expands to more
+        std::vector<uint32_t> ends(count);
+        for (uint32_t& end : ends) end = reader.readFixed<uint32_t>();
+        std::string compressed = reader.readBytesOf(compressedSize);
+        if (!reader || ends.back() != rawSize) return false;
+        for (uint32_t i = 1; i < count; i++) {
+            if (ends[i] < ends[i - 1]) return false;  // The slices must be in order within the block
+        }
+
+        std::string raw = blockcompression::decompress(compressed.data(), compressed.size(), rawSize);
+        uint32_t begin = slot == 0 ? 0 : ends[slot - 1];
+        text = raw.substr(begin, ends[slot] - begin);
+        return true;
+    }
+};
+
+#endif  // End of include guard
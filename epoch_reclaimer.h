@@ -0,0 +1,92 @@
+// epoch_reclaimer.h
+#ifndef EPOCH_RECLAIMER_H  // Include guard to prevent multiple inclusions of this header file
+#define EPOCH_RECLAIMER_H
+
+#include <array>  // For the fixed table of reader slots
+#include <atomic>  // For the global epoch and per-reader announcements
+#include <cstdint>  // For fixed-width epoch counters
+#include <functional>  // For hashing thread ids into a starting slot
+#include <memory>  // For type-erased ownership of retired objects
+#include <thread>  // For yielding when every reader slot is busy
+#include <utility>  // For std::pair and std::move
+#include <vector>  // For the writer's list of retired objects
+
+// Epoch-based reclamation for one writer and many lock-free readers.
+//
+// Readers pin the current epoch for the duration of a read. The writer publishes a new version,
+// then retires the objects the old version owned; they are destroyed once every reader that could
+// still see them has unpinned. Retired objects are held as shared_ptr<void>, so "destroying" one
+// just drops the writer's last reference.
+class EpochReclaimer {
+private:
+    static constexpr size_t maxReaders = 128;  // Concurrent pins supported before readers start to wait
+
+    struct alignas(64) Slot {  // One cache line per slot so readers do not false-share
+        std::atomic<uint64_t> epoch{0};  // Epoch pinned by the reader using this slot, 0 when free
+    };
+
+    mutable std::array<Slot, maxReaders> slots;  // Announcements of active readers
+    std::atomic<uint64_t> epoch{1};  // Global epoch; advanced by the writer after each publication
+    std::vector<std::pair<uint64_t, std::shared_ptr<void>>> retired;  // Writer-only: (epoch retired in, object)
+
+public:
+    // RAII pin held by a reader; everything reachable from a version loaded after pinning stays alive
+    class Guard {
+    private:
+        Slot* slot;  // Slot this reader announced itself in
+
+    public:
+        explicit Guard(Slot* s) : slot(s) {}
+        Guard(Guard&& other) noexcept : slot(other.slot) { other.slot = nullptr; }
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+        Guard& operator=(Guard&&) = delete;
+        ~Guard() {
+            if (slot) slot->epoch.store(0, std::memory_order_release);  // Leave the critical section
+        }
+    };
+
+    // Pins the current epoch. Must be taken before loading the published version it protects.
+    Guard pin() const {
+        size_t start = std::hash<std::thread::id>()(std::this_thread::get_id());  // Spread threads over slots
+        while (true) {
+            uint64_t current = epoch.load();
+            for (size_t i = 0; i < maxReaders; i++) {
+                Slot& slot = slots[(start + i) % maxReaders];
+                uint64_t expected = 0;
+                if (slot.epoch.compare_exchange_strong(expected, current)) {
+                    return Guard(&slot);
+                }
+            }
+            std::this_thread::yield();  // Every slot is taken; wait for a reader to finish
+        }
+    }
+
+    // Writer-only: hands over an object unreachable from the newly published version
+    void retire(std::shared_ptr<void> garbage) {
+        uint64_t retiredIn = epoch.fetch_add(1);  // Readers pinned at or before this epoch may still see it
+        retired.emplace_back(retiredIn, std::move(garbage));
+    }
+
+    // Writer-only: frees every retired object that no pinned reader can still reach
+    void reclaim() {
+        uint64_t oldestPinned = UINT64_MAX;
+        for (const auto& slot : slots) {
+            uint64_t pinned = slot.epoch.load();
+            if (pinned != 0 && pinned < oldestPinned) oldestPinned = pinned;
+        }
+
+        size_t kept = 0;
+        for (auto& entry : retired) {
+            if (entry.first >= oldestPinned) {
+                retired[kept++] = std::move(entry);  // Still potentially visible to a reader
+            }
+        }
+        retired.resize(kept);  // Dropping the rest releases their memory
+    }
+
+    // Number of retired objects still waiting for readers to move on
+    size_t pending() const { return retired.size(); }
+};
+
+#endif  // End of include guard
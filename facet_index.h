@@ -0,0 +1,254 @@
+// facet_index.h
+#ifndef FACET_INDEX_H  // Include guard to prevent multiple inclusions of this header file
+#define FACET_INDEX_H
+
+#include "binary_io.h"  // For the facets file
+#include <algorithm>  // For sorting entity IDs and counts
+#include <cctype>  // For lowercasing entity names
+#include <cstdint>  // For entity and document IDs
+#include <cstdio>  // For replacing the facets file atomically
+#include <fstream>  // For the facets file
+#include <mutex>  // For exclusive locks while indexing
+#include <shared_mutex>  // For queries running while documents are added
+#include <stdexcept>  // For reporting unreadable files
+#include <string>  // For entity names
+#include <unordered_map>  // For name -> entity ID
+#include <utility>  // For std::pair
+#include <vector>  // For the forward lists and histograms
+
+// Forward lists of the organizations and persons of every document, for counting the most frequent
+// entities of a result set without reading any document.
+//
+// Each distinct entity name (compared lowercased, as org: and person: queries are) gets a dense 32-bit ID
+// per kind. A document's entity IDs, organizations then persons, sorted and without duplicates, are
+// stored back to back in one array, and an 8-byte entry per document ID says where its slice starts.
+// Counting walks the slices of the matching documents into a compact array of IDs, then either sorts it
+// (few hits: no per-query array the size of the dictionary) or histograms it into dense counters (many
+// hits). Above a threshold, only every k-th matching document is read and counts are scaled by k.
+//
+// File: per kind, entity count and names (varint length + bytes); document entry count and entries
+// (uint32 offset, uint16 organizations, uint16 persons); entity ID count and IDs. Little-endian.
+class FacetIndex {
+public:
+    enum Kind { Organizations, Persons, KindCount };
+
+    static constexpr size_t defaultSampleThreshold = 50000;  // Matching documents read before sampling starts
+    static constexpr size_t histogramLanes = 4;  // Counter copies used by dense histograms
+
+    struct Count {
+        std::string name;  // Entity name as first written in the corpus
+        size_t documents = 0;  // Matching documents naming it; an estimate when the result was sampled
+    };
+
+    struct Result {
+        std::vector<Count> top[KindCount];  // Most frequent entities of each kind, most frequent first
+        size_t documents = 0;  // Documents in the result set
+        size_t counted = 0;  // Documents whose entities were read
+        bool sampled() const { return counted < documents; }
+    };
+
+private:
+    struct Entry {  // One document's slice of entities
+        uint32_t offset = 0;  // Position of the slice in entities
+        uint16_t organizations = 0;  // Organization IDs at the start of the slice
+        uint16_t persons = 0;  // Person IDs after them
+    };
+
+    struct Dictionary {  // Entity names of one kind
+        std::vector<std::string> names;  // Entity ID -> name as first seen
+        std::unordered_map<std::string, uint32_t> ids;  // Lowercased name -> entity ID
+    };
+
+    Dictionary dictionaries[KindCount];
+    std::vector<Entry> entries;  // By document ID; empty slices for documents without entities
+    std::vector<uint32_t> entities;  // Every document's slice, in the order documents were added
+    std::string path;  // Where flush() writes
+    bool dirty = false;  // Documents were added since the file was last written
+    mutable std::shared_mutex lock;  // Exclusive while adding, shared while counting
+
+    // Entity IDs for a document's names, sorted and without duplicates. Callers hold the lock exclusively.
+    std::vector<uint32_t> intern(Kind kind, const std::vector<std::string>& names) {
+        Dictionary& dictionary = dictionaries[kind];
+        std::vector<uint32_t> ids;
+        ids.reserve(names.size());
+        for (const auto& name : names) {
+            std::string key = name;
+            std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+            auto found = dictionary.ids.emplace(std::move(key), static_cast<uint32_t>(dictionary.names.size()));
+            if (found.second) dictionary.names.push_back(name);
+            ids.push_back(found.first->second);
+        }
+        std::sort(ids.begin(), ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+        if (ids.size() > UINT16_MAX) ids.resize(UINT16_MAX);
+        return ids;
+    }
+
+    // Counts occurrences of each entity ID in hits and keeps the top most frequent, each scaled by scale
+    static std::vector<Count> topEntities(std::vector<uint32_t>& hits, const Dictionary& dictionary, size_t top, size_t scale) {
+        std::vector<std::pair<uint32_t, uint32_t>> counts;  // (entity ID, occurrences)
+        size_t entityCount = dictionary.names.size();
+        if (hits.size() * 8 < entityCount) {  // Sparse: sort the hits and count runs
+            std::sort(hits.begin(), hits.end());
+            for (size_t i = 0; i < hits.size();) {
+                size_t run = i;
+                while (run < hits.size() && hits[run] == hits[i]) run++;
+                counts.emplace_back(hits[i], static_cast<uint32_t>(run - i));
+                i = run;
+            }
+        } else {
+            // Dense: consecutive hits go to different counter copies, so repeats of one popular entity
+            // don't wait on each other's increments; the copies are then summed in a vectorizable loop
+            size_t lanes = hits.size() >= histogramLanes * entityCount ? histogramLanes : 1;
+            std::vector<uint32_t> histogram(lanes * entityCount, 0);
+            size_t i = 0;
+            if (lanes == histogramLanes) {
+                for (; i + histogramLanes <= hits.size(); i += histogramLanes) {
+                    histogram[hits[i]]++;
+                    histogram[entityCount + hits[i + 1]]++;
+                    histogram[2 * entityCount + hits[i + 2]]++;
+                    histogram[3 * entityCount + hits[i + 3]]++;
+                }
+            }
+            for (; i < hits.size(); i++) histogram[hits[i]]++;
+            uint32_t* total = histogram.data();
+            for (size_t lane = 1; lane < lanes; lane++) {
+                const uint32_t* copy = histogram.data() + lane * entityCount;
+                for (size_t id = 0; id < entityCount; id++) total[id] += copy[id];
+            }
+            for (size_t id = 0; id < entityCount; id++) {
+                if (total[id]) counts.emplace_back(static_cast<uint32_t>(id), total[id]);
+            }
+        }
+
+        // Most frequent first; ties by name, so the order doesn't depend on the order IDs were assigned
+        auto before = [&](const std::pair<uint32_t, uint32_t>& a, const std::pair<uint32_t, uint32_t>& b) {
+            if (a.second != b.second) return a.second > b.second;
+            return dictionary.names[a.first] < dictionary.names[b.first];
+        };
+        size_t kept = std::min(top, counts.size());
+        std::partial_sort(counts.begin(), counts.begin() + kept, counts.end(), before);
+        std::vector<Count> result;
+        result.reserve(kept);
+        for (size_t i = 0; i < kept; i++) result.push_back({dictionary.names[counts[i].first], counts[i].second * scale});
+        return result;
+    }
+
+public:
+    FacetIndex() = default;
+    FacetIndex(const FacetIndex&) = delete;
+    FacetIndex& operator=(const FacetIndex&) = delete;
+
+    // Opens the facets file. With reset set, or when there is no file (an index built before facets
+    // existed), the index starts empty.
+    void open(const std::string& filePath, bool reset) {
+        std::unique_lock<std::shared_mutex> guard(lock);
+        path = filePath;
+        for (auto& dictionary : dictionaries) dictionary = Dictionary();
+        entries.clear();
+        entities.clear();
+        dirty = reset;
+        if (reset) return;
+        std::ifstream file(path, std::ios::binary);
+        if (!file) return;
+        BinaryReader in(file);
+        for (auto& dictionary : dictionaries) {
+            uint64_t count = in.readFixed<uint64_t>();
+            for (uint64_t id = 0; id < count && in; id++) {
+                dictionary.names.push_back(in.readShortString());
+                std::string key = dictionary.names.back();
+                std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+                dictionary.ids.emplace(std::move(key), static_cast<uint32_t>(id));
+            }
+        }
+        entries.resize(in ? static_cast<size_t>(in.readFixed<uint64_t>()) : 0);
+        for (auto& entry : entries) {
+            entry.offset = in.readFixed<uint32_t>();
+            entry.organizations = in.readFixed<uint16_t>();
+            entry.persons = in.readFixed<uint16_t>();
+        }
+        entities.resize(in ? static_cast<size_t>(in.readFixed<uint64_t>()) : 0);
+        for (auto& id : entities) id = in.readFixed<uint32_t>();
+        if (!in) throw std::runtime_error("Truncated facets file " + path);
+    }
+
+    // Records a document's organizations and persons, as written in the article. Thread-safe.
+    void add(uint32_t docId, const std::vector<std::string>& organizations, const std::vector<std::string>& persons) {
+        std::unique_lock<std::shared_mutex> guard(lock);
+        std::vector<uint32_t> orgIds = intern(Organizations, organizations);
+        std::vector<uint32_t> personIds = intern(Persons, persons);
+        if (docId >= entries.size()) entries.resize(docId + 1);
+        entries[docId] = {static_cast<uint32_t>(entities.size()), static_cast<uint16_t>(orgIds.size()),
+                          static_cast<uint16_t>(personIds.size())};
+        entities.insert(entities.end(), orgIds.begin(), orgIds.end());
+        entities.insert(entities.end(), personIds.begin(), personIds.end());
+        dirty = true;
+    }
+
+    // Writes the file if documents were added, through a temporary file so a crash never leaves it torn
+    void flush() {
+        std::unique_lock<std::shared_mutex> guard(lock);
+        if (!dirty) return;
+        std::string temporary = path + ".tmp";
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            BinaryWriter out(file);
+            for (const auto& dictionary : dictionaries) {
+                out.writeFixed<uint64_t>(dictionary.names.size());
+                for (const auto& name : dictionary.names) out.writeShortString(name);
+            }
+            out.writeFixed<uint64_t>(entries.size());
+            for (const auto& entry : entries) {
+                out.writeFixed(entry.offset);
+                out.writeFixed(entry.organizations);
+                out.writeFixed(entry.persons);
+            }
+            out.writeFixed<uint64_t>(entities.size());
+            for (uint32_t id : entities) out.writeFixed(id);
+            out.flush();
+            if (!file) throw std::runtime_error("Cannot write facets file " + temporary);
+        }
+        std::rename(temporary.c_str(), path.c_str());
+        dirty = false;
+    }
+
+    // Counts the top most frequent organizations and persons over docs, in ascending ID order. Beyond
+    // sampleThreshold documents, every k-th is counted, with k chosen to keep about sampleThreshold.
+    Result count(const std::vector<uint32_t>& docs, size_t top, size_t sampleThreshold = defaultSampleThreshold) const {
+        std::shared_lock<std::shared_mutex> guard(lock);
+        Result result;
+        result.documents = docs.size();
+        size_t stride = sampleThreshold && docs.size() > sampleThreshold ? (docs.size() + sampleThreshold - 1) / sampleThreshold : 1;
+
+        std::vector<uint32_t> hits[KindCount];  // Entity IDs of the counted documents, one per mention
+        for (size_t i = 0; i < docs.size(); i += stride) {
+            result.counted++;
+            if (docs[i] >= entries.size()) continue;  // Indexed before facets existed
+            const Entry& entry = entries[docs[i]];
+            const uint32_t* slice = entities.data() + entry.offset;
+            hits[Organizations].insert(hits[Organizations].end(), slice, slice + entry.organizations);
+            hits[Persons].insert(hits[Persons].end(), slice + entry.organizations, slice + entry.organizations + entry.persons);
+        }
+        for (int kind = 0; kind < KindCount; kind++) {
+            result.top[kind] = topEntities(hits[kind], dictionaries[kind], top, stride);
+        }
+        return result;
+    }
+
+    // Bytes held in memory: the names, the name -> ID maps, the document entries and the entity IDs
+    size_t memoryBytes() const {
+        std::shared_lock<std::shared_mutex> guard(lock);
+        size_t bytes = entries.capacity() * sizeof(Entry) + entities.capacity() * sizeof(uint32_t);
+        for (const auto& dictionary : dictionaries) {
+            bytes += dictionary.names.capacity() * sizeof(std::string);
+            bytes += dictionary.ids.bucket_count() * sizeof(void*);
+            for (const auto& name : dictionary.names) {
+                size_t heap = name.capacity() > 15 ? name.capacity() + 1 : 0;  // Beyond the inline buffer
+                bytes += 2 * heap + sizeof(std::string) + sizeof(uint32_t) + 2 * sizeof(void*);  // Name, key and map node
+            }
+        }
+        return bytes;
+    }
+};
+
+#endif  // End of include guard
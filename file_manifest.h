@@ -0,0 +1,137 @@
+// file_manifest.h
+#ifndef FILE_MANIFEST_H  // Include guard to prevent multiple inclusions of this header file
+#define FILE_MANIFEST_H
+
+#include "binary_io.h"  // For encoding the manifest
+#include <cstdint>  // For fixed-width sizes, timestamps and hashes
+#include <filesystem>  // For file sizes and modification times
+#include <fstream>  // For hashing file contents and persisting the manifest
+#include <mutex>  // For exclusive access while recording files
+#include <shared_mutex>  // For concurrent reads while files are recorded
+#include <stdexcept>  // For reporting a truncated manifest
+#include <string>  // For file paths
+#include <utility>  // For std::pair
+#include <vector>  // For records indexed by document ID
+
+// What the index knew about a file when it was indexed
+struct FileRecord {
+    std::string path;  // File path as listed when indexing
+    uint64_t size = 0;  // Size in bytes
+    int64_t mtime = 0;  // Last write time, in file clock ticks
+    uint64_t hash = 0;  // FNV-1a hash of the contents
+
+    // Reads a file's current size, modification time and content hash
+    static FileRecord describe(const std::string& filePath) {
+        FileRecord record;
+        record.path = filePath;
+        stat(filePath, record);
+        record.hash = hashFile(filePath);
+        return record;
+    }
+
+    // Fills in size and modification time only, which is enough to spot most unchanged files
+    static void stat(const std::string& filePath, FileRecord& record) {
+        std::error_code error;
+        record.size = std::filesystem::file_size(filePath, error);
+        auto written = std::filesystem::last_write_time(filePath, error);
+        record.mtime = error ? 0 : static_cast<int64_t>(written.time_since_epoch().count());
+    }
+
+    // 64-bit FNV-1a hash of a file's contents, read in large chunks
+    static uint64_t hashFile(const std::string& filePath) {
+        uint64_t hash = 14695981039346656037ULL;  // FNV offset basis
+        std::ifstream in(filePath, std::ios::binary);
+        std::vector<char> chunk(1 << 16);
+        while (in) {
+            in.read(chunk.data(), chunk.size());
+            for (std::streamsize i = 0; i < in.gcount(); i++) {
+                hash ^= static_cast<unsigned char>(chunk[i]);
+                hash *= 1099511628211ULL;  // FNV prime
+            }
+        }
+        return hash;
+    }
+};
+
+// Per-document record of every indexed file, indexed by document ID and persisted in index.dat. Used to
+// decide on the next index run which files were added, changed or deleted since they were indexed.
+// Whether a document is still live is tracked separately, by LiveDocs.
+class FileManifest {
+private:
+    std::vector<FileRecord> records;  // Record of each document ID; an empty path means none was taken
+    mutable std::shared_mutex lock;  // Indexing threads record files concurrently
+
+public:
+    // Stores the record of a document, growing the table as needed
+    void track(uint32_t docId, FileRecord record) {
+        std::unique_lock<std::shared_mutex> guard(lock);
+        if (docId >= records.size()) records.resize(docId + 1);
+        records[docId] = std::move(record);
+    }
+
+    // Copies the record of a document; returns false if it has none
+    bool find(uint32_t docId, FileRecord& record) const {
+        std::shared_lock<std::shared_mutex> guard(lock);
+        if (docId >= records.size() || records[docId].path.empty()) return false;
+        record = records[docId];
+        return true;
+    }
+
+    // Drops the record of a document, as if it had never been indexed
+    void forget(uint32_t docId) {
+        std::unique_lock<std::shared_mutex> guard(lock);
+        if (docId < records.size()) records[docId] = FileRecord();
+    }
+
+    // Bytes held by the records and their paths
+    size_t memoryBytes() const {
+        std::shared_lock<std::shared_mutex> guard(lock);
+        size_t bytes = records.capacity() * sizeof(FileRecord);
+        for (const auto& record : records) bytes += record.path.capacity() > 15 ? record.path.capacity() + 1 : 0;  // Beyond the inline buffer
+        return bytes;
+    }
+
+    // Copies every record that has a path, paired with its document ID
+    std::vector<std::pair<uint32_t, FileRecord>> recorded() const {
+        std::shared_lock<std::shared_mutex> guard(lock);
+        std::vector<std::pair<uint32_t, FileRecord>> all;
+        for (size_t i = 0; i < records.size(); i++) {
+            if (!records[i].path.empty()) all.emplace_back(static_cast<uint32_t>(i), records[i]);
+        }
+        return all;
+    }
+
+    // Writes the manifest: a count, then (path, size, mtime, hash) per document ID, as little-endian
+    // 64-bit fields
+    void save(BinaryWriter& out) const {
+        std::shared_lock<std::shared_mutex> guard(lock);
+        out.writeFixed<uint64_t>(records.size());
+        for (const auto& record : records) {
+            out.writeString(record.path);
+            out.writeFixed(record.size);
+            out.writeFixed(record.mtime);
+            out.writeFixed(record.hash);
+        }
+    }
+
+    // Reads a manifest written by save(); throws if it is truncated. From memory input, path lengths
+    // are checked against the bytes that remain before anything is allocated.
+    void load(BinaryReader& in) {
+        std::vector<FileRecord> loaded;
+        uint64_t count = in.readFixed<uint64_t>();
+        loaded.reserve(static_cast<size_t>(count < (1u << 20) ? count : (1u << 20)));  // Don't trust huge counts blindly
+        for (uint64_t i = 0; i < count && in; i++) {
+            FileRecord record;
+            record.path = in.readString();
+            record.size = in.readFixed<uint64_t>();
+            record.mtime = in.readFixed<int64_t>();
+            record.hash = in.readFixed<uint64_t>();
+            loaded.push_back(std::move(record));
+        }
+        if (!in) throw std::runtime_error("Truncated file manifest");
+        std::unique_lock<std::shared_mutex> guard(lock);
+        records = std::move(loaded);
+    }
+};
+
+#endif  // End of include guard
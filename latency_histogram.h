@@ -0,0 +1,150 @@
+// latency_histogram.h
+#ifndef LATENCY_HISTOGRAM_H  // Include guard to prevent multiple inclusions of this header file
+#define LATENCY_HISTOGRAM_H
+
+#include <algorithm>  // For clamping recorded values
+#include <cmath>  // For the percentile rank and the distribution steps
+#include <cstdint>  // For 64-bit values and counts
+#include <iomanip>  // For formatting the distribution
+#include <ostream>  // For writing the distribution
+#include <stdexcept>  // For rejecting bad configurations
+#include <vector>  // For the bucket counts
+
+// HDR (high dynamic range) histogram: records non-negative integer values such as latencies in
+// nanoseconds with a fixed number of significant decimal digits over the whole range, in constant time
+// and memory. Buckets double in width; each is split into the same number of linear sub-buckets, so the
+// relative error of a reported value is bounded by 10^-significantDigits. Not thread-safe; give each
+// thread its own histogram and add() them together.
+class LatencyHistogram {
+private:
+    int64_t highestTrackable;  // Larger values are recorded as this
+    int subBucketHalfCountMagnitude;  // log2(sub-buckets per bucket) - 1
+    int64_t subBucketCount;  // Linear sub-buckets per bucket, a power of two
+    int64_t subBucketHalfCount;  // subBucketCount / 2; every bucket but the first uses only its upper half
+    int64_t subBucketMask;  // Values below subBucketCount fall in bucket 0
+    std::vector<uint64_t> counts;  // Count of values per (bucket, sub-bucket)
+    uint64_t total = 0;  // Number of values recorded
+    int64_t minValue = INT64_MAX;  // Smallest value recorded
+    int64_t maxValue = 0;  // Largest value recorded
+    double sum = 0;  // Sum of the values, for the mean
+
+    static int bitLength(uint64_t v) { return v ? 64 - __builtin_clzll(v) : 0; }
+
+    int bucketIndex(int64_t value) const {
+        return bitLength(static_cast<uint64_t>(value | subBucketMask)) - subBucketHalfCountMagnitude - 1;
+    }
+
+    size_t countsIndex(int64_t value) const {
+        int bucket = bucketIndex(value);
+        int64_t subBucket = value >> bucket;
+        return static_cast<size_t>(((static_cast<int64_t>(bucket) + 1) << subBucketHalfCountMagnitude) + subBucket - subBucketHalfCount);
+    }
+
+    // Smallest value that falls into counts[index]
+    int64_t valueAt(size_t index) const {
+        int bucket = static_cast<int>(static_cast<int64_t>(index) >> subBucketHalfCountMagnitude) - 1;
+        int64_t subBucket = (static_cast<int64_t>(index) & (subBucketHalfCount - 1)) + subBucketHalfCount;
+        if (bucket < 0) {
+            subBucket -= subBucketHalfCount;
+            bucket = 0;
+        }
+        return subBucket << bucket;
+    }
+
+    // Largest value that falls into the same sub-bucket as value
+    int64_t highestEquivalent(int64_t value) const {
+        int bucket = bucketIndex(value);
+        int64_t width = int64_t(1) << bucket;
+        return (value & ~(width - 1)) + width - 1;
+    }
+
+public:
+    // Tracks values in [0, highestTrackableValue] to significantDigits (1..5) decimal digits
+    explicit LatencyHistogram(int64_t highestTrackableValue = 3600LL * 1000 * 1000 * 1000, int significantDigits = 3)
+        : highestTrackable(highestTrackableValue) {
+        if (significantDigits < 1 || significantDigits > 5 || highestTrackableValue < 2) {
+            throw std::invalid_argument("Unsupported histogram range or precision");
+        }
+        int64_t largestSingleUnitResolution = 2 * static_cast<int64_t>(std::pow(10, significantDigits));
+        int subBucketCountMagnitude = bitLength(static_cast<uint64_t>(largestSingleUnitResolution - 1));
+        subBucketHalfCountMagnitude = std::max(subBucketCountMagnitude, 1) - 1;
+        subBucketCount = int64_t(1) << (subBucketHalfCountMagnitude + 1);
+        subBucketHalfCount = subBucketCount / 2;
+        subBucketMask = subBucketCount - 1;
+
+        int buckets = 1;  // Each bucket doubles the range covered
+        for (int64_t untrackable = subBucketCount; untrackable <= highestTrackable; untrackable <<= 1) buckets++;
+        counts.assign(static_cast<size_t>((buckets + 1) * subBucketHalfCount), 0);
+    }
+
+    // Records one value; negative values count as 0 and values beyond the range as the highest trackable
+    void record(int64_t value) {
+        value = std::min(std::max<int64_t>(value, 0), highestTrackable);
+        counts[countsIndex(value)]++;
+        total++;
+        sum += static_cast<double>(value);
+        minValue = std::min(minValue, value);
+        maxValue = std::max(maxValue, value);
+    }
+
+    // Adds every value recorded by other, which must have the same range and precision
+    void add(const LatencyHistogram& other) {
+        if (other.counts.size() != counts.size() || other.subBucketCount != subBucketCount) {
+            throw std::invalid_argument("Cannot add histograms of different shapes");
+        }
+        for (size_t i = 0; i < counts.size(); i++) counts[i] += other.counts[i];
+        total += other.total;
+        sum += other.sum;
+        minValue = std::min(minValue, other.minValue);
+        maxValue = std::max(maxValue, other.maxValue);
+    }
+
+    uint64_t count() const { return total; }  // Number of values recorded
+    int64_t min() const { return total ? minValue : 0; }  // Smallest value recorded
+    int64_t max() const { return maxValue; }  // Largest value recorded, exactly
+    double mean() const { return total ? sum / static_cast<double>(total) : 0.0; }  // Mean of the values recorded
+
+    // Value at or below which percentile (0..100) of the recorded values fall, to the histogram's precision
+    int64_t valueAtPercentile(double percentile) const {
+        if (total == 0) return 0;
+        double rank = std::ceil(std::min(std::max(percentile, 0.0), 100.0) / 100.0 * static_cast<double>(total));
+        uint64_t target = std::max<uint64_t>(1, static_cast<uint64_t>(rank));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < counts.size(); i++) {
+            seen += counts[i];
+            if (seen >= target) return std::min(highestEquivalent(valueAt(i)), maxValue);
+        }
+        return maxValue;
+    }
+
+    // Writes the percentile distribution in HdrHistogram's text (.hgrm) format, with values divided by
+    // scale (e.g. 1000 for nanoseconds recorded, microseconds shown). Percentiles get ticksPerHalfDistance
+    // steps each time the remaining distance to 100% halves, so the tail is shown in detail.
+    void writeDistribution(std::ostream& out, double scale = 1.0, int ticksPerHalfDistance = 5) const {
+        out << std::setw(12) << "Value" << " " << std::setw(14) << "Percentile" << " " << std::setw(10)
+            << "TotalCount" << " " << std::setw(14) << "1/(1-Percentile)" << "\n\n";
+        auto line = [&](double percentile) {
+            int64_t value = valueAtPercentile(percentile * 100);
+            uint64_t below = 0;  // Values at or below value
+            for (size_t i = 0; i < counts.size() && valueAt(i) <= value; i++) below += counts[i];
+            out << std::fixed << std::setprecision(3) << std::setw(12) << static_cast<double>(value) / scale << " "
+                << std::setprecision(12) << std::setw(14) << percentile << " " << std::setw(10) << below;
+            if (percentile < 1.0) out << " " << std::setprecision(2) << std::setw(14) << 1.0 / (1.0 - percentile);
+            out << "\n";
+        };
+        if (total) {
+            for (int step = 0;; step++) {
+                double percentile = 1.0 - std::pow(0.5, static_cast<double>(step) / ticksPerHalfDistance);
+                if ((1.0 - percentile) * static_cast<double>(total) < 1.0) break;  // Finer than one value
+                line(percentile);
+            }
+            line(1.0);
+        }
+        out << std::fixed << std::setprecision(3) << "#[Mean    = " << std::setw(12) << mean() / scale
+            << ", Max = " << std::setw(12) << static_cast<double>(max()) / scale << "]\n"
+            << "#[Total count    = " << std::setw(12) << total << "]\n";
+        out.unsetf(std::ios::floatfield);
+    }
+};
+
+#endif  // End of include guard
@@ -0,0 +1,202 @@
+// lazy_postings.h
+#ifndef LAZY_POSTINGS_H  // Include guard to prevent multiple inclusions of this header file
+#define LAZY_POSTINGS_H
+
+#include "binary_io.h"  // For scanning the dictionary and decoding postings
+#include "posting_list.h"  // The cached values
+#include <algorithm>  // For binary searching the sorted dictionary
+#include <cstdint>  // For file offsets
+#include <fstream>  // For reading postings on demand
+#include <list>  // For the LRU order
+#include <memory>  // For sharing cached lists with the queries using them
+#include <mutex>  // For the cache and the shared read stream
+#include <stdexcept>  // For reporting unreadable index files
+#include <string>  // For terms and file names
+#include <unordered_map>  // For the cache lookup table
+#include <utility>  // For std::move
+#include <vector>  // For the dictionary arrays
+
+// Byte-bounded LRU cache of posting lists read from disk, shared by every lazily loaded field.
+// Lists larger than the whole cache are returned to the caller but not kept.
+class PostingCache {
+public:
+    struct Stats {  // Counters since the cache was created
+        size_t hits = 0;  // Lookups served from memory
+        size_t misses = 0;  // Lookups that read the list from disk
+        size_t evictions = 0;  // Lists dropped to stay within the capacity
+        size_t entries = 0;  // Lists currently cached
+        size_t bytes = 0;  // Memory held by the cached lists
+        size_t capacity = 0;  // Upper bound on bytes
+
+        double hitRatio() const { return hits + misses ? static_cast<double>(hits) / (hits + misses) : 0.0; }
+    };
+
+private:
+    using Entry = std::pair<std::string, std::shared_ptr<PostingList>>;  // (cache key, list)
+
+    std::list<Entry> order;  // Most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> entries;  // Cache key -> position in order
+    std::unordered_map<std::string, size_t> sizes;  // Cache key -> bytes charged for the list
+    Stats counters;  // Running statistics
+    mutable std::mutex lock;  // Guards everything above
+
+    // Drops least recently used lists until bytes fit the capacity. Callers hold the lock.
+    void evict() {
+        while (counters.bytes > counters.capacity && !order.empty()) {
+            const std::string& key = order.back().first;
+            counters.bytes -= sizes[key];
+            sizes.erase(key);
+            entries.erase(key);
+            order.pop_back();
+            counters.evictions++;
+        }
+        counters.entries = order.size();
+    }
+
+public:
+    explicit PostingCache(size_t capacityBytes = 0) { counters.capacity = capacityBytes; }
+    PostingCache(const PostingCache&) = delete;
+    PostingCache& operator=(const PostingCache&) = delete;
+
+    // Changes the byte bound, evicting as needed
+    void setCapacity(size_t capacityBytes) {
+        std::lock_guard<std::mutex> guard(lock);
+        counters.capacity = capacityBytes;
+        evict();
+    }
+
+    // Returns the cached list for key, or reads it with load() and caches it
+    template<typename Load>
+    std::shared_ptr<PostingList> get(const std::string& key, Load&& load) {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            auto it = entries.find(key);
+            if (it != entries.end()) {
+                order.splice(order.begin(), order, it->second);  // Now the most recently used
+                counters.hits++;
+                return it->second->second;
+            }
+            counters.misses++;
+        }
+        std::shared_ptr<PostingList> list = load();  // Read outside the lock so other terms are not blocked
+        size_t bytes = list->memoryBytes() + key.size();
+        std::lock_guard<std::mutex> guard(lock);
+        if (bytes > counters.capacity || entries.count(key)) return list;  // Too large, or another thread won
+        order.emplace_front(key, list);
+        entries.emplace(key, order.begin());
+        sizes.emplace(key, bytes);
+        counters.bytes += bytes;
+        evict();
+        return list;
+    }
+
+    // Current counters
+    Stats stats() const {
+        std::lock_guard<std::mutex> guard(lock);
+        return counters;
+    }
+};
+
+// The postings of one field, with only the term dictionary in memory. The dictionary holds every term
+// of a tree file written by AVLTree::saveToFile and the offset of its postings; the postings are read on
+// first access and kept in a PostingCache.
+class LazyPostingIndex {
+public:
+    // What forEachWithPrefix visits; shaped like an AVLNode so the same helpers work on both
+    struct Entry {
+        const std::string& key;  // Term
+        std::shared_ptr<PostingList> value;  // Its postings, read through the cache
+    };
+
+private:
+    std::string filename;  // Tree file holding the postings
+    std::string cacheTag;  // Prepended to terms so fields share one cache without collisions
+    PostingCache* cache = nullptr;  // Where read lists are kept
+    std::vector<std::string> terms;  // Every term, sorted
+    std::vector<uint64_t> offsets;  // File offset of each term's postings
+    mutable std::ifstream in;  // Read stream shared by lookups
+    mutable std::mutex readLock;  // Serializes use of in
+
+    static constexpr size_t scanBuffer = 64 * 1024;  // Small, so the scan seeks over long postings instead of reading them
+
+    // Reads the postings of terms[i] from disk
+    std::shared_ptr<PostingList> read(size_t i) const {
+        auto list = std::make_shared<PostingList>();
+        std::lock_guard<std::mutex> guard(readLock);
+        in.clear();
+        in.seekg(static_cast<std::streamoff>(offsets[i]));
+        BinaryReader reader(in, scanBuffer);
+        list->load(reader);
+        if (!reader) throw std::runtime_error("Truncated postings in " + filename);
+        return list;
+    }
+
+    // Postings of terms[i], from the cache if possible
+    std::shared_ptr<PostingList> fetch(size_t i) const {
+        return cache->get(cacheTag + terms[i], [&]() { return read(i); });
+    }
+
+public:
+    LazyPostingIndex() = default;
+    LazyPostingIndex(const LazyPostingIndex&) = delete;
+    LazyPostingIndex& operator=(const LazyPostingIndex&) = delete;
+
+    // Reads the term dictionary of a tree file of posting lists, skipping over the postings themselves
+    void open(const std::string& file, PostingCache& postingCache, const std::string& tag) {
+        std::lock_guard<std::mutex> guard(readLock);
+        filename = file;
+        cache = &postingCache;
+        cacheTag = tag;
+        terms.clear();
+        offsets.clear();
+        if (in.is_open()) in.close();
+        in.clear();
+        in.open(filename, std::ios::binary | std::ios::ate);
+        if (!in) throw std::runtime_error("Cannot read " + filename);
+        uint64_t fileSize = static_cast<uint64_t>(in.tellg());
+        in.seekg(0);
+
+        BinaryReader reader(in, scanBuffer);
+        uint64_t count = reader.readFixed<uint64_t>();
+        if (!reader || count > fileSize) throw std::runtime_error("Truncated index file " + filename);
+        terms.reserve(static_cast<size_t>(count));
+        offsets.reserve(static_cast<size_t>(count));
+        for (uint64_t i = 0; i < count && reader; i++) {
+            terms.push_back(reader.readString());
+            offsets.push_back(reader.position());
+            uint64_t documents = reader.readFixed<uint64_t>();  // PostingList::save: count, then (doc, freq) pairs
+            reader.skip(documents * (sizeof(uint32_t) + sizeof(int32_t)));
+        }
+        if (!reader || reader.position() > fileSize) throw std::runtime_error("Truncated index file " + filename);
+    }
+
+    bool isOpen() const { return cache != nullptr; }  // True once a dictionary was loaded
+    size_t termCount() const { return terms.size(); }  // Number of terms in the dictionary
+
+    // Bytes held by the dictionary itself
+    size_t dictionaryBytes() const {
+        size_t bytes = terms.capacity() * sizeof(std::string) + offsets.capacity() * sizeof(uint64_t);
+        for (const auto& term : terms) bytes += term.capacity() > 15 ? term.capacity() + 1 : 0;  // Beyond the inline buffer
+        return bytes;
+    }
+
+    // Finds a term's postings; returns false if the term is not in the dictionary
+    bool find(const std::string& key, std::shared_ptr<PostingList>& value) const {
+        auto it = std::lower_bound(terms.begin(), terms.end(), key);
+        if (it == terms.end() || *it != key) return false;
+        value = fetch(static_cast<size_t>(it - terms.begin()));
+        return true;
+    }
+
+    // Calls visit(entry) for each term starting with prefix, in sorted order, until visit returns false.
+    // Postings are read only for the terms visited.
+    template<typename Visit>
+    void forEachWithPrefix(const std::string& prefix, Visit visit) const {
+        for (auto it = std::lower_bound(terms.begin(), terms.end(), prefix);
+             it != terms.end() && it->compare(0, prefix.size(), prefix) == 0; ++it) {
+            if (!visit(Entry{*it, fetch(static_cast<size_t>(it - terms.begin()))})) return;
+        }
+    }
+};
+
+#endif  // End of include guard
@@ -0,0 +1,113 @@
+// live_docs.h
+#ifndef LIVE_DOCS_H  // Include guard to prevent multiple inclusions of this header file
+#define LIVE_DOCS_H
+
+#include "binary_io.h"  // For persisting the bitmap with the index
+#include <atomic>  // For atomic publication of the bitmap
+#include <cstdint>  // For 64-bit bitmap words and document IDs
+#include <memory>  // For sharing one bitmap version between queries
+#include <mutex>  // For serializing deletions
+#include <utility>  // For std::move
+#include <vector>  // For the bitmap words
+
+// Bitmap of deleted document IDs. Postings of a deleted document stay in the index until a merge purges
+// them; queries skip them with one bit test per document. Deletions copy the bitmap and publish the copy,
+// so queries read a fixed version without locking. IDs beyond the bitmap are live.
+class LiveDocs {
+public:
+    using Bits = std::vector<uint64_t>;  // Bit i set = document i deleted
+
+    // One published version of the bitmap, kept alive by the query holding it
+    class Snapshot {
+    private:
+        std::shared_ptr<const Bits> deleted;  // Null when nothing is deleted
+
+    public:
+        Snapshot() = default;
+        explicit Snapshot(std::shared_ptr<const Bits> bits) : deleted(std::move(bits)) {}
+
+        // Whether a document's postings should still be returned
+        bool isLive(uint32_t docId) const {
+            if (!deleted || docId / 64 >= deleted->size()) return true;
+            return ((*deleted)[docId / 64] >> (docId % 64) & 1) == 0;
+        }
+
+        bool hasDeletions() const { return deleted != nullptr; }  // False when every document is live
+    };
+
+private:
+    std::shared_ptr<const Bits> deleted;  // Read with std::atomic_load; null until the first deletion
+    std::mutex writeLock;  // Serializes deletions
+    size_t count = 0;  // Number of deleted documents, guarded by writeLock
+
+public:
+    LiveDocs() = default;
+    LiveDocs(const LiveDocs&) = delete;
+    LiveDocs& operator=(const LiveDocs&) = delete;
+
+    // Current version of the bitmap
+    Snapshot snapshot() const { return Snapshot(std::atomic_load(&deleted)); }
+
+    // Whether a document's postings should still be returned
+    bool isLive(uint32_t docId) const { return snapshot().isLive(docId); }
+
+    // Marks documents deleted in one new version; returns how many were live before
+    size_t markDeleted(const std::vector<uint32_t>& docIds) {
+        std::lock_guard<std::mutex> guard(writeLock);
+        auto current = std::atomic_load(&deleted);
+        auto next = current ? std::make_shared<Bits>(*current) : std::make_shared<Bits>();
+        size_t newlyDeleted = 0;
+        for (uint32_t docId : docIds) {
+            if (docId / 64 >= next->size()) next->resize(docId / 64 + 1, 0);
+            uint64_t bit = uint64_t(1) << (docId % 64);
+            if (!((*next)[docId / 64] & bit)) newlyDeleted++;
+            (*next)[docId / 64] |= bit;
+        }
+        if (newlyDeleted == 0) return 0;
+        count += newlyDeleted;
+        std::atomic_store(&deleted, std::shared_ptr<const Bits>(std::move(next)));
+        return newlyDeleted;
+    }
+
+    // Marks one document deleted; returns false if it already was
+    bool markDeleted(uint32_t docId) { return markDeleted(std::vector<uint32_t>{docId}) != 0; }
+
+    // Number of deleted documents
+    size_t deletedCount() {
+        std::lock_guard<std::mutex> guard(writeLock);
+        return count;
+    }
+
+    // Bytes held by the current bitmap
+    size_t memoryBytes() const {
+        auto current = std::atomic_load(&deleted);
+        return current ? sizeof(Bits) + current->capacity() * sizeof(uint64_t) : 0;
+    }
+
+    // Writes the bitmap as a word count followed by the words, all little-endian 64-bit
+    void save(BinaryWriter& out) const {
+        auto current = std::atomic_load(&deleted);
+        out.writeFixed<uint64_t>(current ? current->size() : 0);
+        if (current) {
+            for (uint64_t word : *current) out.writeFixed(word);
+        }
+    }
+
+    // Reads a bitmap written by save; leaves the bitmap unchanged and the reader failed if it is
+    // truncated. The word count is not trusted for allocation: words are read until it or the input ends.
+    void load(BinaryReader& in) {
+        uint64_t words = in.readFixed<uint64_t>();
+        auto bits = std::make_shared<Bits>();
+        bits->reserve(static_cast<size_t>(words < (1u << 20) ? words : (1u << 20)));
+        for (uint64_t i = 0; i < words && in; i++) bits->push_back(in.readFixed<uint64_t>());
+        if (!in) return;
+        size_t deletedDocs = 0;
+        for (uint64_t word : *bits) deletedDocs += __builtin_popcountll(word);
+
+        std::lock_guard<std::mutex> guard(writeLock);
+        count = deletedDocs;
+        std::atomic_store(&deleted, deletedDocs ? std::shared_ptr<const Bits>(std::move(bits)) : std::shared_ptr<const Bits>());
+    }
+};
+
+#endif  // End of include guard
@@ -1,8 +1,6 @@
 // Include necessary header files
 #include "searchEngine.h" // Provides the SearchEngine class for indexing and searching
-#include "document_info.h" // Provides document-related utilities
-#include "rapidjson/document.h" // For JSON parsing
-#include "rapidjson/istreamwrapper.h" // Wrapper for JSON stream parsing
+#include "trace.h" // Chrome trace export, when compiled in
 #include <iostream> // For input/output operations
 #include <iomanip> // For output formatting
 #include <string> // For string manipulation
@@ -10,10 +8,49 @@
 #include <fstream> // For file handling
 #include <limits> // For input validation
 #include <filesystem> // For handling file system paths
+#include <cstdlib> // For malloc and free in the counting allocator, and getenv
+#include <cstddef> // For the counting allocator's block alignment
 
 // Alias the filesystem namespace for convenience
 namespace fs = std::filesystem;
 
+#ifdef SUPERSEARCH_COUNT_ALLOCATIONS
+// Counting allocator: attributes every heap allocation to the build statistics of the calling thread,
+// and keeps the heap bytes in use for the stats command. Each block is prefixed with its size.
+static constexpr std::size_t allocationHeader = alignof(std::max_align_t);
+void* operator new(std::size_t size) {
+    BuildStats::countAllocation();
+    if (char* memory = static_cast<char*>(std::malloc(size + allocationHeader))) {
+        *reinterpret_cast<std::size_t*>(memory) = size;
+        HeapCounter::allocated(size);
+        return memory + allocationHeader;
+    }
+    throw std::bad_alloc();
+}
+void operator delete(void* memory) noexcept {
+    if (!memory) return;
+    char* block = static_cast<char*>(memory) - allocationHeader;
+    HeapCounter::freed(*reinterpret_cast<std::size_t*>(block));
+    std::free(block);
+}
+void operator delete(void* memory, std::size_t) noexcept { operator delete(memory); }
+#endif
+
+#ifdef SUPERSEARCH_TRACING
+// Writes the spans recorded by this run to a Chrome trace file when main returns
+struct TraceExport {
+    std::string path;  // Absolute, since commands change directory; empty = no export
+    ~TraceExport() {
+        if (path.empty()) return;
+        try {
+            Tracer::writeChromeTrace(path);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << "\n";
+        }
+    }
+};
+#endif
+
 // Function to clear the console screen
 void clearScreen() {
     #ifdef _WIN32
@@ -30,100 +67,80 @@ void displayMenu() {
     std::cout << "1. Create new index\n"; // Option to create a new index
     std::cout << "2. Load existing index\n"; // Option to load an existing index
     std::cout << "3. Search\n"; // Option to perform a search
-    std::cout << "4. Exit\n"; // Option to exit the program
+    std::cout << "4. Count matches\n"; // Option to count the documents matching a query
+    std::cout << "5. Check for any match\n"; // Option to test whether any document matches a query
+    std::cout << "6. Exit\n"; // Option to exit the program
     std::cout << "============================\n"; // Decorative separator
     std::cout << "Choice: "; // Prompt for user input
 }
 
-// Function to display search results
-void displayResults(const std::vector<std::string>& results) {
-    std::cout << "\nFound " << results.size() << " results:\n\n"; // Display the number of results
+// Number of results shown per page
+const size_t resultsPerPage = 15;
+
+// Function to display one page of search results; first is the rank of the page's first result
+void displayResults(const std::unique_ptr<SearchEngine>& engine, const SearchEngine::Page& page, size_t first = 1) {
+    std::cout << "\nFound " << page.totalHits << " results:\n\n"; // Display the number of results
 
-    int count = 0; // Initialize counter for results
-    for (const auto& filepath : results) { // Iterate through the result file paths
-        if (count++ >= 15) break; // Limit display to the first 15 results
+    size_t count = first - 1; // Initialize counter for results
+    for (const auto& filepath : page.results) { // Iterate through the result file paths
+        count++;
         std::cout << count << ". File: " << filepath << "\n"; // Display the file path
 
-        // Attempt to display the title from the JSON file
-        std::ifstream file(filepath); // Open the file
-        if (file) { 
-            rapidjson::IStreamWrapper isw(file); // Wrap the file stream for JSON parsing
-            rapidjson::Document document; // Create a JSON document
-            if (!document.ParseStream(isw).HasParseError() && // Parse the file and check for errors
-                document.HasMember("title") && // Check if the title field exists
-                document["title"].IsString()) { // Ensure the title is a string
-                std::cout << "   Title: " << document["title"].GetString() << "\n"; // Display the title
+        // Display the title from the document store (one lookup, no JSON parsing)
+        StoredDocument document;
+        if (engine->storedDocument(filepath, document)) {
+            std::cout << "   Title: " << document.title << "\n"; // Display the title
+            if (!document.publication.empty() || !document.published.empty()) {
+                std::cout << "   " << document.publication << (document.publication.empty() ? "" : "  ")
+                          << document.published << "\n"; // Display where and when it was published
             }
         }
         std::cout << "\n"; // Add spacing between results
     }
 
-    if (results.size() > 15) { // Notify if more results are available
-        std::cout << "(Showing first 15 of " << results.size() << " results)\n";
+    if (page.hasMore) { // Notify if more results are available
+        std::cout << "(Showing " << first << "-" << count << " of " << page.totalHits << " results)\n";
     }
 }
 
 // Function to display the contents of a document
-void displayDocument(const std::string& filepath) {
-    fs::path fullPath = fs::absolute(filepath); // Convert relative path to absolute path
-
-    // Print debug information about the file path
-    std::cout << "Attempting to open: " << fullPath.string() << "\n";
-
-    std::ifstream file(fullPath); // Open the file
-    if (!file) { // Handle file open errors
-        std::cout << "Error: Could not open file " << fullPath.string() << "\n";
-        if (!fs::exists(fullPath)) { // Check if the file exists
-            std::cout << "File does not exist at specified path.\n";
-        } else {
-            std::cout << "File exists but could not be opened. Check permissions.\n";
-        }
-        return; // Exit the function if file could not be opened
-    }
-
-    rapidjson::IStreamWrapper isw(file); // Wrap the file stream for JSON parsing
-    rapidjson::Document document; // Create a JSON document
-    document.ParseStream(isw); // Parse the JSON file
-
-    if (document.HasParseError()) { // Handle JSON parsing errors
-        std::cout << "Error: Failed to parse JSON file\n";
-        return;
+void displayDocument(const std::unique_ptr<SearchEngine>& engine, const std::string& filepath) {
+    StoredDocument document;
+    if (!engine->storedDocument(filepath, document, true)) { // Read the stored fields and decompress the text
+        std::cout << "Error: " << filepath << " is not in the document store\n";
+        return; // Exit the function if the document is unknown
     }
 
     // Display document details
     std::cout << "\n===========================================\n\n";
 
-    if (document.HasMember("title") && document["title"].IsString()) { // Display title if present
-        std::cout << "Title: " << document["title"].GetString() << "\n\n";
+    if (!document.title.empty()) { // Display title if present
+        std::cout << "Title: " << document.title << "\n\n";
     }
 
-    if (document.HasMember("published") && document["published"].IsString()) { // Display published date if present
-        std::cout << "Date: " << document["published"].GetString() << "\n\n";
+    if (!document.published.empty()) { // Display published date if present
+        std::cout << "Date: " << document.published << "\n\n";
     }
 
-    if (document.HasMember("text") && document["text"].IsString()) { // Display text content if present
-        std::cout << "Content:\n" << document["text"].GetString() << "\n";
+    if (!document.publication.empty()) { // Display publication if present
+        std::cout << "Publication: " << document.publication << "\n\n";
     }
 
-    if (document.HasMember("entities") && document["entities"].IsObject()) { // Display entities if present
-        const auto& entities = document["entities"];
+    if (!document.text.empty()) { // Display text content if present
+        std::cout << "Content:\n" << document.text << "\n";
+    }
 
-        if (entities.HasMember("organizations") && entities["organizations"].IsArray()) { // Display organizations
-            std::cout << "\nOrganizations mentioned:\n";
-            for (const auto& org : entities["organizations"].GetArray()) {
-                if (org.HasMember("name") && org["name"].IsString()) {
-                    std::cout << "- " << org["name"].GetString() << "\n";
-                }
-            }
+    if (!document.organizations.empty()) { // Display organizations
+        std::cout << "\nOrganizations mentioned:\n";
+        for (const auto& org : document.organizations) {
+            std::cout << "- " << org << "\n";
         }
+    }
 
-        if (entities.HasMember("persons") && entities["persons"].IsArray()) { // Display persons
-            std::cout << "\nPersons mentioned:\n";
-            for (const auto& person : entities["persons"].GetArray()) {
-                if (person.HasMember("name") && person["name"].IsString()) {
-                    std::cout << "- " << person["name"].GetString() << "\n";
-                }
-            }
+    if (!document.persons.empty()) { // Display persons
+        std::cout << "\nPersons mentioned:\n";
+        for (const auto& person : document.persons) {
+            std::cout << "- " << person << "\n";
         }
     }
 
@@ -133,6 +150,32 @@ void displayDocument(const std::string& filepath) {
     std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n'); // Wait for Enter key
 }
 
+// Function to handle the count and exists operations: prints the number of matching documents, or
+// whether there is any, without looking up a single result
+void handleCount(const std::unique_ptr<SearchEngine>& engine, bool existsOnly) {
+    // Check if the engine is initialized
+    if (!engine) {
+        std::cout << "Please create or load an index first.\n";
+        return;  // Return if engine is not initialized
+    }
+
+    // Prompt user to enter a search query
+    std::cout << "Enter search query: ";
+    std::string query;
+    std::getline(std::cin, query);  // Get search query from user input
+    if (query.empty()) {
+        std::cout << "Empty search query. Please try again.\n";
+        return;  // Return if query is empty
+    }
+
+    try {
+        if (existsOnly) std::cout << (engine->exists(query) ? "At least one document matches.\n" : "No document matches.\n");
+        else std::cout << engine->count(query) << " documents match.\n";
+    } catch (const std::exception& e) {
+        std::cout << "Error: " << e.what() << "\n";  // Malformed dates are reported, not fatal
+    }
+}
+
 // Function to handle the search operation
 void handleSearch(const std::unique_ptr<SearchEngine>& engine) {
     // Check if the engine is initialized
@@ -152,26 +195,48 @@ void handleSearch(const std::unique_ptr<SearchEngine>& engine) {
         return;  // Return if query is empty
     }
 
-    // Perform search and store the results
-    auto results = engine->search(query);
-    displayResults(results);  // Display the search results
+    // Perform search and store the first page of results
+    SearchEngine::Page page;
+    try {
+        page = engine->search(query, resultsPerPage);
+    } catch (const std::exception& e) {
+        std::cout << "Error: " << e.what() << "\n";  // Malformed dates are reported, not fatal
+        return;
+    }
+    size_t first = 1;  // Rank of the first result on the page
+    displayResults(engine, page, first);  // Display the search results
 
     // If there are results, allow the user to view articles
-    if (!results.empty()) {
+    if (!page.results.empty()) {
         while (true) {
             // Prompt user to select a result number or return to the menu
-            std::cout << "\nEnter result number to view full article (0 to return to menu): ";
+            std::cout << "\nEnter result number to view full article" << (page.hasMore ? ", n for the next page" : "")
+                      << " (0 to return to menu): ";
             std::string input;
             
             // Clear any leftover input in the input buffer
             std::cin.clear();
-            std::getline(std::cin, input);  // Get input from user
+            if (!std::getline(std::cin, input)) break;  // Get input from user; at the end of the input, return
 
             // If the input is empty, continue to next iteration
             if (input.empty()) {
                 continue;
             }
 
+            // Continue from where the page ended, without ranking the earlier results again
+            if (input == "n" && page.hasMore) {
+                try {
+                    SearchEngine::Page next = engine->search(query, resultsPerPage, page.next);
+                    first += page.results.size();
+                    page = std::move(next);
+                } catch (const std::exception& e) {
+                    std::cout << "Error: " << e.what() << "\n";
+                    break;  // Back to the menu
+                }
+                displayResults(engine, page, first);
+                continue;
+            }
+
             // Attempt to convert the input to an integer
             int resultNum;
             try {
@@ -187,11 +252,8 @@ void handleSearch(const std::unique_ptr<SearchEngine>& engine) {
             }
 
             // If the result number is valid, display the article
-            if (resultNum > 0 && resultNum <= std::min<int>(results.size(), 15)) {
-                // Get the current working directory to display the document
-                fs::path currentPath = fs::current_path();
-                std::string fullPath = (currentPath / results[resultNum - 1]).string();
-                displayDocument(fullPath);  // Display the selected document
+            if (resultNum >= static_cast<int>(first) && resultNum < static_cast<int>(first + page.results.size())) {
+                displayDocument(engine, page.results[resultNum - first]);  // Display the selected document
 
                 // Wait for user to press Enter before continuing
                 std::cout << "\nPress Enter to continue...";
@@ -207,16 +269,41 @@ void handleSearch(const std::unique_ptr<SearchEngine>& engine) {
 
 // Main function for the program
 int main(int argc, char* argv[]) {
+#ifdef SUPERSEARCH_TRACING
+    const char* traceFile = std::getenv("SUPERSEARCH_TRACE_FILE"); // Where to write the spans of this run
+    TraceExport traceExport{traceFile ? fs::absolute(traceFile).string() : std::string()};
+#endif
     // Unique pointer to hold the search engine object
     std::unique_ptr<SearchEngine> engine;
 
-    // Ensure the correct number of arguments are passed
-    if (argc != 2) {
+    // Ensure a command was passed
+    if (argc < 2) {
         std::cout << "Usage: " << argv[0] << " <command> [arguments]\n";
         std::cout << "Commands:\n";
-        std::cout << "  index <directory>   - Create index from documents in directory\n";
-        std::cout << "  query \"query text\" - Search the index\n";
+        std::cout << "  index <directory> [memory-MB] [--stats-json FILE] - Create index from documents in directory,\n";
+        std::cout << "                      flushing to disk whenever postings exceed memory-MB;\n";
+        std::cout << "                      if an index exists, only added, changed and deleted\n";
+        std::cout << "                      files are processed; --stats-json also writes the\n";
+        std::cout << "                      build phase timings to FILE\n";
+        std::cout << "  query \"query text\" [cache-MB] [--limit K] [--after CURSOR] - Search the index;\n";
+        std::cout << "                      with cache-MB, only term dictionaries are loaded and\n";
+        std::cout << "                      postings are read on demand into a cache of that size;\n";
+        std::cout << "                      shows K results (default 15) after CURSOR, printing the\n";
+        std::cout << "                      cursor of the next page\n";
+        std::cout << "                      Queries may be narrowed by publication date with\n";
+        std::cout << "                      after:YYYY-MM-DD (on or after) and before:YYYY-MM-DD\n";
+        std::cout << "  count \"query text\" [cache-MB] - Print the number of matching documents\n";
+        std::cout << "  exists \"query text\" [cache-MB] - Print whether any document matches\n";
+        std::cout << "  facets \"query text\" [cache-MB] [--top N] - Print the N (default 10) organizations\n";
+        std::cout << "                      and persons named by the most matching documents\n";
+        std::cout << "  delete <file>       - Remove a document from the index\n";
+        std::cout << "  compact             - Rewrite the index without the postings of deleted documents\n";
+        std::cout << "  stats [cache-MB] [--json] - Report the memory held by each index component,\n";
+        std::cout << "                      term counts and the longest posting lists\n";
         std::cout << "  ui                  - Start interactive interface\n";
+#ifdef SUPERSEARCH_TRACING
+        std::cout << "Set SUPERSEARCH_TRACE_FILE to write a Chrome trace of the run to that file.\n";
+#endif
         return 1;  // Return if incorrect number of arguments
     }
 
@@ -247,7 +334,10 @@ int main(int argc, char* argv[]) {
             displayMenu();  // Display the menu options
 
             std::string input;
-            std::getline(std::cin, input);  // Get input from user
+            if (!std::getline(std::cin, input)) {  // Get input from user; at the end of the input, exit
+                fs::current_path(baseDir);
+                return 0;
+            }
 
             // If the input is empty, continue to the next iteration
             if (input.empty()) {
@@ -287,7 +377,15 @@ int main(int argc, char* argv[]) {
                     handleSearch(engine);  // Call the search handler function
                     break;
 
-                case '4':  // Option to exit the program
+                case '4':  // Option to count the matching documents
+                    handleCount(engine, false);
+                    break;
+
+                case '5':  // Option to check whether any document matches
+                    handleCount(engine, true);
+                    break;
+
+                case '6':  // Option to exit the program
                     // Change back to the original directory before exiting
                     fs::current_path(baseDir);
                     std::cout << "Goodbye!\n";
@@ -302,7 +400,7 @@ int main(int argc, char* argv[]) {
     // Case when the 'index' command is used
     else if (command == "index") {
         // Ensure the directory argument is provided for indexing
-        if (argc != 3) {
+        if (argc < 3 || argc > 6) {
             std::cerr << "Missing directory argument for index command\n";
             return 1;  // Return if directory argument is missing
         }
@@ -314,9 +412,30 @@ int main(int argc, char* argv[]) {
                 return 1;  // Return if the directory does not exist
             }
 
+            // Optional memory budget for the postings held in RAM while building, and build statistics file
+            size_t memoryBudget = 0;
+            std::string statsPath;
+            for (int i = 3; i < argc; i++) {
+                if (std::string(argv[i]) == "--stats-json" && i + 1 < argc) {
+                    statsPath = fs::absolute(argv[++i]).string();
+                } else {
+                    memoryBudget = std::stoul(argv[i]) * 1024 * 1024;
+                }
+            }
+
             fs::current_path(indexPath);  // Change to the specified directory
             engine = std::make_unique<SearchEngine>(".", "index.dat", "org.dat",
-                                                  "name.dat", "word.dat", "freq.dat");
+                                                  "name.dat", "word.dat", "freq.dat", memoryBudget);
+            if (!statsPath.empty() && engine->buildStats()) {
+                std::ofstream stats(statsPath);
+                engine->buildStats()->writeJson(stats);
+                if (!stats) throw std::runtime_error("Cannot write " + statsPath);
+            }
+            // An existing index is brought up to date: only added, changed and deleted files are processed
+            SearchEngine::IndexUpdate update = engine->updateIndex(".");
+            std::cout << "Added " << update.added << ", changed " << update.changed << ", deleted "
+                      << update.deleted << ", unchanged " << update.unchanged << " documents.\n";
+            engine->waitForMerges();  // Finish compacting segments before exiting
             std::cout << "Index created successfully!\n";
         } catch (const std::exception& e) {
             std::cerr << "Error creating index: " << e.what() << "\n";
@@ -326,21 +445,145 @@ int main(int argc, char* argv[]) {
     // Case when the 'query' command is used
     else if (command == "query") {
         // Ensure the query argument is provided
-        if (argc != 3) {
+        if (argc < 3) {
             std::cerr << "Missing query argument for query command\n";
             return 1;  // Return if the query argument is missing
         }
         try {
+            // Optional posting cache (load only the term dictionaries and read postings on demand), page
+            // size and position
+            size_t postingCacheBytes = 0;
+            size_t limit = resultsPerPage;
+            SearchEngine::Cursor after;
+            for (int i = 3; i < argc; i++) {
+                std::string option = argv[i];
+                if (option == "--limit" && i + 1 < argc) limit = std::stoul(argv[++i]);
+                else if (option == "--after" && i + 1 < argc) after = SearchEngine::Cursor::parse(argv[++i]);
+                else postingCacheBytes = std::stoul(option) * 1024 * 1024;
+            }
+
             // Create a new search engine and perform a search
             engine = std::make_unique<SearchEngine>(".", "index.dat", "org.dat",
-                                                  "name.dat", "word.dat", "freq.dat");
-            auto results = engine->search(argv[2]);  // Perform the search
-            displayResults(results);  // Display the search results
+                                                  "name.dat", "word.dat", "freq.dat", 0, postingCacheBytes);
+            auto page = engine->search(argv[2], limit, after);  // Rank every match, keeping only the requested page
+            displayResults(engine, page);  // Display the search results
+            if (page.hasMore) std::cout << "Next page: --after " << page.next.toString() << "\n";
+            if (postingCacheBytes) {
+                PostingCache::Stats cache = engine->postingCacheStats();
+                std::cout << "Posting cache: " << cache.hits << " hits, " << cache.misses << " misses ("
+                          << std::fixed << std::setprecision(1) << cache.hitRatio() * 100 << "% hit ratio), "
+                          << cache.entries << " lists, " << cache.bytes << " of " << cache.capacity << " bytes\n";
+            }
         } catch (const std::exception& e) {
             std::cerr << "Error during search: " << e.what() << "\n";
             return 1;  // Return if an error occurs during search
         }
     }
+    // Case when the 'count' or 'exists' command is used: answer without looking up any result
+    else if (command == "count" || command == "exists") {
+        if (argc < 3 || argc > 4) {
+            std::cerr << "Missing query argument for " << command << " command\n";
+            return 1;
+        }
+        try {
+            size_t postingCacheBytes = argc == 4 ? std::stoul(argv[3]) * 1024 * 1024 : 0;
+            std::streambuf* saved = std::cout.rdbuf(std::cerr.rdbuf()); // Keep the answer alone on stdout
+            engine = std::make_unique<SearchEngine>(".", "index.dat", "org.dat",
+                                                  "name.dat", "word.dat", "freq.dat", 0, postingCacheBytes);
+            std::cout.rdbuf(saved);
+            if (command == "count") std::cout << engine->count(argv[2]) << "\n";
+            else std::cout << (engine->exists(argv[2]) ? "true" : "false") << "\n";
+        } catch (const std::exception& e) {
+            std::cerr << "Error during search: " << e.what() << "\n";
+            return 1;
+        }
+    }
+    // Case when the 'facets' command is used
+    else if (command == "facets") {
+        if (argc < 3) {
+            std::cerr << "Missing query argument for facets command\n";
+            return 1;
+        }
+        try {
+            size_t postingCacheBytes = 0;
+            size_t top = 10;
+            for (int i = 3; i < argc; i++) {
+                std::string option = argv[i];
+                if (option == "--top" && i + 1 < argc) top = std::stoul(argv[++i]);
+                else postingCacheBytes = std::stoul(option) * 1024 * 1024;
+            }
+            std::streambuf* saved = std::cout.rdbuf(std::cerr.rdbuf()); // Keep the counts alone on stdout
+            engine = std::make_unique<SearchEngine>(".", "index.dat", "org.dat",
+                                                  "name.dat", "word.dat", "freq.dat", 0, postingCacheBytes);
+            std::cout.rdbuf(saved);
+            FacetIndex::Result facets = engine->facets(argv[2], top);
+            std::cout << facets.documents << " matching documents";
+            if (facets.sampled()) std::cout << " (counts estimated from " << facets.counted << " of them)";
+            std::cout << "\n";
+            const char* headings[FacetIndex::KindCount] = {"Organizations:", "Persons:"};
+            for (int kind = 0; kind < FacetIndex::KindCount; kind++) {
+                std::cout << headings[kind] << "\n";
+                for (const auto& count : facets.top[kind]) {
+                    std::cout << "  " << std::setw(10) << count.documents << "  " << count.name << "\n";
+                }
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Error during search: " << e.what() << "\n";
+            return 1;
+        }
+    }
+    // Case when the 'stats' command is used
+    else if (command == "stats") {
+        try {
+            size_t postingCacheBytes = 0;
+            bool json = false;
+            for (int i = 2; i < argc; i++) {
+                if (std::string(argv[i]) == "--json") json = true;
+                else postingCacheBytes = std::stoul(argv[i]) * 1024 * 1024;
+            }
+            std::streambuf* saved = std::cout.rdbuf(json ? std::cerr.rdbuf() : std::cout.rdbuf()); // Keep JSON output clean
+            engine = std::make_unique<SearchEngine>(".", "index.dat", "org.dat",
+                                                  "name.dat", "word.dat", "freq.dat", 0, postingCacheBytes);
+            std::cout.rdbuf(saved);
+            IndexMemoryStats stats = engine->memoryStats();
+            if (json) stats.writeJson(std::cout);
+            else stats.writeTable(std::cout);
+        } catch (const std::exception& e) {
+            std::cerr << "Error reading index statistics: " << e.what() << "\n";
+            return 1;
+        }
+    }
+    // Case when the 'delete' command is used
+    else if (command == "delete") {
+        // Ensure the file argument is provided
+        if (argc != 3) {
+            std::cerr << "Missing file argument for delete command\n";
+            return 1;  // Return if the file argument is missing
+        }
+        try {
+            engine = std::make_unique<SearchEngine>(".", "index.dat", "org.dat",
+                                                  "name.dat", "word.dat", "freq.dat");
+            if (!engine->deleteDocument(argv[2])) {
+                std::cerr << "Not in the index: " << argv[2] << "\n";
+                return 1;  // Return if the document is unknown or already deleted
+            }
+            std::cout << "Deleted " << argv[2] << "\n";
+        } catch (const std::exception& e) {
+            std::cerr << "Error deleting document: " << e.what() << "\n";
+            return 1;  // Return if an error occurs while deleting
+        }
+    }
+    // Case when the 'compact' command is used
+    else if (command == "compact") {
+        try {
+            engine = std::make_unique<SearchEngine>(".", "index.dat", "org.dat",
+                                                  "name.dat", "word.dat", "freq.dat");
+            std::cout << "Dropped " << engine->compact() << " postings of deleted documents\n";
+        } catch (const std::exception& e) {
+            std::cerr << "Error compacting index: " << e.what() << "\n";
+            return 1;  // Return if an error occurs while compacting
+        }
+    }
     // Case when an unknown command is entered
     else {
         std::cerr << "Unknown command: " << command << "\n";
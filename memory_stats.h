@@ -0,0 +1,189 @@
+// memory_stats.h
+#ifndef MEMORY_STATS_H  // Include guard to prevent multiple inclusions of this header file
+#define MEMORY_STATS_H
+
+#include "posting_list.h"  // For measuring posting lists
+#include <algorithm>  // For keeping the largest lists
+#include <atomic>  // For the counting allocator's totals
+#include <cstdint>  // For byte counts
+#include <functional>  // For std::greater
+#include <iomanip>  // For formatting the report
+#include <ostream>  // For writing the report
+#include <string>  // For terms and field names
+#include <utility>  // For std::pair
+#include <vector>  // For the distribution and the largest lists
+
+// Heap totals kept by a replacement operator new/delete, in binaries built with
+// SUPERSEARCH_COUNT_ALLOCATIONS. When nothing is counted, reports fall back to the estimates alone.
+class HeapCounter {
+private:
+    static std::atomic<int64_t>& live() {  // Bytes currently allocated
+        static std::atomic<int64_t> bytes{0};
+        return bytes;
+    }
+    static std::atomic<bool>& active() {  // Set by the first counted allocation
+        static std::atomic<bool> counting{false};
+        return counting;
+    }
+
+public:
+    static void allocated(size_t bytes) {
+        live().fetch_add(static_cast<int64_t>(bytes), std::memory_order_relaxed);
+        active().store(true, std::memory_order_relaxed);
+    }
+    static void freed(size_t bytes) { live().fetch_sub(static_cast<int64_t>(bytes), std::memory_order_relaxed); }
+    static int64_t liveBytes() { return live().load(std::memory_order_relaxed); }  // Heap bytes in use now
+    static bool counting() { return active().load(std::memory_order_relaxed); }  // Whether the binary counts
+};
+
+// Memory held by one field's dictionary, and the shape of its postings. Byte counts are estimates
+// from object sizes and container capacities; allocator headers and padding are not included.
+struct FieldMemoryStats {
+    std::string field;  // "org", "name", "word" or "segments"
+    size_t terms = 0;  // Keys in the dictionary
+    size_t keyBytes = 0;  // Key strings: the string objects and their heap buffers
+    size_t nodeBytes = 0;  // Tree node overhead: height, child links and the postings pointer
+    size_t postingBytes = 0;  // Posting list objects, their vectors (with spare capacity) and control blocks
+    size_t dictionaryBytes = 0;  // Dictionaries of postings left on disk (lazy loading)
+    size_t postings = 0;  // (term, document) pairs
+    size_t bitmapLists = 0;  // Lists held as Roaring containers
+    std::vector<size_t> documentFrequencies;  // [i] = terms found in [2^i, 2^(i+1)) documents
+    std::vector<std::pair<size_t, std::string>> largest;  // (documents, term) of the longest lists, longest first
+
+    size_t totalBytes() const { return keyBytes + nodeBytes + postingBytes + dictionaryBytes; }
+
+    // Accounts one dictionary entry; keeps the top longest lists
+    void addTerm(const std::string& key, const PostingList* list, size_t nodeOverhead, size_t top) {
+        terms++;
+        keyBytes += sizeof(std::string) + (key.capacity() > 15 ? key.capacity() + 1 : 0);  // Beyond the inline buffer
+        nodeBytes += nodeOverhead;
+        if (!list) return;
+        size_t documents = list->size();
+        postingBytes += list->memoryBytes() + 2 * sizeof(long);  // Plus the make_shared reference counts
+        postings += documents;
+        if (list->isRoaring()) bitmapLists++;
+        size_t bucket = 0;
+        while (documents >> (bucket + 1)) bucket++;
+        if (documents && documentFrequencies.size() <= bucket) documentFrequencies.resize(bucket + 1);
+        if (documents) documentFrequencies[bucket]++;
+        if (top == 0) return;
+        auto longerFirst = std::greater<std::pair<size_t, std::string>>();
+        if (largest.size() < top) {
+            largest.emplace_back(documents, key);
+            std::push_heap(largest.begin(), largest.end(), longerFirst);  // Min-heap on documents
+        } else if (documents > largest.front().first) {
+            std::pop_heap(largest.begin(), largest.end(), longerFirst);
+            largest.back() = {documents, key};
+            std::push_heap(largest.begin(), largest.end(), longerFirst);
+        }
+    }
+
+    // Orders the largest lists longest first, once every term is added
+    void finish() { std::sort_heap(largest.begin(), largest.end(), std::greater<std::pair<size_t, std::string>>()); }
+};
+
+// Memory held by an index, per component, as reported by the stats command
+struct IndexMemoryStats {
+    std::vector<FieldMemoryStats> fields;  // Base index fields, then the segments combined
+    size_t documents = 0;  // Entries in the document table
+    size_t pathBytes = 0;  // Document ID -> path table: string objects and buffers
+    size_t pathIndexBytes = 0;  // Path -> document ID hash map: a second copy of every path, and the nodes
+    size_t hashBucketBytes = 0;  // Bucket array of the hash map
+    size_t hashSlackBytes = 0;  // Part of the bucket array holding empty buckets
+    size_t manifestBytes = 0;  // File records, with a third copy of every path
+    size_t liveDocsBytes = 0;  // Deleted-documents bitmap
+    size_t docStoreBytes = 0;  // Stored-document offsets and documents waiting to be written
+    size_t facetBytes = 0;  // Entity names and per-document organization and person lists
+    size_t dateBytes = 0;  // Per-document publication times and their block bounds
+    size_t postingCacheBytes = 0;  // Postings cached from disk (lazy loading)
+    size_t segments = 0;  // Live segments
+    int64_t heapBytes = -1;  // Heap bytes measured by the counting allocator, or -1 when not counted
+
+    size_t totalBytes() const {
+        size_t total = pathBytes + pathIndexBytes + hashBucketBytes + manifestBytes + liveDocsBytes + docStoreBytes + facetBytes + dateBytes + postingCacheBytes;
+        for (const auto& field : fields) total += field.totalBytes();
+        return total;
+    }
+
+    // Writes the components, the document-frequency distribution and the largest lists as a table
+    void writeTable(std::ostream& out) const {
+        auto row = [&](const std::string& name, size_t bytes) {
+            out << "  " << std::left << std::setw(24) << name << std::right << std::setw(14) << bytes << " bytes  "
+                << std::fixed << std::setprecision(1) << std::setw(5) << (totalBytes() ? 100.0 * bytes / totalBytes() : 0.0) << "%\n";
+        };
+        out << "Memory by component (estimated):\n";
+        for (const auto& field : fields) {
+            if (field.terms == 0) continue;  // E.g. no segments
+            row(field.field + " keys", field.keyBytes);
+            row(field.field + " nodes", field.nodeBytes);
+            row(field.field + " postings", field.postingBytes);
+            if (field.dictionaryBytes) row(field.field + " disk dictionary", field.dictionaryBytes);
+        }
+        row("document paths", pathBytes);
+        row("path index", pathIndexBytes);
+        row("hash buckets", hashBucketBytes);
+        out << "    (of which empty: " << hashSlackBytes << " bytes)\n";
+        row("file manifest", manifestBytes);
+        row("deleted documents", liveDocsBytes);
+        row("document store", docStoreBytes);
+        row("entity facets", facetBytes);
+        row("publication dates", dateBytes);
+        if (postingCacheBytes) row("posting cache", postingCacheBytes);
+        out << "  " << std::left << std::setw(24) << "total" << std::right << std::setw(14) << totalBytes() << " bytes\n";
+        if (heapBytes >= 0) out << "  " << std::left << std::setw(24) << "heap (counted)" << std::right << std::setw(14) << heapBytes << " bytes\n";
+
+        out << "Terms: " << documents << " documents, " << segments << " segments\n";
+        for (const auto& field : fields) {
+            out << "  " << std::left << std::setw(10) << field.field << std::right << std::setw(10) << field.terms << " terms "
+                << std::setw(12) << field.postings << " postings " << std::setw(8) << field.bitmapLists << " bitmap lists\n";
+        }
+        for (const auto& field : fields) {
+            if (field.documentFrequencies.empty()) continue;
+            out << "Document frequency of " << field.field << " terms:\n";
+            for (size_t i = 0; i < field.documentFrequencies.size(); i++) {
+                out << "  " << std::setw(10) << (size_t(1) << i) << " - " << std::left << std::setw(10) << ((size_t(2) << i) - 1)
+                    << std::right << std::setw(10) << field.documentFrequencies[i] << "\n";
+            }
+        }
+        for (const auto& field : fields) {
+            if (field.largest.empty()) continue;
+            out << "Largest " << field.field << " posting lists:\n";
+            for (const auto& [documents, term] : field.largest) out << "  " << std::setw(10) << documents << "  " << term << "\n";
+        }
+        out.unsetf(std::ios::floatfield);
+        out << std::setprecision(6);
+    }
+
+    // Writes the same report as one JSON object
+    void writeJson(std::ostream& out) const {
+        auto quoted = [](const std::string& text) {
+            std::string escaped = "\"";
+            for (char c : text) {
+                if (c == '"' || c == '\\') escaped += '\\';
+                if (static_cast<unsigned char>(c) >= 0x20) escaped += c;
+            }
+            return escaped + "\"";
+        };
+        out << "{\"total_bytes\": " << totalBytes() << ", \"heap_bytes\": " << heapBytes << ", \"documents\": " << documents
+            << ", \"segments\": " << segments << ", \"path_bytes\": " << pathBytes << ", \"path_index_bytes\": " << pathIndexBytes
+            << ", \"hash_bucket_bytes\": " << hashBucketBytes << ", \"hash_slack_bytes\": " << hashSlackBytes
+            << ", \"manifest_bytes\": " << manifestBytes << ", \"live_docs_bytes\": " << liveDocsBytes
+            << ", \"doc_store_bytes\": " << docStoreBytes << ", \"facet_bytes\": " << facetBytes << ", \"date_bytes\": " << dateBytes << ", \"posting_cache_bytes\": " << postingCacheBytes << ", \"fields\": [";
+        for (size_t f = 0; f < fields.size(); f++) {
+            const FieldMemoryStats& field = fields[f];
+            out << (f ? ", " : "") << "{\"field\": " << quoted(field.field) << ", \"terms\": " << field.terms
+                << ", \"key_bytes\": " << field.keyBytes << ", \"node_bytes\": " << field.nodeBytes
+                << ", \"posting_bytes\": " << field.postingBytes << ", \"dictionary_bytes\": " << field.dictionaryBytes
+                << ", \"postings\": " << field.postings << ", \"bitmap_lists\": " << field.bitmapLists << ", \"document_frequencies\": [";
+            for (size_t i = 0; i < field.documentFrequencies.size(); i++) out << (i ? ", " : "") << field.documentFrequencies[i];
+            out << "], \"largest\": [";
+            for (size_t i = 0; i < field.largest.size(); i++) {
+                out << (i ? ", " : "") << "{\"term\": " << quoted(field.largest[i].second) << ", \"documents\": " << field.largest[i].first << "}";
+            }
+            out << "]}";
+        }
+        out << "]}\n";
+    }
+};
+
+#endif  // End of include guard
@@ -0,0 +1,813 @@
+// posting_list.h
+#ifndef POSTING_LIST_H  // Include guard to prevent multiple inclusions of this header file
+#define POSTING_LIST_H
+
+#include "binary_io.h"  // For saving and loading postings
+#include <algorithm>  // For binary searches and merges
+#include <atomic>  // For publishing in-place appends to concurrent readers
+#include <cstdint>  // For fixed-width document IDs and bitmap words
+#include <type_traits>  // For telling scored visitors apart
+#include <utility>  // For std::pair
+#include <vector>  // For ID arrays, containers and frequency side arrays
+
+// Adaptive posting list: the documents a term occurs in, with the term's frequency in each.
+//
+// Small lists are a sorted array of document IDs with a parallel frequency array. Once a list grows
+// past roaringThreshold documents it switches to a Roaring-style layout: IDs are split by their high
+// 16 bits into containers, and each container is a sorted array of low bits or, when dense, a 65536-bit
+// bitmap. Frequencies always live in a side array in ID order, so bitmaps stay compact and membership
+// tests against them are O(1) — which is what makes AND and ANDNOT against common terms cheap.
+//
+// The array layout is divided into fixed-size blocks with a skip entry per block (last document ID,
+// offset of the block, highest frequency in it). Cursors use the skip entries, and the container keys
+// in the Roaring layout, to jump over whole blocks when intersecting two lists. Lists are not encoded,
+// so the offset is an index into the ID array rather than a byte offset. When one list is far smaller
+// than the other (see probeRatio), binary-search probes are cheaper than advancing a cursor and are
+// used instead.
+//
+// A list that queries are already reading can still grow by appendInPlace: the array layout keeps spare
+// slots past size(), a new document is written into the next one, and the size is then raised with
+// release order. Readers load the size with acquire order and never look past it, nor at the skip entry
+// of the last, partly filled block, so they see a consistent prefix while the writer appends.
+class PostingList {
+public:
+    static constexpr size_t roaringThreshold = 4096;  // Document frequency above which the list uses containers
+    static constexpr size_t containerArrayMax = 4096;  // Containers larger than this become bitmaps (as in Roaring)
+    static constexpr size_t blockSize = 128;  // Documents per skip block in the array layout
+    static constexpr size_t probeRatio = 32;  // Lists this many times larger are probed, not leapfrogged (posting_list_bench)
+
+    // Skip header for one block of the array layout
+    struct SkipEntry {
+        uint32_t lastDoc;  // Highest document ID in the block
+        uint32_t offset;  // Position of the block's first document in the ID array
+        int maxFreq;  // Highest frequency in the block, an upper bound for scoring
+    };
+
+private:
+    static constexpr size_t bitmapWords = 1024;  // 65536 bits per bitmap container
+
+    // One Roaring container: every document whose ID shares the same high 16 bits
+    struct Container {
+        uint16_t key = 0;  // High 16 bits shared by every document in the container
+        std::vector<uint16_t> lows;  // Sorted low 16 bits while the container is sparse
+        std::vector<uint64_t> words;  // Bitmap of low 16 bits once the container is dense
+        std::vector<uint16_t> wordRank;  // Set bits before each bitmap word, valid up to lastWord
+        int lastWord = -1;  // Highest bitmap word with a set bit
+        std::vector<int> freqs;  // Term frequencies in low-bit order
+
+        bool isBitmap() const { return !words.empty(); }
+        size_t size() const { return freqs.size(); }
+
+        // Position of low in freqs, or -1 if the document is not in the container
+        long find(uint16_t low) const {
+            if (!isBitmap()) {
+                auto it = std::lower_bound(lows.begin(), lows.end(), low);
+                return (it != lows.end() && *it == low) ? it - lows.begin() : -1;
+            }
+            int w = low >> 6;
+            uint64_t bit = uint64_t(1) << (low & 63);
+            if (w > lastWord || !(words[w] & bit)) return -1;
+            return wordRank[w] + __builtin_popcountll(words[w] & (bit - 1));
+        }
+
+        // Adds n occurrences of low, inserting it if needed
+        void add(uint16_t low, int n) {
+            if (!isBitmap()) {
+                auto it = std::lower_bound(lows.begin(), lows.end(), low);
+                size_t pos = it - lows.begin();
+                if (it != lows.end() && *it == low) {
+                    freqs[pos] += n;
+                    return;
+                }
+                lows.insert(it, low);
+                freqs.insert(freqs.begin() + pos, n);
+                if (lows.size() > containerArrayMax) toBitmap();
+                return;
+            }
+
+            long existing = find(low);
+            if (existing >= 0) {
+                freqs[existing] += n;
+                return;
+            }
+            int w = low >> 6;
+            uint64_t bit = uint64_t(1) << (low & 63);
+            size_t rank;
+            if (w > lastWord) {  // Appending past every set bit: the common case while indexing in ID order
+                for (int i = lastWord + 1; i <= w; i++) wordRank[i] = static_cast<uint16_t>(size());
+                lastWord = w;
+                rank = size();
+            } else {
+                rank = wordRank[w] + __builtin_popcountll(words[w] & (bit - 1));
+                for (int i = w + 1; i <= lastWord; i++) wordRank[i]++;
+            }
+            words[w] |= bit;
+            freqs.insert(freqs.begin() + rank, n);
+        }
+
+        // Converts a sparse container to a bitmap, keeping frequencies in order
+        void toBitmap() {
+            words.assign(bitmapWords, 0);
+            wordRank.assign(bitmapWords, 0);
+            for (uint16_t low : lows) words[low >> 6] |= uint64_t(1) << (low & 63);
+            uint16_t running = 0;
+            for (size_t w = 0; w < bitmapWords; w++) {
+                wordRank[w] = running;
+                running += __builtin_popcountll(words[w]);
+                if (words[w]) lastWord = static_cast<int>(w);
+            }
+            lows.clear();
+            lows.shrink_to_fit();
+        }
+
+        // Calls fn(doc, freq) for every document in ascending order
+        template<typename Fn>
+        void forEach(Fn&& fn) const {
+            uint32_t base = uint32_t(key) << 16;
+            if (!isBitmap()) {
+                for (size_t i = 0; i < lows.size(); i++) fn(base | lows[i], freqs[i]);
+                return;
+            }
+            size_t rank = 0;
+            for (int w = 0; w <= lastWord; w++) {
+                for (uint64_t bits = words[w]; bits; bits &= bits - 1) {
+                    fn(base | (uint32_t(w) << 6) | __builtin_ctzll(bits), freqs[rank++]);
+                }
+            }
+        }
+    };
+
+    std::vector<uint32_t> ids;  // Sorted document IDs while the list is small; spare slots may follow size()
+    std::vector<int> idFreqs;  // Frequencies parallel to ids
+    std::vector<SkipEntry> skips;  // One entry per blockSize documents of ids
+    std::vector<Container> containers;  // Containers ordered by key once the list is large
+    bool roaring = false;  // Which of the two layouts is in use
+    std::atomic<size_t> count{0};  // Number of documents in the list; stored with release order
+
+    void setSize(size_t n) { count.store(n, std::memory_order_release); }
+
+    // Empties a list whose storage was moved away, so it reads as an empty array list
+    void reset() {
+        ids.clear();
+        idFreqs.clear();
+        skips.clear();
+        containers.clear();
+        roaring = false;
+        setSize(0);
+    }
+
+    // Container holding key, or nullptr
+    const Container* containerFor(uint16_t key) const {
+        auto it = std::lower_bound(containers.begin(), containers.end(), key,
+                                   [](const Container& c, uint16_t k) { return c.key < k; });
+        return (it != containers.end() && it->key == key) ? &*it : nullptr;
+    }
+
+    // Recomputes the skip entries of the array layout from block `first` onwards. Only for a list
+    // without spare slots.
+    void rebuildSkips(size_t first) {
+        skips.resize(first);
+        for (size_t start = first * blockSize; start < ids.size(); start += blockSize) {
+            size_t end = std::min(start + blockSize, ids.size());
+            int maxFreq = *std::max_element(idFreqs.begin() + start, idFreqs.begin() + end);
+            skips.push_back({ids[end - 1], static_cast<uint32_t>(start), maxFreq});
+        }
+    }
+
+    // Drops the spare slots left for in-place appends. Only for a list no reader can see.
+    void trim() {
+        size_t n = size();
+        if (roaring || ids.size() == n) return;
+        ids.resize(n);
+        idFreqs.resize(n);
+        skips.resize((n + blockSize - 1) / blockSize);
+    }
+
+    // Moves the sorted array into Roaring containers
+    void toRoaring() {
+        trim();
+        roaring = true;
+        std::vector<uint32_t> oldIds = std::move(ids);
+        std::vector<int> oldFreqs = std::move(idFreqs);
+        ids.clear();
+        idFreqs.clear();
+        skips.clear();
+        setSize(0);
+        for (size_t i = 0; i < oldIds.size(); i++) add(oldIds[i], oldFreqs[i]);
+    }
+
+    // Moves Roaring containers back into a sorted array, whose slots can be appended in place
+    void toArray() {
+        std::vector<uint32_t> docs;
+        std::vector<int> freqs;
+        docs.reserve(size());
+        freqs.reserve(size());
+        forEach([&](uint32_t doc, int f) {
+            docs.push_back(doc);
+            freqs.push_back(f);
+        });
+        containers.clear();
+        roaring = false;
+        ids = std::move(docs);
+        idFreqs = std::move(freqs);
+        rebuildSkips(0);
+    }
+
+    // Streams matches of two dense containers word by word. keep(wa, wb) selects the result bits and
+    // emit(doc, freqA, freqB) receives them; freqB is 0 where b has no bit.
+    template<typename Keep, typename Emit>
+    static void combineBitmaps(const Container& a, const Container& b, Keep&& keep, Emit&& emit) {
+        uint32_t base = uint32_t(a.key) << 16;
+        for (int w = 0; w <= a.lastWord; w++) {
+            uint64_t wa = a.words[w];
+            uint64_t wb = w <= b.lastWord ? b.words[w] : 0;
+            for (uint64_t bits = keep(wa, wb); bits; bits &= bits - 1) {
+                uint64_t bit = bits & (~bits + 1);
+                int freqA = a.freqs[a.wordRank[w] + __builtin_popcountll(wa & (bit - 1))];
+                int freqB = (wb & bit) ? b.freqs[b.wordRank[w] + __builtin_popcountll(wb & (bit - 1))] : 0;
+                emit(base | (uint32_t(w) << 6) | __builtin_ctzll(bits), freqA, freqB);
+            }
+        }
+    }
+
+public:
+    PostingList() = default;
+
+    // Copies the documents below other's size at the time of the copy, without spare slots; safe while
+    // other is appended to in place
+    PostingList(const PostingList& other) { *this = other; }
+    // Takes other's storage; other is left an empty array list
+    PostingList(PostingList&& other) noexcept
+        : ids(std::move(other.ids)), idFreqs(std::move(other.idFreqs)), skips(std::move(other.skips)),
+          containers(std::move(other.containers)), roaring(other.roaring), count(other.size()) {
+        other.reset();
+    }
+
+    PostingList& operator=(const PostingList& other) {
+        if (this == &other) return *this;
+        size_t n = other.size();
+        size_t used = other.roaring ? 0 : n;  // Slots of ids in use; the rest are spare
+        ids.assign(other.ids.begin(), other.ids.begin() + used);
+        idFreqs.assign(other.idFreqs.begin(), other.idFreqs.begin() + used);
+        skips.assign(other.skips.begin(), other.skips.begin() + used / blockSize);  // Only full blocks' entries are final
+        containers = other.containers;
+        roaring = other.roaring;
+        setSize(n);
+        rebuildSkips(skips.size());  // The last, partly filled block
+        return *this;
+    }
+
+    PostingList& operator=(PostingList&& other) noexcept {
+        if (this == &other) return *this;
+        ids = std::move(other.ids);
+        idFreqs = std::move(other.idFreqs);
+        skips = std::move(other.skips);
+        containers = std::move(other.containers);
+        roaring = other.roaring;
+        setSize(other.size());
+        other.reset();
+        return *this;
+    }
+
+    size_t size() const { return count.load(std::memory_order_acquire); }  // Document frequency of the term
+    bool empty() const { return size() == 0; }
+    bool isRoaring() const { return roaring; }  // True once the list uses containers
+
+    // Bytes the list occupies in memory, including spare vector capacity
+    size_t memoryBytes() const {
+        size_t bytes = sizeof(PostingList) + ids.capacity() * sizeof(uint32_t) + idFreqs.capacity() * sizeof(int) +
+                       skips.capacity() * sizeof(SkipEntry) + containers.capacity() * sizeof(Container);
+        for (const auto& c : containers) {
+            bytes += c.lows.capacity() * sizeof(uint16_t) + c.words.capacity() * sizeof(uint64_t) +
+                     c.wordRank.capacity() * sizeof(uint16_t) + c.freqs.capacity() * sizeof(int);
+        }
+        return bytes;
+    }
+
+    // Frequency of the term in doc, or 0 if the term does not occur there
+    int frequency(uint32_t doc) const {
+        if (!roaring) {
+            auto end = ids.begin() + size();
+            auto it = std::lower_bound(ids.begin(), end, doc);
+            return (it != end && *it == doc) ? idFreqs[it - ids.begin()] : 0;
+        }
+        const Container* c = containerFor(static_cast<uint16_t>(doc >> 16));
+        if (!c) return 0;
+        long pos = c->find(static_cast<uint16_t>(doc & 0xFFFF));
+        return pos < 0 ? 0 : c->freqs[pos];
+    }
+
+    bool contains(uint32_t doc) const { return frequency(doc) != 0; }
+
+    // Adds n occurrences of the term in doc. Appending in ascending doc order is amortized O(1). Only
+    // for a list no reader can see; see appendInPlace for one that queries are reading.
+    void add(uint32_t doc, int n = 1) {
+        if (!roaring) {
+            trim();
+            if (ids.empty() || doc > ids.back()) {
+                ids.push_back(doc);
+                idFreqs.push_back(n);
+                setSize(ids.size());
+                if ((ids.size() - 1) % blockSize == 0) {  // First document of a new block
+                    skips.push_back({doc, static_cast<uint32_t>(ids.size() - 1), n});
+                } else {
+                    skips.back().lastDoc = doc;
+                    skips.back().maxFreq = std::max(skips.back().maxFreq, n);
+                }
+            } else {
+                auto it = std::lower_bound(ids.begin(), ids.end(), doc);
+                size_t pos = it - ids.begin();
+                if (*it == doc) {
+                    idFreqs[pos] += n;
+                    skips[pos / blockSize].maxFreq = std::max(skips[pos / blockSize].maxFreq, idFreqs[pos]);
+                } else {
+                    ids.insert(it, doc);
+                    idFreqs.insert(idFreqs.begin() + pos, n);
+                    setSize(ids.size());
+                    rebuildSkips(pos / blockSize);  // Later documents shifted into the following blocks
+                }
+            }
+            if (size() > roaringThreshold) toRoaring();
+            return;
+        }
+
+        uint16_t key = static_cast<uint16_t>(doc >> 16);
+        auto it = containers.end();
+        if (containers.empty() || containers.back().key < key) {
+            containers.emplace_back();  // New highest container: the common case when appending
+            containers.back().key = key;
+            it = containers.end() - 1;
+        } else {
+            it = std::lower_bound(containers.begin(), containers.end(), key,
+                                  [](const Container& c, uint16_t k) { return c.key < k; });
+            if (it->key != key) {
+                it = containers.insert(it, Container());
+                it->key = key;
+            }
+        }
+        size_t before = it->size();
+        it->add(static_cast<uint16_t>(doc & 0xFFFF), n);
+        setSize(size() + it->size() - before);
+    }
+
+    // Appends n occurrences of the term in doc, which must be above every document in the list, while
+    // other threads may be reading it: the document goes into a spare slot, and only then is the size
+    // raised (with release order). Returns false and changes nothing when there is no spare slot, doc
+    // is not above the last document, or the list uses containers; the caller then appends to a copy
+    // made with reserveAppends and publishes that instead. Appends must come from one thread at a time.
+    bool appendInPlace(uint32_t doc, int n = 1) {
+        size_t length = size();
+        if (roaring || length == ids.size() || (length && doc <= ids[length - 1])) return false;
+        ids[length] = doc;
+        idFreqs[length] = n;
+        SkipEntry& skip = skips[length / blockSize];  // Readers ignore this entry until its block is full
+        if (length % blockSize == 0) {
+            skip = {doc, static_cast<uint32_t>(length), n};
+        } else {
+            skip.lastDoc = doc;
+            skip.maxFreq = std::max(skip.maxFreq, n);
+        }
+        setSize(length + 1);  // Publishes the slot
+        return true;
+    }
+
+    // Adds room for at least `room` documents to be appended in place, moving a Roaring list back to the
+    // array layout (whose slots can be published one at a time). Only for a list no reader can see.
+    void reserveAppends(size_t room) {
+        if (roaring) toArray();
+        size_t capacity = size() + room;
+        if (ids.size() >= capacity) return;
+        ids.resize(capacity);
+        idFreqs.resize(capacity);
+        skips.resize((capacity + blockSize - 1) / blockSize);
+    }
+
+    // Calls fn(doc, freq) for every document in ascending ID order
+    template<typename Fn>
+    void forEach(Fn&& fn) const {
+        if (!roaring) {
+            size_t n = size();
+            for (size_t i = 0; i < n; i++) fn(ids[i], idFreqs[i]);
+            return;
+        }
+        for (const auto& c : containers) c.forEach(fn);
+    }
+
+    // Skip entries of the array layout (empty once the list uses containers). Not for a list that is
+    // being appended to in place, whose last entries are still being written.
+    const std::vector<SkipEntry>& skipEntries() const { return skips; }
+
+    // Forward-only cursor over a list in ascending ID order. advanceTo jumps over whole blocks (array
+    // layout) or containers (Roaring layout) whose documents are all below the target.
+    class Cursor {
+    private:
+        const PostingList* list;  // List being traversed
+        size_t length = 0;  // Array layout: documents in the list when the cursor was made; later appends are not seen
+        size_t pos = 0;  // Array layout: index into ids. Roaring layout: index into the container's freqs
+        size_t container = 0;  // Roaring layout: current container
+        uint32_t current = 0;  // Current document ID
+        bool atEnd = false;  // True once every document has been passed
+
+        // Roaring layout: positions on the first document of container c whose low bits are >= low,
+        // moving on to later containers if c has none
+        void seek(size_t c, uint32_t low) {
+            for (; c < list->containers.size(); c++, low = 0) {
+                const Container& box = list->containers[c];
+                uint32_t base = uint32_t(box.key) << 16;
+                if (!box.isBitmap()) {
+                    auto it = std::lower_bound(box.lows.begin(), box.lows.end(), low);
+                    if (it == box.lows.end()) continue;
+                    container = c;
+                    pos = it - box.lows.begin();
+                    current = base | *it;
+                    return;
+                }
+                int w = static_cast<int>(low >> 6);
+                if (w > box.lastWord) continue;
+                uint64_t bits = box.words[w] & (~uint64_t(0) << (low & 63));
+                while (!bits && ++w <= box.lastWord) bits = box.words[w];
+                if (!bits) continue;
+                int bit = __builtin_ctzll(bits);
+                container = c;
+                pos = box.wordRank[w] + __builtin_popcountll(box.words[w] & ((uint64_t(1) << bit) - 1));
+                current = base | (uint32_t(w) << 6) | uint32_t(bit);
+                return;
+            }
+            atEnd = true;
+        }
+
+        // Array layout: positions on the first document at or after index i
+        void settle(size_t i) {
+            pos = i;
+            atEnd = pos >= length;
+            if (!atEnd) current = list->ids[pos];
+        }
+
+    public:
+        explicit Cursor(const PostingList& l) : list(&l), length(l.size()) {
+            if (list->roaring) seek(0, 0);
+            else settle(0);
+        }
+
+        bool valid() const { return !atEnd; }  // False once the cursor has run off the end
+        uint32_t doc() const { return current; }  // Current document ID
+
+        // Frequency of the term in the current document
+        int freq() const {
+            return list->roaring ? list->containers[container].freqs[pos] : list->idFreqs[pos];
+        }
+
+        // Moves to the next document
+        void next() {
+            if (!list->roaring) {
+                settle(pos + 1);
+                return;
+            }
+            const Container& box = list->containers[container];
+            if (pos + 1 >= box.size()) seek(container + 1, 0);
+            else if (!box.isBitmap()) current = (uint32_t(box.key) << 16) | box.lows[++pos];
+            else seek(container, (current & 0xFFFF) + 1);
+        }
+
+        // Moves to the first document >= target, skipping blocks or containers that end below it
+        void advanceTo(uint32_t target) {
+            if (atEnd || current >= target) return;
+            if (!list->roaring) {
+                const auto& skips = list->skips;
+                size_t fullBlocks = length / blockSize;  // Blocks with final skip entries; the last, partial one has none
+                size_t block = pos / blockSize;
+                if (block < fullBlocks && skips[block].lastDoc < target) {  // Target lies beyond this block: search the skip entries
+                    auto it = std::lower_bound(skips.begin() + block + 1, skips.begin() + fullBlocks, target,
+                                               [](const SkipEntry& e, uint32_t t) { return e.lastDoc < t; });
+                    pos = it == skips.begin() + fullBlocks ? fullBlocks * blockSize : it->offset;
+                    if (pos >= length) {
+                        atEnd = true;
+                        return;
+                    }
+                }
+                size_t blockEnd = std::min<size_t>((pos / blockSize + 1) * blockSize, length);
+                settle(std::lower_bound(list->ids.begin() + pos, list->ids.begin() + blockEnd, target) - list->ids.begin());
+                return;
+            }
+            uint16_t key = static_cast<uint16_t>(target >> 16);
+            if (list->containers[container].key < key) {  // Skip containers that end below the target
+                auto it = std::lower_bound(list->containers.begin() + container + 1, list->containers.end(), key,
+                                           [](const Container& c, uint16_t k) { return c.key < k; });
+                size_t c = it - list->containers.begin();
+                if (it == list->containers.end() || it->key > key) seek(c, 0);
+                else seek(c, target & 0xFFFF);
+                return;
+            }
+            seek(container, target & 0xFFFF);
+        }
+    };
+
+    Cursor cursor() const { return Cursor(*this); }  // Cursor positioned on the first document
+
+    // AND: documents in both lists, with frequencies summed
+    static PostingList intersect(const PostingList& a, const PostingList& b) {
+        PostingList result;
+        const PostingList& small = a.size() <= b.size() ? a : b;
+        const PostingList& large = a.size() <= b.size() ? b : a;
+
+        if (small.roaring && large.roaring) {  // Pair containers by key; bitmaps AND word by word
+            for (const auto& cs : small.containers) {
+                const Container* cl = large.containerFor(cs.key);
+                if (!cl) continue;
+                if (cs.isBitmap() && cl->isBitmap()) {
+                    combineBitmaps(cs, *cl, [](uint64_t x, uint64_t y) { return x & y; },
+                                   [&](uint32_t doc, int fs, int fl) { result.add(doc, fs + fl); });
+                } else {
+                    const Container& drive = cs.size() <= cl->size() ? cs : *cl;
+                    const Container& probe = cs.size() <= cl->size() ? *cl : cs;
+                    drive.forEach([&](uint32_t doc, int f) {
+                        long pos = probe.find(static_cast<uint16_t>(doc & 0xFFFF));
+                        if (pos >= 0) result.add(doc, f + probe.freqs[pos]);
+                    });
+                }
+            }
+            return result;
+        }
+
+        if (large.roaring || small.size() * probeRatio < large.size()) {
+            small.forEach([&](uint32_t doc, int f) {  // Probe the larger list once per document of the smaller
+                int other = large.frequency(doc);
+                if (other) result.add(doc, f + other);
+            });
+            return result;
+        }
+
+        Cursor l = large.cursor();  // Walk the smaller list, skipping whole blocks of the larger one
+        small.forEach([&](uint32_t doc, int f) {
+            l.advanceTo(doc);
+            if (l.valid() && l.doc() == doc) result.add(doc, f + l.freq());
+        });
+        return result;
+    }
+
+    // OR: documents in either list, with frequencies summed where both contain them
+    static PostingList unite(const PostingList& a, const PostingList& b) {
+        std::vector<std::pair<uint32_t, int>> left, right;
+        left.reserve(a.size());
+        right.reserve(b.size());
+        a.forEach([&](uint32_t doc, int f) { left.emplace_back(doc, f); });
+        b.forEach([&](uint32_t doc, int f) { right.emplace_back(doc, f); });
+
+        PostingList result;
+        size_t i = 0, j = 0;
+        while (i < left.size() || j < right.size()) {
+            if (j == right.size() || (i < left.size() && left[i].first < right[j].first)) {
+                result.add(left[i].first, left[i].second);
+                i++;
+            } else if (i == left.size() || right[j].first < left[i].first) {
+                result.add(right[j].first, right[j].second);
+                j++;
+            } else {
+                result.add(left[i].first, left[i].second + right[j].second);
+                i++;
+                j++;
+            }
+        }
+        return result;
+    }
+
+    // Union of any number of lists in one k-way merge over their cursors, summing frequencies. O(n log k)
+    // for n postings in k lists, where a chain of pairwise unites copies the growing result k times.
+    static PostingList uniteAll(const std::vector<const PostingList*>& lists) {
+        std::vector<Cursor> cursors;
+        cursors.reserve(lists.size());
+        for (const PostingList* list : lists) {
+            if (!list->empty()) cursors.push_back(list->cursor());
+        }
+        auto later = [&](size_t a, size_t b) { return cursors[a].doc() > cursors[b].doc(); };
+        std::vector<size_t> heap;  // Min-heap of cursor indexes ordered by their current document
+        for (size_t i = 0; i < cursors.size(); i++) {
+            if (cursors[i].valid()) heap.push_back(i);
+        }
+        std::make_heap(heap.begin(), heap.end(), later);
+
+        PostingList result;
+        bool open = false;  // Whether doc's frequencies are still being summed
+        uint32_t doc = 0;
+        int freq = 0;
+        while (!heap.empty()) {
+            std::pop_heap(heap.begin(), heap.end(), later);
+            Cursor& smallest = cursors[heap.back()];
+            if (open && smallest.doc() != doc) {  // Every list holding doc has moved past it
+                result.add(doc, freq);
+                open = false;
+            }
+            if (!open) {
+                doc = smallest.doc();
+                freq = 0;
+                open = true;
+            }
+            freq += smallest.freq();
+            smallest.next();
+            if (smallest.valid()) std::push_heap(heap.begin(), heap.end(), later);
+            else heap.pop_back();
+        }
+        if (open) result.add(doc, freq);
+        return result;
+    }
+
+    // ANDNOT: documents of a that are not in b, keeping a's frequencies
+    static PostingList subtract(const PostingList& a, const PostingList& b) {
+        PostingList result;
+        if (b.empty()) return a;
+
+        if (a.roaring && b.roaring) {
+            for (const auto& ca : a.containers) {
+                const Container* cb = b.containerFor(ca.key);
+                if (!cb) {
+                    ca.forEach([&](uint32_t doc, int f) { result.add(doc, f); });
+                } else if (ca.isBitmap() && cb->isBitmap()) {
+                    combineBitmaps(ca, *cb, [](uint64_t x, uint64_t y) { return x & ~y; },
+                                   [&](uint32_t doc, int f, int) { result.add(doc, f); });
+                } else {
+                    ca.forEach([&](uint32_t doc, int f) {
+                        if (cb->find(static_cast<uint16_t>(doc & 0xFFFF)) < 0) result.add(doc, f);
+                    });
+                }
+            }
+            return result;
+        }
+
+        if (b.roaring || a.size() * probeRatio < b.size()) {
+            a.forEach([&](uint32_t doc, int f) {  // O(1) probes when b is a bitmap, O(log n) when it is far larger
+                if (!b.contains(doc)) result.add(doc, f);
+            });
+            return result;
+        }
+
+        Cursor excluded = b.cursor();  // a is visited in order, so b only ever moves forward
+        a.forEach([&](uint32_t doc, int f) {
+            excluded.advanceTo(doc);
+            if (!excluded.valid() || excluded.doc() != doc) result.add(doc, f);
+        });
+        return result;
+    }
+
+    // Documents of a for which keep(doc) holds, keeping a's frequencies
+    template<typename Keep>
+    static PostingList filter(const PostingList& a, Keep&& keep) {
+        PostingList result;
+        a.forEach([&](uint32_t doc, int f) {
+            if (keep(doc)) result.add(doc, f);  // Appends in ascending order, so O(1) each
+        });
+        return result;
+    }
+
+    // |a AND b| without building the intersection: pairs of dense containers are counted with popcounts
+    // of the ANDed words, other pairs by probing or leapfrogging as intersect does
+    static size_t intersectCount(const PostingList& a, const PostingList& b) {
+        const PostingList& small = a.size() <= b.size() ? a : b;
+        const PostingList& large = a.size() <= b.size() ? b : a;
+        size_t n = 0;
+
+        if (small.roaring && large.roaring) {
+            for (const auto& cs : small.containers) {
+                const Container* cl = large.containerFor(cs.key);
+                if (!cl) continue;
+                if (cs.isBitmap() && cl->isBitmap()) {
+                    int last = std::min(cs.lastWord, cl->lastWord);
+                    for (int w = 0; w <= last; w++) n += __builtin_popcountll(cs.words[w] & cl->words[w]);
+                } else {
+                    const Container& drive = cs.size() <= cl->size() ? cs : *cl;
+                    const Container& probe = cs.size() <= cl->size() ? *cl : cs;
+                    drive.forEach([&](uint32_t doc, int) { n += probe.find(static_cast<uint16_t>(doc & 0xFFFF)) >= 0; });
+                }
+            }
+            return n;
+        }
+
+        if (large.roaring || small.size() * probeRatio < large.size()) {
+            small.forEach([&](uint32_t doc, int) { n += large.contains(doc); });
+            return n;
+        }
+
+        Cursor l = large.cursor();
+        small.forEach([&](uint32_t doc, int) {
+            l.advanceTo(doc);
+            n += l.valid() && l.doc() == doc;
+        });
+        return n;
+    }
+
+    // Documents of a within ascending, disjoint, inclusive ID ranges, keeping a's frequencies. The
+    // cursor jumps to the start of each range, so documents between ranges are never visited.
+    static PostingList slice(const PostingList& a, const std::vector<std::pair<uint32_t, uint32_t>>& ranges) {
+        PostingList result;
+        Cursor c = a.cursor();
+        for (const auto& [first, last] : ranges) {
+            c.advanceTo(first);
+            for (; c.valid() && c.doc() <= last; c.next()) result.add(c.doc(), c.freq());
+            if (!c.valid()) break;
+        }
+        return result;
+    }
+
+    // Calls visit(doc) in ascending order for every document in all of `all` and none of `none`, without
+    // building intermediate lists; stops as soon as visit returns false. A visit(doc, score) is also
+    // passed the summed frequencies of `all` in the document. The first list drives the leapfrog, so
+    // pass the rarest first. `all` must not be empty.
+    template<typename Visit>
+    static void forEachMatch(const std::vector<const PostingList*>& all, const std::vector<const PostingList*>& none, Visit&& visit) {
+        forEachMatch(all, none, {{0, UINT32_MAX}}, std::forward<Visit>(visit));
+    }
+
+    // As above, visiting only documents within ascending, disjoint, inclusive ID ranges; the leapfrog
+    // jumps from the end of one range to the start of the next. Lists probeRatio times larger than the
+    // first are probed rather than leapfrogged.
+    template<typename Visit>
+    static void forEachMatch(const std::vector<const PostingList*>& all, const std::vector<const PostingList*>& none,
+                             const std::vector<std::pair<uint32_t, uint32_t>>& ranges, Visit&& visit) {
+        constexpr bool scored = std::is_invocable_v<Visit&, uint32_t, int>;
+        std::vector<Cursor> required, excluded;
+        std::vector<const PostingList*> probedRequired, probedExcluded;
+        required.reserve(all.size());
+        excluded.reserve(none.size());
+        size_t rarest = all[0]->size();
+        for (const PostingList* list : all) {
+            if (list != all[0] && rarest * probeRatio < list->size()) probedRequired.push_back(list);
+            else required.push_back(list->cursor());
+        }
+        for (const PostingList* list : none) {
+            if (rarest * probeRatio < list->size()) probedExcluded.push_back(list);
+            else excluded.push_back(list->cursor());
+        }
+
+        Cursor& driver = required[0];
+        for (const auto& [first, last] : ranges) {
+            driver.advanceTo(first);
+            while (driver.valid() && driver.doc() <= last) {
+                uint32_t doc = driver.doc();
+                bool agreed = true;
+                for (size_t i = 1; i < required.size(); i++) {
+                    required[i].advanceTo(doc);
+                    if (!required[i].valid()) return;
+                    if (required[i].doc() != doc) {  // Jump the driver to the first candidate this list allows
+                        driver.advanceTo(required[i].doc());
+                        agreed = false;
+                        break;
+                    }
+                }
+                if (!agreed) continue;
+                bool rejected = false;
+                int score = 0;
+                if constexpr (scored) {
+                    for (const auto& cursor : required) score += cursor.freq();
+                }
+                for (const PostingList* list : probedRequired) {
+                    int f = rejected ? 0 : list->frequency(doc);
+                    rejected = f == 0;
+                    score += f;
+                }
+                for (const PostingList* list : probedExcluded) rejected = rejected || list->contains(doc);
+                for (auto& cursor : excluded) {
+                    cursor.advanceTo(doc);
+                    if (cursor.valid() && cursor.doc() == doc) {
+                        rejected = true;
+                        break;
+                    }
+                }
+                if (!rejected) {
+                    if constexpr (scored) {
+                        if (!visit(doc, score)) return;
+                    } else if (!visit(doc)) {
+                        return;
+                    }
+                }
+                driver.next();
+            }
+            if (!driver.valid()) return;
+        }
+    }
+
+    // Writes the list as a document count followed by (doc, frequency) pairs in ID order
+    void save(BinaryWriter& out) const {
+        out.writeFixed<uint64_t>(size());
+        forEach([&](uint32_t doc, int f) {
+            out.writeFixed(doc);
+            out.writeFixed<int32_t>(f);
+        });
+    }
+
+    // Reads a list written by save; the layout is chosen again from the loaded size
+    void load(BinaryReader& in) {
+        *this = PostingList();
+        uint64_t n = in.readFixed<uint64_t>();
+        if (in && n <= roaringThreshold) {
+            ids.reserve(n);
+            idFreqs.reserve(n);
+            skips.reserve((n + blockSize - 1) / blockSize);
+        }
+        for (uint64_t i = 0; i < n && in; i++) {
+            uint32_t doc = in.readFixed<uint32_t>();
+            int f = in.readFixed<int32_t>();
+            if (in) add(doc, f);
+        }
+    }
+};
+
+#endif  // End of include guard
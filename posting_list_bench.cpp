@@ -0,0 +1,94 @@
+// posting_list_bench.cpp
+// Measures AND between a rare and a common term: skip-block cursors versus probing every rare
+// document with a binary search, walking the whole common list, and the old hash-map postings.
+// "intersect" is the full PostingList::intersect call, including building the result list; it probes
+// when the common list is more than PostingList::probeRatio times larger and leapfrogs cursors otherwise,
+// and the rare sizes straddle that crossover.
+// Usage: posting_list_bench [documents]
+#include "posting_list.h" // The posting lists under test
+#include <chrono> // For timing each method
+#include <iomanip> // For formatting the results table
+#include <iostream> // For printing results
+#include <algorithm> // For sorting generated documents
+#include <random> // For the seeded document generator
+#include <unordered_map> // For the hash-map baseline
+#include <vector> // For holding generated lists
+
+// Builds a list of `size` distinct random documents below `universe`
+static PostingList makeList(size_t size, uint32_t universe, std::mt19937& rng) {
+    std::vector<char> taken(universe, 0);
+    std::vector<uint32_t> docs;
+    std::uniform_int_distribution<uint32_t> pick(0, universe - 1);
+    while (docs.size() < size) {
+        uint32_t doc = pick(rng);
+        if (!taken[doc]) {
+            taken[doc] = 1;
+            docs.push_back(doc);
+        }
+    }
+    std::sort(docs.begin(), docs.end());
+    PostingList list;
+    for (uint32_t doc : docs) list.add(doc, 1 + doc % 3);
+    return list;
+}
+
+// Runs fn repeatedly for a fixed time budget and returns nanoseconds per call
+template<typename Fn>
+static double timePerCall(Fn&& fn) {
+    size_t calls = 0;
+    volatile size_t sink = 0; // Keeps results alive so the work is not optimized away
+    auto start = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed{};
+    do {
+        for (int i = 0; i < 16; i++, calls++) sink = sink + fn();
+        elapsed = std::chrono::steady_clock::now() - start;
+    } while (elapsed.count() < 0.2);
+    return elapsed.count() * 1e9 / calls;
+}
+
+int main(int argc, char* argv[]) {
+    uint32_t universe = argc > 1 ? static_cast<uint32_t>(std::stoul(argv[1])) : 1000000;
+    std::mt19937 rng(42);
+
+    std::cout << "common_docs,common_layout,rare_docs,method,ns_per_and\n"; // CSV so runs can be diffed
+    for (size_t commonSize : {size_t(4000), size_t(universe / 3)}) { // Array layout and Roaring layout
+        PostingList common = makeList(commonSize, universe, rng);
+        std::unordered_map<uint32_t, int> commonMap; // The pre-ID representation, keyed per document
+        common.forEach([&](uint32_t doc, int f) { commonMap.emplace(doc, f); });
+
+        for (size_t rareSize : {size_t(1), size_t(10), size_t(100), size_t(1000)}) {
+            PostingList rare = makeList(rareSize, universe, rng);
+            auto report = [&](const char* method, double ns) {
+                std::cout << commonSize << "," << (common.isRoaring() ? "roaring" : "array") << ","
+                          << rareSize << "," << method << "," << std::fixed << std::setprecision(1) << ns << "\n";
+            };
+
+            report("skip_cursor", timePerCall([&]() {
+                size_t hits = 0;
+                PostingList::Cursor c = common.cursor();
+                rare.forEach([&](uint32_t doc, int) {
+                    c.advanceTo(doc);
+                    hits += c.valid() && c.doc() == doc;
+                });
+                return hits;
+            }));
+            report("intersect", timePerCall([&]() { return PostingList::intersect(rare, common).size(); }));
+            report("probe", timePerCall([&]() {
+                size_t hits = 0;
+                rare.forEach([&](uint32_t doc, int) { hits += common.frequency(doc) != 0; });
+                return hits;
+            }));
+            report("full_walk", timePerCall([&]() {
+                size_t hits = 0;
+                common.forEach([&](uint32_t doc, int) { hits += rare.contains(doc); });
+                return hits;
+            }));
+            report("hash_map", timePerCall([&]() {
+                size_t hits = 0;
+                rare.forEach([&](uint32_t doc, int) { hits += commonMap.count(doc); });
+                return hits;
+            }));
+        }
+    }
+    return 0;
+}
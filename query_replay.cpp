@@ -0,0 +1,203 @@
+// query_replay.cpp
+// Replays a query log (one query per line, e.g. from supersearch_corpus) through SearchEngine::search
+// against an existing index and reports the latency distribution from HDR histograms.
+//
+// Closed loop (default): N threads each issue their next query as soon as the previous one returns,
+// measuring throughput and service time.
+// Open loop (--rate): queries are scheduled at a fixed rate regardless of how fast they complete, and
+// latency is measured from each query's scheduled start, not from when a thread got to it. This
+// corrects for coordinated omission: a stall delays every query queued behind it, and those delays are
+// counted instead of silently lowering the offered load. Service time (from the actual start) is
+// reported alongside.
+//
+// Results are written one "key value" pair per line in a fixed order, so runs can be diffed.
+// Usage: supersearch_replay <index-directory> <query-log> [--threads N] [--rate QPS] [--queries N]
+//                           [--warmup N] [--cache MB] [--top K] [--mode M] [--output FILE] [--hgrm FILE]
+//                           [--trace FILE]
+// --top replays each query as a request for its first K results instead of every result path.
+// --mode count or exists replays each query through SearchEngine::count or exists instead of search.
+// --trace writes the spans of the replayed queries as a Chrome trace (builds with SUPERSEARCH_TRACING).
+#include "latency_histogram.h" // Latency distributions
+#include "searchEngine.h" // The engine under test
+#include "trace.h" // Chrome trace export, when compiled in
+#include <algorithm> // For std::max
+#include <atomic> // For handing out queries to threads
+#include <chrono> // For scheduling and timing queries
+#include <filesystem> // For switching to the index directory
+#include <fstream> // For reading the log and writing results
+#include <iomanip> // For formatting results
+#include <iostream> // For progress and errors
+#include <memory> // For the engine
+#include <stdexcept> // For bad arguments
+#include <string> // For queries
+#include <thread> // For the replay threads
+#include <vector> // For the query list and per-thread histograms
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+// What each replay thread measured
+struct ThreadResult {
+    LatencyHistogram latency; // From scheduled start (open loop) or actual start (closed loop) to completion
+    LatencyHistogram service; // From actual start to completion
+    uint64_t hits = 0; // Results returned, summed over queries, as a cheap check that runs did the same work
+    uint64_t errors = 0; // Queries that threw
+};
+
+// Writes the summary of one histogram, in microseconds
+static void writeSummary(std::ostream& out, const std::string& name, const LatencyHistogram& histogram) {
+    static const std::pair<const char*, double> percentiles[] = {
+        {"p50", 50.0}, {"p90", 90.0}, {"p99", 99.0}, {"p99.9", 99.9}, {"p99.99", 99.99}};
+    out << std::fixed << std::setprecision(1);
+    out << name << "_us_min " << histogram.min() / 1000.0 << "\n";
+    out << name << "_us_mean " << histogram.mean() / 1000.0 << "\n";
+    for (const auto& p : percentiles) out << name << "_us_" << p.first << " " << histogram.valueAtPercentile(p.second) / 1000.0 << "\n";
+    out << name << "_us_max " << histogram.max() / 1000.0 << "\n";
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <index-directory> <query-log> [--threads N] [--rate QPS]\n"
+                  << "       [--queries N] [--warmup N] [--cache MB] [--top K] [--mode search|count|exists]\n"
+                  << "       [--output FILE] [--hgrm FILE] [--trace FILE]\n";
+        return 1;
+    }
+    fs::path indexDirectory = fs::absolute(argv[1]);
+    fs::path logPath = fs::absolute(argv[2]);
+    size_t threads = 1;
+    double rate = 0; // Queries per second; 0 = closed loop
+    size_t queryCount = 0; // 0 = each logged query once
+    size_t warmup = 0;
+    size_t cacheMegabytes = 0;
+    size_t top = 0; // 0 = every result path
+    std::string mode = "search";
+    std::string outputPath, hgrmPath, tracePath;
+    try {
+        for (int i = 3; i + 1 < argc; i += 2) {
+            std::string option = argv[i];
+            if (option == "--threads") threads = std::max<size_t>(1, std::stoul(argv[i + 1]));
+            else if (option == "--rate") rate = std::stod(argv[i + 1]);
+            else if (option == "--queries") queryCount = std::stoul(argv[i + 1]);
+            else if (option == "--warmup") warmup = std::stoul(argv[i + 1]);
+            else if (option == "--cache") cacheMegabytes = std::stoul(argv[i + 1]);
+            else if (option == "--top") top = std::stoul(argv[i + 1]);
+            else if (option == "--mode") mode = argv[i + 1];
+            else if (option == "--output") outputPath = fs::absolute(argv[i + 1]).string();
+            else if (option == "--hgrm") hgrmPath = fs::absolute(argv[i + 1]).string();
+            else if (option == "--trace") tracePath = fs::absolute(argv[i + 1]).string();
+            else throw std::invalid_argument("Unknown option " + option);
+        }
+        if (mode != "search" && mode != "count" && mode != "exists") throw std::invalid_argument("Unknown mode " + mode);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+
+    std::vector<std::string> log;
+    std::ifstream logFile(logPath);
+    for (std::string line; std::getline(logFile, line);) {
+        if (!line.empty() && line[0] != '#') log.push_back(line);
+    }
+    if (log.empty()) {
+        std::cerr << "Error: no queries in " << logPath.string() << "\n";
+        return 1;
+    }
+    if (queryCount == 0) queryCount = log.size();
+    if (!fs::exists(indexDirectory / "index.dat")) {
+        std::cerr << "Error: no index in " << indexDirectory.string() << "\n";
+        return 1;
+    }
+
+    // Load the index once; the engine's load messages go to stderr so stdout holds only results
+    std::unique_ptr<SearchEngine> engine;
+    std::streambuf* saved = std::cout.rdbuf(std::cerr.rdbuf());
+    try {
+        fs::current_path(indexDirectory);
+        engine = std::make_unique<SearchEngine>(".", "index.dat", "org.dat", "name.dat", "word.dat", "freq.dat",
+                                                0, cacheMegabytes * 1024 * 1024);
+        std::cout.rdbuf(saved);
+    } catch (const std::exception& e) {
+        std::cout.rdbuf(saved);
+        std::cerr << "Error loading index: " << e.what() << "\n";
+        return 1;
+    }
+
+    // Warm-up queries run first, on this thread, and are not recorded
+    for (size_t i = 0; i < warmup; i++) engine->search(log[i % log.size()]);
+
+    std::vector<ThreadResult> results(threads);
+    std::atomic<size_t> next{0};
+    Clock::time_point start = Clock::now();
+    auto replay = [&](ThreadResult& result) {
+        for (size_t i; (i = next.fetch_add(1)) < queryCount;) {
+            Clock::time_point scheduled = Clock::now();
+            if (rate > 0) {
+                scheduled = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(i / rate));
+                std::this_thread::sleep_until(scheduled);
+            }
+            Clock::time_point begin = Clock::now();
+            try {
+                const std::string& query = log[i % log.size()];
+                if (mode == "count") result.hits += engine->count(query);
+                else if (mode == "exists") result.hits += engine->exists(query);
+                else result.hits += top ? engine->search(query, top).totalHits : engine->search(query).size();
+            } catch (const std::exception&) {
+                result.errors++;
+            }
+            Clock::time_point end = Clock::now();
+            result.latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(end - scheduled).count());
+            result.service.record(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count());
+        }
+    };
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; t++) workers.emplace_back(replay, std::ref(results[t]));
+    for (auto& worker : workers) worker.join();
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+
+    ThreadResult total;
+    for (const auto& result : results) {
+        total.latency.add(result.latency);
+        total.service.add(result.service);
+        total.hits += result.hits;
+        total.errors += result.errors;
+    }
+
+    std::ofstream outputFile;
+    if (!outputPath.empty()) outputFile.open(outputPath);
+    std::ostream& out = outputPath.empty() ? std::cout : outputFile;
+    out << "mode " << (rate > 0 ? "open" : "closed") << "\n";
+    out << "query_mode " << mode << "\n";
+    out << "threads " << threads << "\n";
+    out << std::fixed << std::setprecision(1) << "target_qps " << rate << "\n";
+    out << "queries " << queryCount << "\n";
+    out << "warmup " << warmup << "\n";
+    out << "cache_mb " << cacheMegabytes << "\n";
+    out << "top " << top << "\n";
+    out << "hits " << total.hits << "\n";
+    out << "errors " << total.errors << "\n";
+    out << std::setprecision(3) << "elapsed_s " << elapsed.count() << "\n";
+    out << std::setprecision(1) << "achieved_qps " << queryCount / elapsed.count() << "\n";
+    writeSummary(out, "latency", total.latency);
+    writeSummary(out, "service", total.service);
+    if (!out) {
+        std::cerr << "Error: cannot write " << outputPath << "\n";
+        return 1;
+    }
+
+    if (!hgrmPath.empty()) {
+        std::ofstream hgrm(hgrmPath);
+        total.latency.writeDistribution(hgrm, 1000.0); // Microseconds
+        if (!hgrm) {
+            std::cerr << "Error: cannot write " << hgrmPath << "\n";
+            return 1;
+        }
+    }
+    if (!tracePath.empty()) {
+#ifdef SUPERSEARCH_TRACING
+        Tracer::writeChromeTrace(tracePath);
+#else
+        std::cerr << "Warning: tracing is compiled out; configure with -DSUPERSEARCH_TRACING=ON\n";
+#endif
+    }
+    return total.errors ? 2 : 0;
+}
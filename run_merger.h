@@ -0,0 +1,122 @@
+// run_merger.h
+#ifndef RUN_MERGER_H  // Include guard to prevent multiple inclusions of this header file
+#define RUN_MERGER_H
+
+#include "avl_tree.h"  // AVLNode knows how to save and load each value type
+#include "binary_io.h"  // For buffered encoding of runs
+#include <fstream>  // For streaming runs in and the merged index out
+#include <memory>  // For owning one reader per run
+#include <queue>  // For the k-way merge heap
+#include <stdexcept>  // For reporting unreadable runs
+#include <string>  // For keys and file names
+#include <vector>  // For the list of runs
+
+// Streams (key, value) entries, one at a time, from a file written by AVLTree::saveToFile.
+// Files written that way are sorted by key, so a flushed index is also a valid merge run.
+template<typename T>
+class TreeFileReader {
+private:
+    std::ifstream in;  // The run being read
+    std::unique_ptr<BinaryReader> reader;  // Buffered decoder over in
+    uint64_t remaining = 0;  // Entries not yet returned
+    AVLNode<T> current{std::string(), T()};  // Most recently read entry
+
+public:
+    explicit TreeFileReader(const std::string& filename) : in(filename, std::ios::binary) {
+        if (!in) throw std::runtime_error("Cannot read index run " + filename);
+        reader = std::make_unique<BinaryReader>(in);
+        remaining = reader->readFixed<uint64_t>();  // Entry count header
+    }
+
+    // Reads the next entry; returns false at the end of the file
+    bool next() {
+        if (remaining == 0) return false;
+        remaining--;
+        current.key = reader->readString();
+        current.load(*reader);
+        if (!*reader) throw std::runtime_error("Truncated index run");
+        return true;
+    }
+
+    const std::string& key() const { return current.key; }  // Key of the current entry
+    T& value() { return current.value; }  // Value of the current entry
+};
+
+// Writes (key, value) entries in ascending key order in the AVLTree::saveToFile format, patching the
+// entry count into the header and appending the chunk table when finished
+template<typename T>
+class TreeFileWriter {
+private:
+    std::ofstream out;  // The file being written
+    std::unique_ptr<BinaryWriter> writer;  // Buffered encoder over out
+    uint64_t count = 0;  // Entries written so far
+    TreeFileChunks chunks;  // Chunk table for parallel loading, appended in finish()
+
+public:
+    explicit TreeFileWriter(const std::string& filename) : out(filename, std::ios::binary | std::ios::trunc) {
+        if (!out) throw std::runtime_error("Cannot write index file " + filename);
+        writer = std::make_unique<BinaryWriter>(out);
+        writer->writeFixed(count);  // Placeholder, patched in finish()
+    }
+
+    // Appends one entry; keys must arrive in strictly ascending order
+    void write(const std::string& key, const T& value) {
+        chunks.beforeEntry(*writer);
+        writer->writeString(key);
+        Serializer<T>::write(*writer, value);
+        count++;
+    }
+
+    // Writes the chunk table and the final entry count, and closes the file
+    void finish() {
+        chunks.write(*writer);
+        writer->patchFixed(0, count);
+        writer.reset();
+        out.close();
+        if (!out) throw std::runtime_error("Failed writing index file");
+    }
+};
+
+// K-way merges sorted runs into one sorted tree file. Values of keys present in several runs are
+// folded together with combine(accumulated, next). Each merged value then passes through keep(value),
+// which may rewrite it and returns false to drop the key. Only one entry per run is held in memory.
+template<typename T, typename Combine, typename Keep>
+void mergeTreeFiles(const std::vector<std::string>& runs, const std::string& output, Combine combine, Keep keep) {
+    std::vector<std::unique_ptr<TreeFileReader<T>>> readers;
+    for (const auto& run : runs) {
+        readers.push_back(std::make_unique<TreeFileReader<T>>(run));
+    }
+
+    // Min-heap of run indices ordered by each run's current key
+    auto greater = [&](size_t a, size_t b) { return readers[a]->key() > readers[b]->key(); };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(greater)> heap(greater);
+    for (size_t i = 0; i < readers.size(); i++) {
+        if (readers[i]->next()) heap.push(i);
+    }
+
+    TreeFileWriter<T> writer(output);
+    while (!heap.empty()) {
+        size_t first = heap.top();
+        heap.pop();
+        std::string key = readers[first]->key();
+        T value = std::move(readers[first]->value());
+        if (readers[first]->next()) heap.push(first);
+
+        while (!heap.empty() && readers[heap.top()]->key() == key) {  // Same term flushed in other runs
+            size_t other = heap.top();
+            heap.pop();
+            value = combine(value, readers[other]->value());
+            if (readers[other]->next()) heap.push(other);
+        }
+        if (keep(value)) writer.write(key, value);
+    }
+    writer.finish();
+}
+
+// K-way merges sorted runs, keeping every key
+template<typename T, typename Combine>
+void mergeTreeFiles(const std::vector<std::string>& runs, const std::string& output, Combine combine) {
+    mergeTreeFiles<T>(runs, output, combine, [](T&) { return true; });
+}
+
+#endif  // End of include guard
@@ -2,144 +2,940 @@
 // searchEngine.cpp
 #include "searchEngine.h" // Includes the header file that defines the SearchEngine class and its dependencies
 #include "rapidjson/document.h" // Includes RapidJSON library for parsing JSON documents
-#include "rapidjson/istreamwrapper.h" // Stream wrapper for integrating RapidJSON with file input streams
+#include "run_merger.h" // Streaming k-way merge of flushed index runs
+#include "trace.h" // Spans for the Chrome trace export, when compiled in
 #include <filesystem> // Provides functions for filesystem operations (e.g., directory traversal)
 #include <fstream> // For file input/output operations
 #include <sstream> // For string stream processing
 #include <algorithm> // For common algorithms like std::transform
 #include <iostream> // For console input/output
 #include <chrono> // For measuring time intervals
+#include <atomic> // For handing out files to indexing threads
+#include <mutex> // For recording the first indexing error
+#include <thread> // For parallel indexing
+#include <future> // For loading index files concurrently
+#include <functional> // For the per-file loaders
+#include <shared_mutex> // For pausing indexing threads while a run is flushed
+#include <cctype> // For splitting article text into words
+#include <stdexcept> // For rejecting malformed cursors and dates
 
 namespace fs = std::filesystem; // Creates an alias for the filesystem namespace
 
-// Associates an organization with a file in the index
-void SearchEngine::WordMap::associateOrg(const std::string& org, const std::string& filepath) {
-    std::unordered_map<std::string, int> files; // A map to track files and their counts for the organization
-    if (!orgIndex.find(org, files)) { // Check if the organization exists in the index
-        files = std::unordered_map<std::string, int>(); // Initialize a new map if not found
-    }
-    files[filepath]++; // Increment the count for the file
-    orgIndex.insert(org, files); // Update the index with the organization and its files
+// Creates the three field indices with the given number of shards each
+SearchEngine::WordMap::WordMap(size_t shards) : orgIndex(shards), nameIndex(shards), wordIndex(shards) {}
+
+// Adds occurrences of key in a document. Safe to call from several indexing threads: only the key's
+// shard is locked. In persistent mode queries may be reading the list, so a document is appended into a
+// spare slot and published by raising the list's size; only when the list has no room, uses containers
+// or gets a document out of order is it copied, with room to spare, and the copy published instead.
+void SearchEngine::WordMap::associate(PostingsIndex& index, const std::string& key, uint32_t docId, int occurrences) {
+    approxBytes += sizeof(uint32_t) + sizeof(int); // One more document ID and frequency, at most
+    BuildStats::count(BuildStats::Postings);
+    index.update(key, [&](const std::shared_ptr<Postings>* files) {
+        if (!files) {
+            approxBytes += key.size() + sizeof(AVLNode<std::shared_ptr<Postings>>) + sizeof(Postings); // New term
+            BuildStats::count(BuildStats::Terms);
+        }
+        if (files && *files && !persistent) {
+            (*files)->add(docId, occurrences); // No concurrent readers: update the shared list in place
+            return *files;
+        }
+        if (files && *files && (*files)->appendInPlace(docId, occurrences)) return *files; // Readers see it from now on
+        auto updated = files && *files ? std::make_shared<Postings>(**files) : std::make_shared<Postings>();
+        updated->reserveAppends(std::max<size_t>(updated->size() + 1, 4)); // Doubling keeps copies O(1) per document
+        if (!updated->appendInPlace(docId, occurrences)) updated->add(docId, occurrences); // Out of order
+        return updated;
+    });
 }
 
-// Associates a person’s name with a file in the index
-void SearchEngine::WordMap::associateName(const std::string& name, const std::string& filepath) {
-    std::unordered_map<std::string, int> files;
-    if (!nameIndex.find(name, files)) { // Check if the name exists in the index
-        files = std::unordered_map<std::string, int>();
-    }
-    files[filepath]++;
-    nameIndex.insert(name, files);
+// Associates an organization with a document in the index
+void SearchEngine::WordMap::associateOrg(const std::string& org, uint32_t docId, int occurrences) {
+    SUPERSEARCH_TRACE_SPAN("WordMap::associateOrg");
+    associate(orgIndex, org, docId, occurrences);
+}
+
+// Associates a person’s name with a document in the index
+void SearchEngine::WordMap::associateName(const std::string& name, uint32_t docId, int occurrences) {
+    SUPERSEARCH_TRACE_SPAN("WordMap::associateName");
+    associate(nameIndex, name, docId, occurrences);
 }
 
-// Associates a word with a file in the index
-void SearchEngine::WordMap::associateWord(const std::string& word, const std::string& filepath) {
+// Associates a word with a document in the index
+void SearchEngine::WordMap::associateWord(const std::string& word, uint32_t docId, int occurrences) {
+    SUPERSEARCH_TRACE_SPAN("WordMap::associateWord");
     // Skip indexing empty words
     if (word.empty()) return;
+    associate(wordIndex, word, docId, occurrences);
+}
+
+// Switches all three indices between in-place and path-copying updates
+void SearchEngine::WordMap::setPersistent(bool enabled) {
+    persistent = enabled;
+    orgIndex.setPersistent(enabled);
+    nameIndex.setPersistent(enabled);
+    wordIndex.setPersistent(enabled);
+}
+
+// Chooses between loading every posting list and loading only the term dictionaries. In lazy mode the
+// postings are read on first use into a cache bounded to cacheBytes.
+void SearchEngine::WordMap::setLazy(size_t cacheBytes) {
+    lazy = cacheBytes > 0;
+    postingCache.setCapacity(cacheBytes);
+}
+
+// Returns the posting cache counters
+PostingCache::Stats SearchEngine::WordMap::postingCacheStats() const {
+    return postingCache.stats();
+}
 
-    std::unordered_map<std::string, int> files;
-    if (!wordIndex.find(word, files)) { // Check if the word exists in the index
-        files = std::unordered_map<std::string, int>();
+// Returns the document ID of a file, assigning the next free ID the first time the file is seen
+uint32_t SearchEngine::WordMap::addDocument(const std::string& filepath) {
+    std::unique_lock<std::shared_mutex> guard(documentsLock);
+    auto it = documentIds.find(filepath);
+    if (it != documentIds.end()) return it->second; // Re-indexing a known file keeps its ID
+    uint32_t docId = static_cast<uint32_t>(documents.size());
+    documents.push_back(filepath);
+    documentIds.emplace(filepath, docId);
+    return docId;
+}
+
+// Returns the file path of a document ID
+std::string SearchEngine::WordMap::documentPath(uint32_t docId) const {
+    std::shared_lock<std::shared_mutex> guard(documentsLock);
+    return docId < documents.size() ? documents[docId] : std::string();
+}
+
+// Returns the number of documents that have been assigned an ID
+size_t SearchEngine::WordMap::documentCount() const {
+    std::shared_lock<std::shared_mutex> guard(documentsLock);
+    return documents.size();
+}
+
+// Gives a file a new document ID, so postings of its new contents never mix with the old ones
+uint32_t SearchEngine::WordMap::replaceDocument(const std::string& filepath) {
+    std::unique_lock<std::shared_mutex> guard(documentsLock);
+    uint32_t docId = static_cast<uint32_t>(documents.size());
+    documents.push_back(filepath);
+    documentIds[filepath] = docId; // The path now refers to its newest version
+    return docId;
+}
+
+// Looks up the current document ID of a file; returns false if it was never indexed
+bool SearchEngine::WordMap::findDocument(const std::string& filepath, uint32_t& docId) const {
+    std::shared_lock<std::shared_mutex> guard(documentsLock);
+    auto it = documentIds.find(filepath);
+    if (it == documentIds.end()) return false;
+    docId = it->second;
+    return true;
+}
+
+// Returns the records of the indexed files
+FileManifest& SearchEngine::WordMap::manifest() {
+    return files;
+}
+
+// Returns the records of the indexed files for reading
+const FileManifest& SearchEngine::WordMap::manifest() const {
+    return files;
+}
+
+// Returns the bitmap of deleted documents
+LiveDocs& SearchEngine::WordMap::liveDocs() {
+    return live;
+}
+
+// Returns the bitmap of deleted documents for reading
+const LiveDocs& SearchEngine::WordMap::liveDocs() const {
+    return live;
+}
+
+// Writes index.dat: the file manifest followed by the deleted-documents bitmap
+void SearchEngine::WordMap::saveManifest(const std::string& filenamepath) const {
+    std::ofstream out(filenamepath, std::ios::binary | std::ios::trunc);
+    BinaryWriter writer(out);
+    files.save(writer);
+    live.save(writer);
+    writer.flush();
+}
+
+// Reads the document table: a count followed by length-prefixed file paths in ID order
+bool SearchEngine::WordMap::loadDocuments(const std::string& fsavePath) {
+    std::ifstream in(fsavePath, std::ios::binary);
+    if (!in) return false;
+    BinaryReader reader(in);
+    std::vector<std::string> paths;
+    Serializer<std::vector<std::string>>::read(reader, paths);
+    if (!reader) return false;
+    std::unordered_map<std::string, uint32_t> ids;
+    ids.reserve(paths.size());
+    for (size_t i = 0; i < paths.size(); i++) {
+        ids[paths[i]] = static_cast<uint32_t>(i); // A replaced file maps to its newest ID
     }
-    files[filepath]++;
-    wordIndex.insert(word, files); // Update the index with the word and its files
+    std::unique_lock<std::shared_mutex> guard(documentsLock);
+    documents = std::move(paths);
+    documentIds = std::move(ids);
+    return true;
 }
 
-// Loads saved indexes from file paths
+// Loads saved indexes from file paths. The files are independent, so each is loaded on its own thread
+// (and large trees decode their chunks on several more); the time each took is printed.
 bool SearchEngine::WordMap::load(const std::string& filenamepath, const std::string& osavePath,
                                const std::string& nsavePath, const std::string& wsavePath,
                                const std::string& fsavePath) {
-    try {
-        orgIndex.load(osavePath); // Load organization index
-        nameIndex.load(nsavePath); // Load name index
-        wordIndex.load(wsavePath); // Load word index
-        return true; // Return true if loading succeeds
-    } catch (const std::exception&) { // Catch exceptions if any errors occur during loading
-        return false; // Return false if loading fails
+    SUPERSEARCH_TRACE_SPAN("WordMap::load");
+    using Clock = std::chrono::high_resolution_clock;
+    auto start = Clock::now();
+    auto timed = [](std::function<bool()> loadFile) { // Runs one loader on its own thread
+        return std::async(std::launch::async, [loadFile]() {
+            SUPERSEARCH_TRACE_SPAN("WordMap::load file");
+            auto begin = Clock::now();
+            bool loaded = loadFile();
+            std::chrono::duration<double> duration = Clock::now() - begin;
+            return std::make_pair(loaded, duration.count());
+        });
+    };
+    std::vector<std::pair<std::string, std::future<std::pair<bool, double>>>> loads;
+    loads.emplace_back(filenamepath, timed([&]() {
+        std::ifstream manifestIn(filenamepath, std::ios::binary | std::ios::ate);
+        if (!manifestIn) return true; // Indexes saved without a manifest have every document live
+        std::vector<char> image(static_cast<size_t>(manifestIn.tellg())); // Whole file, so lengths are checked against it
+        manifestIn.seekg(0);
+        manifestIn.read(image.data(), image.size());
+        if (!manifestIn) return false;
+        BinaryReader reader(image.data(), image.size());
+        files.load(reader); // Load the file manifest; throws if it is truncated
+        if (reader.position() == image.size()) return true; // Saved before deletions were recorded
+        live.load(reader); // Load the deleted-documents bitmap
+        return static_cast<bool>(reader); // A truncated bitmap fails the load like any other file
+    }));
+    lazyLoaded = false;
+    if (lazy) { // Read only the term dictionaries; postings are read when queries first need them
+        loads.emplace_back(osavePath, timed([&]() { lazyOrg.open(osavePath, postingCache, "o"); return true; }));
+        loads.emplace_back(nsavePath, timed([&]() { lazyName.open(nsavePath, postingCache, "n"); return true; }));
+        loads.emplace_back(wsavePath, timed([&]() { lazyWord.open(wsavePath, postingCache, "w"); return true; }));
+    } else {
+        loads.emplace_back(osavePath, timed([&]() { orgIndex.loadFromFile(osavePath); return true; })); // Load organization index
+        loads.emplace_back(nsavePath, timed([&]() { nameIndex.loadFromFile(nsavePath); return true; })); // Load name index
+        loads.emplace_back(wsavePath, timed([&]() { wordIndex.loadFromFile(wsavePath); return true; })); // Load word index
     }
+    loads.emplace_back(fsavePath, timed([&]() { return loadDocuments(fsavePath); })); // Load the document table
+
+    bool loaded = true;
+    std::vector<std::pair<std::string, double>> timings;
+    for (auto& [path, result] : loads) {
+        try { // Wait for every loader, even after a failure, since they all reference this map
+            auto [ok, seconds] = result.get();
+            loaded = loaded && ok;
+            timings.emplace_back(path, seconds);
+        } catch (const std::exception&) { // Catch exceptions if any errors occur during loading
+            loaded = false; // Loading fails
+        }
+    }
+    if (!loaded) return false;
+    lazyLoaded = lazy;
+    for (const auto& [path, seconds] : timings) {
+        std::cout << "Loaded " << path << " in " << seconds << " seconds.\n";
+    }
+    std::chrono::duration<double> duration = Clock::now() - start;
+    std::cout << "Index loaded in " << duration.count() << " seconds.\n";
+    return true; // Return true if loading succeeds
 }
 
 // Saves current indexes to specified file paths
 void SearchEngine::WordMap::save(const std::string& filenamepath, const std::string& osavePath,
                                const std::string& nsavePath, const std::string& wsavePath,
                                const std::string& fsavePath) const {
-    orgIndex.save(osavePath); // Save organization index
-    nameIndex.save(nsavePath); // Save name index
-    wordIndex.save(wsavePath); // Save word index
+    SUPERSEARCH_TRACE_SPAN("WordMap::save");
+    if (lazyLoaded) throw std::logic_error("A lazily loaded index cannot be saved"); // Most postings are not in memory
+    orgIndex.saveToFile(osavePath); // Save organization index
+    nameIndex.saveToFile(nsavePath); // Save name index
+    wordIndex.saveToFile(wsavePath); // Save word index
+
+    saveDocuments(fsavePath); // Save the document table so IDs in the postings can be mapped back to file paths
+    saveManifest(filenamepath); // Save the file manifest used to detect changes, and the deletions
 }
 
-// Retrieves files associated with an organization
-std::unordered_map<std::string, int> SearchEngine::WordMap::getFilesByOrg(const std::string& org) const {
-    std::unordered_map<std::string, int> files;
-    orgIndex.find(org, files); // Find files for the given organization
-    return files; // Return the result
+// Writes the document table: a count followed by length-prefixed file paths in ID order
+void SearchEngine::WordMap::saveDocuments(const std::string& fsavePath) const {
+    std::ofstream out(fsavePath, std::ios::binary);
+    BinaryWriter writer(out);
+    std::shared_lock<std::shared_mutex> guard(documentsLock);
+    Serializer<std::vector<std::string>>::write(writer, documents);
 }
 
-// Retrieves files associated with a name
-std::unordered_map<std::string, int> SearchEngine::WordMap::getFilesByName(const std::string& name) const {
-    std::unordered_map<std::string, int> files;
-    nameIndex.find(name, files); // Find files for the given name
-    return files;
+// Returns the approximate number of bytes the in-memory postings use
+size_t SearchEngine::WordMap::memoryEstimate() const {
+    return approxBytes;
 }
 
-// Retrieves files associated with a word
-std::unordered_map<std::string, int> SearchEngine::WordMap::getFilesByWord(const std::string& word) const {
-    std::unordered_map<std::string, int> files;
-    wordIndex.find(word, files); // Find files for the given word
-    return files;
+// Accounts one dictionary of postings: every term's key, node and list
+template<typename Index>
+static void addDictionary(FieldMemoryStats& field, const Index& index, size_t top) {
+    using Node = AVLNode<std::shared_ptr<PostingList>>;
+    index.forEachWithPrefix("", [&](const auto& node) {
+        field.addTerm(node.key, node.value.get(), sizeof(Node) - sizeof(std::string), top);
+        return true;
+    });
+}
+
+// Adds the sizes of the three dictionaries, the document table and the per-document records to stats
+void SearchEngine::WordMap::memoryStats(IndexMemoryStats& stats, size_t top) const {
+    const std::pair<const char*, std::pair<const PostingsIndex*, const LazyPostingIndex*>> dictionaries[] = {
+        {"org", {&orgIndex, &lazyOrg}}, {"name", {&nameIndex, &lazyName}}, {"word", {&wordIndex, &lazyWord}}};
+    for (const auto& [name, indexes] : dictionaries) {
+        FieldMemoryStats field;
+        field.field = name;
+        addDictionary(field, *indexes.first, top);
+        if (lazyLoaded) { // Terms on disk have no in-memory node or list, only a dictionary entry
+            field.terms += indexes.second->termCount();
+            field.dictionaryBytes = indexes.second->dictionaryBytes();
+        }
+        field.finish();
+        stats.fields.push_back(std::move(field));
+    }
+    if (lazyLoaded) stats.postingCacheBytes = postingCache.stats().bytes;
+
+    std::shared_lock<std::shared_mutex> guard(documentsLock);
+    stats.documents = documents.size();
+    stats.pathBytes = documents.capacity() * sizeof(std::string);
+    for (const auto& path : documents) stats.pathBytes += path.capacity() > 15 ? path.capacity() + 1 : 0; // Beyond the inline buffer
+    for (const auto& entry : documentIds) {
+        stats.pathIndexBytes += sizeof(entry) + 2 * sizeof(void*); // Node: next pointer, cached hash and the pair
+        stats.pathIndexBytes += entry.first.capacity() > 15 ? entry.first.capacity() + 1 : 0;
+    }
+    stats.hashBucketBytes = documentIds.bucket_count() * sizeof(void*);
+    size_t usedBuckets = 0;
+    for (size_t b = 0; b < documentIds.bucket_count(); b++) usedBuckets += documentIds.bucket_size(b) != 0;
+    stats.hashSlackBytes = (documentIds.bucket_count() - usedBuckets) * sizeof(void*);
+    stats.manifestBytes = files.memoryBytes();
+    stats.liveDocsBytes = live.memoryBytes();
+}
+
+// Writes each field's postings as a sorted run file (runPrefix + ".org"/".name"/".word"), then empties
+// the indices so indexing can continue within the memory budget. Document IDs are kept.
+void SearchEngine::WordMap::flushRun(const std::string& runPrefix) {
+    SUPERSEARCH_TRACE_SPAN("WordMap::flushRun");
+    orgIndex.saveToFile(runPrefix + ".org");
+    nameIndex.saveToFile(runPrefix + ".name");
+    wordIndex.saveToFile(runPrefix + ".word");
+    orgIndex.clear();
+    nameIndex.clear();
+    wordIndex.clear();
+    approxBytes = 0;
+}
+
+// Drops the postings of deleted documents from the three dictionaries, and terms left with none, one
+// shard at a time. Lists without deleted documents are kept as they are. Returns the postings dropped.
+size_t SearchEngine::WordMap::compact() {
+    SUPERSEARCH_TRACE_SPAN("WordMap::compact");
+    if (lazyLoaded) throw std::logic_error("A lazily loaded index cannot be compacted"); // Most postings are not in memory
+    LiveDocs::Snapshot deleted = live.snapshot();
+    if (!deleted.hasDeletions()) return 0;
+    size_t dropped = 0;
+    auto purge = [&](std::shared_ptr<Postings>& postings) {
+        if (!postings) return false;
+        auto kept = std::make_shared<Postings>(PostingList::filter(*postings, [&](uint32_t doc) { return deleted.isLive(doc); }));
+        if (kept->size() == postings->size()) return true;
+        dropped += postings->size() - kept->size();
+        postings = std::move(kept); // Queries still reading the old list keep it alive
+        return !postings->empty();
+    };
+    orgIndex.rewrite(purge);
+    nameIndex.rewrite(purge);
+    wordIndex.rewrite(purge);
+    return dropped;
+}
+
+// Merges the runs of every field into the final index files, streaming one term per run at a time,
+// and writes the document table alongside them. The result loads exactly like a saved index.
+void SearchEngine::WordMap::mergeRuns(const std::vector<std::string>& runPrefixes,
+                                      const std::string& filenamepath, const std::string& osavePath,
+                                      const std::string& nsavePath, const std::string& wsavePath,
+                                      const std::string& fsavePath) const {
+    SUPERSEARCH_TRACE_SPAN("WordMap::mergeRuns");
+    auto unite = [](const std::shared_ptr<Postings>& a, const std::shared_ptr<Postings>& b) {
+        return std::make_shared<Postings>(PostingList::unite(*a, *b)); // A term flushed in several runs
+    };
+    auto runsFor = [&](const std::string& suffix) {
+        std::vector<std::string> files;
+        for (const auto& prefix : runPrefixes) files.push_back(prefix + suffix);
+        return files;
+    };
+    LiveDocs::Snapshot deleted = live.snapshot();
+    auto purge = [&](std::shared_ptr<Postings>& postings) { // Drop postings of deleted documents
+        if (!deleted.hasDeletions()) return true;
+        postings = std::make_shared<Postings>(PostingList::filter(*postings, [&](uint32_t doc) { return deleted.isLive(doc); }));
+        return !postings->empty();
+    };
+    mergeTreeFiles<std::shared_ptr<Postings>>(runsFor(".org"), osavePath, unite, purge);
+    mergeTreeFiles<std::shared_ptr<Postings>>(runsFor(".name"), nsavePath, unite, purge);
+    mergeTreeFiles<std::shared_ptr<Postings>>(runsFor(".word"), wsavePath, unite, purge);
+    saveDocuments(fsavePath);
+    saveManifest(filenamepath);
+}
+
+// Shared empty list returned for terms that are not in the index
+static const std::shared_ptr<const PostingList> noPostings = std::make_shared<const PostingList>();
+
+// Postings of key in an in-memory index, united with those on disk when the index was loaded lazily.
+// Documents added after a lazy load live in the in-memory index.
+template<typename Index>
+static std::shared_ptr<const PostingList> findPostings(const Index& index, const LazyPostingIndex& onDisk, bool useDisk, const std::string& key) {
+    std::shared_ptr<PostingList> files, stored;
+    index.find(key, files);
+    if (useDisk) onDisk.find(key, stored);
+    if (files && stored) return std::make_shared<const PostingList>(PostingList::unite(*stored, *files));
+    if (stored) return stored;
+    return files ? files : noPostings;
+}
+
+// Retrieves documents associated with an organization
+std::shared_ptr<const PostingList> SearchEngine::WordMap::getFilesByOrg(const std::string& org) const {
+    return findPostings(orgIndex, lazyOrg, lazyLoaded, org); // Find documents for the given organization
+}
+
+// Retrieves documents associated with a name
+std::shared_ptr<const PostingList> SearchEngine::WordMap::getFilesByName(const std::string& name) const {
+    return findPostings(nameIndex, lazyName, lazyLoaded, name); // Find documents for the given name
+}
+
+// Retrieves documents associated with a word
+std::shared_ptr<const PostingList> SearchEngine::WordMap::getFilesByWord(const std::string& word) const {
+    return findPostings(wordIndex, lazyWord, lazyLoaded, word); // Find documents for the given word
 }
 
-// Alias for getFilesByWord, retrieves files for other contexts
-std::unordered_map<std::string, int> SearchEngine::WordMap::getOtherFilesByWord(const std::string& word) const {
+// Alias for getFilesByWord, retrieves documents for other contexts
+std::shared_ptr<const PostingList> SearchEngine::WordMap::getOtherFilesByWord(const std::string& word) const {
     return getFilesByWord(word);
 }
 
+// Adds the postings of up to maxExpansions terms that start with prefix to lists
+template<typename Index>
+static void gatherPrefix(const Index& index, const std::string& prefix, size_t maxExpansions,
+                         std::vector<std::shared_ptr<const PostingList>>& lists) {
+    size_t expanded = 0;
+    index.forEachWithPrefix(prefix, [&](const auto& node) { // Walk matching terms in sorted order
+        if (expanded++ >= maxExpansions) return false; // Stop expanding once the cap is reached
+        if (node.value && !node.value->empty()) lists.push_back(node.value);
+        return true;
+    });
+}
+
+// Unites lists in a single k-way merge, summing term frequencies; one list is returned as is
+static std::shared_ptr<const PostingList> uniteLists(const std::vector<std::shared_ptr<const PostingList>>& lists) {
+    if (lists.empty()) return std::make_shared<const PostingList>();
+    if (lists.size() == 1) return lists[0];
+    std::vector<const PostingList*> all;
+    all.reserve(lists.size());
+    for (const auto& list : lists) all.push_back(list.get());
+    return std::make_shared<const PostingList>(PostingList::uniteAll(all));
+}
+
+// Merges the postings of up to maxPrefixExpansions terms that start with prefix, from an in-memory
+// index and, when the index was loaded lazily, its on-disk postings, all at once
+template<typename Index>
+static std::shared_ptr<const PostingList> collectPrefix(const Index& index, const LazyPostingIndex& onDisk, bool useDisk,
+                                                        const std::string& prefix, size_t maxExpansions) {
+    std::vector<std::shared_ptr<const PostingList>> lists;
+    gatherPrefix(index, prefix, maxExpansions, lists);
+    if (useDisk) gatherPrefix(onDisk, prefix, maxExpansions, lists);
+    return uniteLists(lists);
+}
+
+// Retrieves documents associated with any organization starting with prefix
+std::shared_ptr<const PostingList> SearchEngine::WordMap::getFilesByOrgPrefix(const std::string& prefix) const {
+    return collectPrefix(orgIndex, lazyOrg, lazyLoaded, prefix, maxPrefixExpansions);
+}
+
+// Retrieves documents associated with any name starting with prefix
+std::shared_ptr<const PostingList> SearchEngine::WordMap::getFilesByNamePrefix(const std::string& prefix) const {
+    return collectPrefix(nameIndex, lazyName, lazyLoaded, prefix, maxPrefixExpansions);
+}
+
+// Retrieves documents associated with any word starting with prefix
+std::shared_ptr<const PostingList> SearchEngine::WordMap::getFilesByWordPrefix(const std::string& prefix) const {
+    return collectPrefix(wordIndex, lazyWord, lazyLoaded, prefix, maxPrefixExpansions);
+}
+
 // Constructor for the SearchEngine
 SearchEngine::SearchEngine(const std::string& folderPath, const std::string& filenamepath,
                          const std::string& osavePath, const std::string& nsavePath,
-                         const std::string& wsavePath, const std::string& fsavePath)
-    : textProcessor() { // Initialize the text processor
-    if (!wordMap.load(filenamepath, osavePath, nsavePath, wsavePath, fsavePath)) {
+                         const std::string& wsavePath, const std::string& fsavePath,
+                         size_t memoryBudget, size_t postingCacheBytes)
+    : textProcessor(), memoryBudget(memoryBudget), documentsPath(fsavePath), manifestPath(filenamepath),
+      orgPath(osavePath), namePath(nsavePath), wordPath(wsavePath) { // Initialize the text processor
+    // Segments are listed in a manifest next to the document table
+    std::string segmentManifest = (fs::path(fsavePath).parent_path() / "segments.dat").string();
+    std::string docStorePrefix = (fs::path(fsavePath).parent_path() / "docs").string();
+    std::string facetsPath = (fs::path(fsavePath).parent_path() / "facets.dat").string();
+    std::string datesPath = (fs::path(fsavePath).parent_path() / "dates.dat").string();
+    segments.setLiveDocs([this]() { return wordMap.liveDocs().snapshot(); }); // Merges purge deleted documents
+    wordMap.setLazy(postingCacheBytes); // With a cache size, postings stay on disk until queries need them
+    if (wordMap.load(filenamepath, osavePath, nsavePath, wsavePath, fsavePath)) {
+        segments.open(segmentManifest, false); // Documents added since the base index was built
+        docStore.open(docStorePrefix, false);
+        facetIndex.open(facetsPath, false);
+        dateIndex.open(datesPath, false);
+    } else {
+        lastBuild = std::make_unique<BuildStats>();
+        BuildStats::Attach attach(*lastBuild); // This thread's share of the build, and the final save
+        segments.open(segmentManifest, true); // The rebuilt base index covers every document, so drop old segments
+        docStore.open(docStorePrefix, true);
+        facetIndex.open(facetsPath, true);
+        dateIndex.open(datesPath, true);
         buildFromScratch(folderPath); // Build the index if loading fails
-        wordMap.save(filenamepath, osavePath, nsavePath, wsavePath, fsavePath); // Save the new index
+        BuildStats::Timer saving(BuildStats::SaveIndex);
+        docStore.flush();
+        facetIndex.flush();
+        dateIndex.flush();
+        if (runPrefixes.empty()) {
+            wordMap.save(filenamepath, osavePath, nsavePath, wsavePath, fsavePath); // Save the new index
+        } else {
+            // The budget was exceeded: merge the flushed runs on disk, then load the merged index.
+            wordMap.mergeRuns(runPrefixes, filenamepath, osavePath, nsavePath, wsavePath, fsavePath);
+            fs::remove_all(runDirectory);
+            runPrefixes.clear();
+            if (!wordMap.load(filenamepath, osavePath, nsavePath, wsavePath, fsavePath)) {
+                throw std::runtime_error("Failed to load the merged index");
+            }
+        }
+    }
+    if (lastBuild) {
+        lastBuild->finish();
+        lastBuild->writeTable(std::cout);
+    }
+}
+
+// Returns the hit and miss counts of the posting cache
+PostingCache::Stats SearchEngine::postingCacheStats() const {
+    return wordMap.postingCacheStats();
+}
+
+// Walks the whole index and reports the bytes held by each component. The segments' three
+// dictionaries are reported together, without a list of their largest postings.
+IndexMemoryStats SearchEngine::memoryStats(size_t top) const {
+    IndexMemoryStats stats;
+    wordMap.memoryStats(stats, top);
+    FieldMemoryStats segmentFields;
+    segmentFields.field = "segments";
+    auto live = segments.snapshot();
+    for (const auto& segment : *live) {
+        for (int f = 0; f < Segment::FieldCount; f++) addDictionary(segmentFields, segment->field(static_cast<Segment::Field>(f)), 0);
+    }
+    stats.segments = live->size();
+    stats.fields.push_back(std::move(segmentFields));
+    stats.docStoreBytes = docStore.memoryBytes();
+    stats.facetBytes = facetIndex.memoryBytes();
+    stats.dateBytes = dateIndex.memoryBytes();
+    if (HeapCounter::counting()) stats.heapBytes = HeapCounter::liveBytes();
+    return stats;
+}
+
+// Returns the timings of the build done by the constructor, or null if the index was loaded
+const BuildStats* SearchEngine::buildStats() const {
+    return lastBuild.get();
+}
+
+// Destructor: stores documents added since the last flush
+SearchEngine::~SearchEngine() {
+    docStore.flush();
+    facetIndex.flush();
+    dateIndex.flush();
+}
+
+// Indexes a single document into target under docId: organizations, person names and processed words.
+// Document IDs always come from the main document table, so segments and the base index share one ID
+// space. The file's size, modification time and hash are recorded for change detection. Thread-safe.
+void SearchEngine::indexFile(const std::string& filePath, uint32_t docId, WordMap& target) {
+    SUPERSEARCH_TRACE_SPAN("SearchEngine::indexFile");
+    StoredDocument stored;
+    std::vector<std::unordered_set<std::string>> words = getRelevantData(filePath, stored); // Extract relevant data
+    BuildStats::count(BuildStats::Files);
+    {
+        BuildStats::Timer timer(BuildStats::HashFile);
+        wordMap.manifest().track(docId, FileRecord::describe(filePath));
+    }
+    {
+        BuildStats::Timer timer(BuildStats::StoreDocument);
+        stored.path = filePath;
+        facetIndex.add(docId, stored.organizations, stored.persons);
+        dateIndex.set(docId, DateIndex::parseTimestamp(stored.published));
+        docStore.add(docId, std::move(stored)); // Kept for display, so results never re-parse the JSON
+    }
+
+    // Stem the words first, so stemming and insertion are timed separately
+    std::vector<std::string> processedWords;
+    {
+        BuildStats::Timer timer(BuildStats::Stem);
+        processedWords.reserve(words[2].size());
+        for (const auto& word : words[2]) {
+            std::string processedWord = textProcessor.processWord(word);
+            if (!processedWord.empty()) processedWords.push_back(std::move(processedWord));
+        }
+    }
+
+    BuildStats::Timer timer(BuildStats::Insert);
+
+    // Each term is added once per document with its number of occurrences (names that differ only in
+    // case, words with the same stem), so a list shared with live queries gets one append per document
+    auto associateEach = [&](std::vector<std::string>& terms, void (WordMap::*associate)(const std::string&, uint32_t, int)) {
+        std::sort(terms.begin(), terms.end());
+        for (size_t i = 0; i < terms.size();) {
+            size_t run = i;
+            while (run < terms.size() && terms[run] == terms[i]) run++;
+            (target.*associate)(terms[i], docId, static_cast<int>(run - i));
+            i = run;
+        }
+    };
+    auto lowercased = [](const std::unordered_set<std::string>& names) {
+        std::vector<std::string> lower(names.begin(), names.end());
+        for (auto& name : lower) std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        return lower;
+    };
+
+    // Process and index organizations
+    std::vector<std::string> orgs = lowercased(words[0]);
+    associateEach(orgs, &WordMap::associateOrg);
+
+    // Process and index person names
+    std::vector<std::string> names = lowercased(words[1]);
+    associateEach(names, &WordMap::associateName);
+
+    // Index the processed words
+    associateEach(processedWords, &WordMap::associateWord);
+}
+
+// Enables or disables concurrent reads during indexing
+void SearchEngine::setLiveIndexing(bool enabled) {
+    wordMap.setPersistent(enabled);
+}
+
+// Adds a document to a loaded or freshly built index. May be called from several threads; in live
+// indexing mode, search() may run concurrently with it.
+void SearchEngine::addDocument(const std::string& filePath) {
+    indexFile(filePath, wordMap.addDocument(filePath), wordMap);
+}
+
+// Writes a buffer of newly indexed documents as an immutable segment and publishes it. The document
+// table is saved first, so a published segment never refers to IDs missing from it on disk.
+void SearchEngine::publishSegment(WordMap& buffer, size_t documents) {
+    std::string prefix = segments.reservePrefix();
+    buffer.flushRun(prefix); // Same sorted file format as a build run
+    docStore.flush(); // Stored fields are readable before the documents can match
+    facetIndex.flush();
+    dateIndex.flush();
+    wordMap.saveDocuments(documentsPath);
+    wordMap.saveManifest(manifestPath);
+    segments.add(std::make_shared<const Segment>(prefix, documents)); // Queries see it from now on
+}
+
+// Brings the index up to date with folderPath without rebuilding it, using the file manifest:
+//  - files with the recorded size and modification time are skipped without being read;
+//  - files whose size or time differ are hashed, and re-indexed under a new document ID only if the
+//    contents really changed;
+//  - new files are indexed under new document IDs;
+//  - the superseded IDs of changed files, and the IDs of files that disappeared, are tombstoned;
+//  - documents removed with deleteDocument stay deleted while their file is unchanged.
+// New and changed documents are buffered in memory and written as a segment whenever the memory budget
+// fills, and once more at the end. Tombstones are applied after the segments are published, so a
+// changed document never drops out of results. Queries keep running throughout.
+SearchEngine::IndexUpdate SearchEngine::updateIndex(const std::string& folderPath) {
+    IndexUpdate update;
+    WordMap buffer; // Holds postings of new documents until they are written as a segment
+    size_t buffered = 0;
+    std::unordered_set<std::string> present;
+    for (const auto& filePath : listDocuments(folderPath)) {
+        present.insert(filePath);
+        uint32_t docId;
+        FileRecord recorded;
+        bool indexed = wordMap.findDocument(filePath, docId);
+        if (indexed && wordMap.manifest().find(docId, recorded)) { // Deleted documents stay deleted unless edited
+            FileRecord current = recorded;
+            FileRecord::stat(filePath, current);
+            if (current.size == recorded.size && current.mtime == recorded.mtime) {
+                update.unchanged++;
+                continue; // Cheap path: most files in a nightly run
+            }
+            current.hash = FileRecord::hashFile(filePath);
+            if (current.hash == recorded.hash) {
+                wordMap.manifest().track(docId, current); // Touched but identical; remember the new time
+                update.unchanged++;
+                continue;
+            }
+            indexFile(filePath, wordMap.replaceDocument(filePath), buffer);
+            update.changed++;
+        } else if (indexed && wordMap.liveDocs().isLive(docId)) {
+            wordMap.manifest().track(docId, FileRecord::describe(filePath)); // Indexed before manifests existed
+            update.unchanged++;
+            continue;
+        } else {
+            indexFile(filePath, wordMap.replaceDocument(filePath), buffer);
+            update.added++;
+        }
+        buffered++;
+        if (memoryBudget && buffer.memoryEstimate() > memoryBudget) {
+            publishSegment(buffer, buffered);
+            buffered = 0;
+        }
+    }
+    if (buffered > 0) publishSegment(buffer, buffered);
+
+    // Tombstone every live record that no longer names the current version of a present file
+    std::vector<uint32_t> tombstones;
+    LiveDocs::Snapshot live = wordMap.liveDocs().snapshot();
+    for (const auto& entry : wordMap.manifest().recorded()) {
+        if (!live.isLive(entry.first)) continue;
+        uint32_t current;
+        bool exists = present.count(entry.second.path) != 0;
+        if (!exists || !wordMap.findDocument(entry.second.path, current) || current != entry.first) {
+            tombstones.push_back(entry.first);
+            if (!exists) {
+                wordMap.manifest().forget(entry.first); // Re-added as new if the file ever comes back
+                update.deleted++;
+            }
+        }
     }
+    wordMap.liveDocs().markDeleted(tombstones);
+    wordMap.saveDocuments(documentsPath);
+    wordMap.saveManifest(manifestPath);
+    return update;
+}
+
+// Deletes a document by file path: its ID is marked in the persisted deleted-documents bitmap, so it
+// disappears from every query at once, and its postings are purged by later merges. Accepts the path
+// as indexed ("./a.json") or relative to the index folder ("a.json").
+bool SearchEngine::deleteDocument(const std::string& filePath) {
+    uint32_t docId;
+    if (!resolveDocument(filePath, docId)) return false;
+    if (!wordMap.liveDocs().markDeleted(docId)) return false; // Already deleted
+    wordMap.saveManifest(manifestPath);
+    return true;
+}
+
+// Finds the current document ID of a path given as indexed ("./a.json") or relative to the folder ("a.json")
+bool SearchEngine::resolveDocument(const std::string& filePath, uint32_t& docId) const {
+    return wordMap.findDocument(filePath, docId) || wordMap.findDocument((fs::path(".") / filePath).string(), docId);
+}
+
+// Reads the stored fields of a document from the document store: one seek for the metadata, plus one
+// block decompression when withText is set. Returns false if the document is not stored.
+bool SearchEngine::storedDocument(const std::string& filePath, StoredDocument& document, bool withText) const {
+    uint32_t docId;
+    if (!resolveDocument(filePath, docId) || !docStore.find(docId, document)) return false;
+    return !withText || docStore.text(docId, document.text);
 }
 
-// Destructor
-SearchEngine::~SearchEngine() {}
+// Reads a JSON article: returns its organization names, person names and lowercase words, and fills in
+// the fields kept in the document store. Unreadable files index as empty documents.
+std::vector<std::unordered_set<std::string>> SearchEngine::getRelevantData(const std::string& filePath, StoredDocument& stored) const {
+    SUPERSEARCH_TRACE_SPAN("SearchEngine::getRelevantData");
+    std::vector<std::unordered_set<std::string>> data(3); // Organizations, persons, words
+    std::string json; // The whole file, read in one call so I/O and parsing are timed apart
+    {
+        BuildStats::Timer timer(BuildStats::ReadFile);
+        std::ifstream file(filePath, std::ios::binary | std::ios::ate);
+        if (file) {
+            json.resize(static_cast<size_t>(file.tellg()));
+            file.seekg(0);
+            file.read(&json[0], static_cast<std::streamsize>(json.size()));
+        }
+        if (!file) json.clear();
+        BuildStats::count(BuildStats::Bytes, json.size());
+    }
+    rapidjson::Document document;
+    {
+        BuildStats::Timer timer(BuildStats::ParseJson);
+        document.Parse(json.data(), json.size());
+    }
+    if (json.empty() || document.HasParseError() || !document.IsObject()) {
+        std::cerr << "Skipping unreadable document " << filePath << "\n";
+        return data;
+    }
+
+    auto stringField = [](const rapidjson::Value& object, const char* name) {
+        return object.HasMember(name) && object[name].IsString()
+            ? std::string(object[name].GetString(), object[name].GetStringLength()) : std::string();
+    };
+    stored.title = stringField(document, "title");
+    stored.published = stringField(document, "published");
+    if (document.HasMember("thread") && document["thread"].IsObject()) {
+        stored.publication = stringField(document["thread"], "site");
+    }
+    stored.text = stringField(document, "text");
+
+    // Entity names, e.g. entities.organizations[].name
+    auto collectNames = [&](const char* kind, std::vector<std::string>& names, std::unordered_set<std::string>& terms) {
+        if (!document.HasMember("entities") || !document["entities"].IsObject()) return;
+        const rapidjson::Value& entities = document["entities"];
+        if (!entities.HasMember(kind) || !entities[kind].IsArray()) return;
+        for (const auto& entity : entities[kind].GetArray()) {
+            if (!entity.IsObject()) continue;
+            std::string name = stringField(entity, "name");
+            if (name.empty()) continue;
+            names.push_back(name);
+            terms.insert(std::move(name));
+        }
+    };
+    collectNames("organizations", stored.organizations, data[0]);
+    collectNames("persons", stored.persons, data[1]);
+
+    // Words: maximal runs of letters and digits, lowercased
+    BuildStats::Timer timer(BuildStats::Tokenize);
+    std::string word;
+    size_t tokens = 0;
+    for (char c : stored.text) {
+        if (std::isalnum(static_cast<unsigned char>(c))) {
+            word.push_back(static_cast<char>(std::tolower(static_cast<unsigned char>(c))));
+        } else if (!word.empty()) {
+            data[2].insert(word);
+            word.clear();
+            tokens++;
+        }
+    }
+    if (!word.empty()) {
+        data[2].insert(word);
+        tokens++;
+    }
+    BuildStats::count(BuildStats::Tokens, tokens);
+    return data;
+}
+
+// Purges deleted documents from the base index, which only merges of segments did before, and saves
+// it. Queries skip deleted documents already, so in live indexing mode they may run meanwhile and get
+// the same results. Returns the number of postings dropped; the index is not rewritten if there are none.
+size_t SearchEngine::compact() {
+    size_t dropped = wordMap.compact();
+    if (dropped) wordMap.save(manifestPath, orgPath, namePath, wordPath, documentsPath);
+    return dropped;
+}
+
+// Blocks until the background merger has no work left, and reports a merge that failed meanwhile
+void SearchEngine::waitForMerges() {
+    segments.waitForMerges();
+}
+
+// Collects the JSON documents under a folder in directory order. Index files written next to the
+// documents are skipped.
+std::vector<std::string> SearchEngine::listDocuments(const std::string& folderPath) {
+    std::vector<std::string> filePaths;
+    for (const auto& entry : fs::recursive_directory_iterator(folderPath)) { // Iterate over files in folder
+        if (entry.is_regular_file() && entry.path().extension() == ".json") { // Process only JSON documents
+            filePaths.push_back(entry.path().string());
+        }
+    }
+    return filePaths;
+}
+
+// Sorts files by the top-level "published" date of their JSON, oldest first, with undated files first and
+// ties kept in directory order. Only that one member is scanned for, without parsing the documents;
+// the files are read again moments later for indexing, from the page cache.
+void SearchEngine::orderByPublication(std::vector<std::string>& filePaths, size_t threads) const {
+    SUPERSEARCH_TRACE_SPAN("SearchEngine::orderByPublication");
+    std::vector<uint32_t> timestamps(filePaths.size(), DateIndex::unknown);
+    std::atomic<size_t> next{0};
+    auto worker = [&]() {
+        std::string json;
+        for (size_t i = next++; i < filePaths.size(); i = next++) {
+            BuildStats::Timer timer(BuildStats::OrderByDate);
+            std::ifstream file(filePaths[i], std::ios::binary | std::ios::ate);
+            if (!file) continue; // Reported as unreadable when it is indexed
+            json.resize(static_cast<size_t>(file.tellg()));
+            file.seekg(0);
+            file.read(&json[0], static_cast<std::streamsize>(json.size()));
+            if (file) timestamps[i] = DateIndex::parseTimestamp(DateIndex::topLevelString(json, "published"));
+        }
+    };
+    std::vector<std::thread> workers;
+    for (size_t t = 1; t < threads; t++) {
+        workers.emplace_back([&]() {
+            std::unique_ptr<BuildStats::Attach> attach;
+            if (lastBuild) attach = std::make_unique<BuildStats::Attach>(*lastBuild);
+            worker();
+        });
+    }
+    worker();
+    for (auto& thread : workers) thread.join();
+
+    std::vector<size_t> order(filePaths.size());
+    for (size_t i = 0; i < order.size(); i++) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return timestamps[a] < timestamps[b]; });
+    std::vector<std::string> sorted;
+    sorted.reserve(filePaths.size());
+    for (size_t i : order) sorted.push_back(std::move(filePaths[i]));
+    filePaths = std::move(sorted);
+}
 
 // Builds the index from scratch by processing JSON files
 void SearchEngine::buildFromScratch(const std::string& folderPath) {
+    SUPERSEARCH_TRACE_SPAN("SearchEngine::buildFromScratch");
     std::cout << "Reading JSONs..." << std::endl;
     auto start = std::chrono::high_resolution_clock::now(); // Start timing
 
-    for (const auto& entry : fs::recursive_directory_iterator(folderPath)) { // Iterate over files in folder
-        if (entry.is_regular_file()) { // Process only regular files
-            std::string filePath = entry.path().string(); // Get file path
-            std::vector<std::unordered_set<std::string>> words = getRelevantData(filePath); // Extract relevant data
-
-            // Process and index organizations
-            for (const auto& word : words[0]) {
-                std::string lowerWord = word;
-                std::transform(lowerWord.begin(), lowerWord.end(), lowerWord.begin(), ::tolower);
-                wordMap.associateOrg(lowerWord, filePath);
-            }
+    std::vector<std::string> filePaths;
+    {
+        BuildStats::Timer timer(BuildStats::ListFiles);
+        filePaths = listDocuments(folderPath);
+    }
+    size_t threadCount = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), filePaths.size()));
 
-            // Process and index person names
-            for (const auto& word : words[1]) {
-                std::string lowerWord = word;
-                std::transform(lowerWord.begin(), lowerWord.end(), lowerWord.begin(), ::tolower);
-                wordMap.associateName(lowerWord, filePath);
-            }
+    // Number documents in publication order, so date filters select contiguous ID ranges. IDs are
+    // assigned up front because the workers below finish files in no particular order.
+    orderByPublication(filePaths, threadCount);
+    std::vector<uint32_t> docIds;
+    docIds.reserve(filePaths.size());
+    for (const auto& filePath : filePaths) docIds.push_back(wordMap.addDocument(filePath));
 
-            // Process and index words after applying text processing
-            for (const auto& word : words[2]) {
-                std::string processedWord = textProcessor.processWord(word);
-                if (!processedWord.empty()) {
-                    wordMap.associateWord(processedWord, filePath);
+    // Flushes the in-memory postings as the next sorted run. Callers must hold flushLock exclusively.
+    auto flushRun = [&]() {
+        BuildStats::Timer timer(BuildStats::FlushRun);
+        if (runDirectory.empty()) {
+            auto stamp = std::chrono::steady_clock::now().time_since_epoch().count();
+            runDirectory = (fs::temp_directory_path() / ("supersearch-runs-" + std::to_string(stamp))).string();
+            fs::create_directories(runDirectory);
+        }
+        std::string prefix = (fs::path(runDirectory) / ("run" + std::to_string(runPrefixes.size()))).string();
+        wordMap.flushRun(prefix);
+        runPrefixes.push_back(prefix);
+    };
+
+    // Index files on several threads; WordMap locks only the shard each term routes to. With a memory
+    // budget, threads share flushLock while indexing and one takes it exclusively to flush a run.
+    std::shared_mutex flushLock;
+    std::atomic<size_t> next{0}; // Next file to hand out
+    std::exception_ptr failure; // First error raised by any worker
+    std::mutex failureLock;
+    auto worker = [&]() {
+        try {
+            for (size_t i = next++; i < filePaths.size(); i = next++) {
+                {
+                    std::shared_lock<std::shared_mutex> indexing(flushLock);
+                    indexFile(filePaths[i], docIds[i], wordMap);
+                }
+                if (memoryBudget && wordMap.memoryEstimate() > memoryBudget) {
+                    std::unique_lock<std::shared_mutex> flushing(flushLock);
+                    if (wordMap.memoryEstimate() > memoryBudget) flushRun(); // Another thread may have flushed first
                 }
             }
+        } catch (...) {
+            std::lock_guard<std::mutex> guard(failureLock);
+            if (!failure) failure = std::current_exception();
+            next = filePaths.size(); // Stop the other workers early
         }
+    };
+    std::vector<std::thread> workers;
+    for (size_t t = 1; t < threadCount; t++) {
+        workers.emplace_back([&]() {
+            std::unique_ptr<BuildStats::Attach> attach; // The calling thread is attached by the constructor
+            if (lastBuild) attach = std::make_unique<BuildStats::Attach>(*lastBuild);
+            worker();
+        });
+    }
+    worker(); // The calling thread works too
+    for (auto& thread : workers) thread.join();
+    if (lastBuild) lastBuild->setThreads(threadCount);
+    if (failure) std::rethrow_exception(failure);
+    if (!runPrefixes.empty() && wordMap.memoryEstimate() > 0) {
+        flushRun(); // The tail of the corpus becomes the last run
     }
 
     auto end = std::chrono::high_resolution_clock::now(); // End timing
@@ -147,7 +943,26 @@ void SearchEngine::buildFromScratch(const std::string& folderPath) {
     std::cout << "JSONs read in " << duration.count() << " seconds.\n"; // Output duration
 }
 
+// Normalizes a word or a prefix query ("bank*") so it matches the stemmed keys in wordIndex
+std::string SearchEngine::processPrefixOrWord(const std::string& term) const {
+    if (term.size() < 2 || term.back() != '*') {
+        return textProcessor.processWord(term); // Plain word: stopword removal and stemming
+    }
+
+    // Stemming can rewrite the tail of a word ("company" -> "compani"), so keep only the part
+    // the raw prefix and its stem agree on; every stem the prefix could produce then matches.
+    std::string prefix = term.substr(0, term.size() - 1);
+    std::string stemmed = textProcessor.stem(prefix);
+    size_t common = 0;
+    while (common < prefix.size() && common < stemmed.size() && prefix[common] == stemmed[common]) {
+        common++;
+    }
+    if (common == 0) return ""; // Nothing left to match on
+    return prefix.substr(0, common) + "*";
+}
+
 std::unordered_set<std::string> SearchEngine::parse(const std::string& searchTerms) const {
+    SUPERSEARCH_TRACE_SPAN("SearchEngine::parse");
     // Initialize an unordered set to store unique search terms.
     std::unordered_set<std::string> terms;
 
@@ -162,12 +977,20 @@ std::unordered_set<std::string> SearchEngine::parse(const std::string& searchTer
 
         // Handle special search terms starting with "org:" or "person:".
         if (term.rfind("org:", 0) == 0 || term.rfind("person:", 0) == 0) {
-            terms.insert(term); // Add the term as is.
+            terms.insert(term); // Add the term as is (a trailing '*' marks a prefix query).
+        }
+        // Handle date filters: "after:2018-01-01" (on or after) and "before:2018-04-01" (strictly before).
+        else if (term.rfind("after:", 0) == 0 || term.rfind("before:", 0) == 0) {
+            int64_t seconds;
+            if (!DateIndex::parseSeconds(term.substr(term.find(':') + 1), seconds)) {
+                throw std::invalid_argument("Malformed date in " + term + " (expected YYYY-MM-DD)");
+            }
+            terms.insert(term);
         }
         // Handle negated terms (starting with '-').
         else if (term[0] == '-') {
             // Process the term (excluding the '-') using the text processor.
-            std::string processedTerm = "-" + textProcessor.processWord(term.substr(1));
+            std::string processedTerm = "-" + processPrefixOrWord(term.substr(1));
             if (processedTerm.length() > 1) { // Ensure there's something valid after the '-'.
                 terms.insert(processedTerm); // Add the processed negated term.
             }
@@ -175,7 +998,7 @@ std::unordered_set<std::string> SearchEngine::parse(const std::string& searchTer
         // Handle regular search terms.
         else {
             // Process the term using the text processor (e.g., stemming).
-            std::string processedTerm = textProcessor.processWord(term);
+            std::string processedTerm = processPrefixOrWord(term);
             if (!processedTerm.empty()) { // Skip empty terms after processing.
                 terms.insert(processedTerm); // Add the processed term to the set.
             }
@@ -185,3 +1008,294 @@ std::unordered_set<std::string> SearchEngine::parse(const std::string& searchTer
     // Return the set of parsed search terms.
     return terms;
 }
+
+// Looks up the postings for one parsed term, dispatching on its field and prefix marker, and unites
+// the base index's postings with those of every live segment in one merge
+std::shared_ptr<const PostingList> SearchEngine::lookup(const std::string& term) const {
+    SUPERSEARCH_TRACE_SPAN("SearchEngine::lookup");
+    bool isPrefix = term.size() > 1 && term.back() == '*'; // Trailing '*' requests a prefix expansion
+
+    std::shared_ptr<const PostingList> files;
+    Segment::Field field = Segment::Word;
+    std::string key = term;
+    if (term.rfind("org:", 0) == 0) {
+        field = Segment::Org;
+        key = term.substr(4);
+        files = isPrefix ? wordMap.getFilesByOrgPrefix(key.substr(0, key.size() - 1)) : wordMap.getFilesByOrg(key);
+    } else if (term.rfind("person:", 0) == 0) {
+        field = Segment::Name;
+        key = term.substr(7);
+        files = isPrefix ? wordMap.getFilesByNamePrefix(key.substr(0, key.size() - 1)) : wordMap.getFilesByName(key);
+    } else {
+        files = isPrefix ? wordMap.getFilesByWordPrefix(key.substr(0, key.size() - 1)) : wordMap.getFilesByWord(key);
+    }
+
+    auto live = segments.snapshot(); // Keeps these segments alive even if a merge replaces them meanwhile
+    std::vector<std::shared_ptr<const PostingList>> lists;
+    if (!files->empty()) lists.push_back(files);
+    for (const auto& segment : *live) {
+        if (isPrefix) {
+            gatherPrefix(segment->field(field), key.substr(0, key.size() - 1), maxPrefixExpansions, lists);
+        } else {
+            std::shared_ptr<PostingList> found;
+            if (segment->field(field).find(key, found) && found && !found->empty()) lists.push_back(found);
+        }
+    }
+    return lists.empty() ? files : uniteLists(lists);
+}
+
+// Fetches the postings of a query's required terms, rarest first, and of its negated terms, and turns
+// its after: and before: filters into the document ID ranges they allow (every ID when there are none)
+void SearchEngine::lookupTerms(const std::string& searchTerms, std::vector<std::shared_ptr<const PostingList>>& required,
+                               std::vector<std::shared_ptr<const PostingList>>& excluded,
+                               std::vector<DateIndex::Range>& documents) const {
+    std::unordered_set<std::string> terms = parse(searchTerms);
+
+    // Fetch postings for positive and negated terms separately; date filters narrow the document IDs.
+    // Bounds are kept in 64 bits so dates outside the indexed range (before:1970-01-01, after:2200-01-01)
+    // give an empty range instead of wrapping around.
+    int64_t from = 0, until = UINT32_MAX, seconds;
+    bool dated = false;
+    for (const auto& term : terms) {
+        if (term.rfind("after:", 0) == 0) {
+            if (!DateIndex::parseSeconds(term.substr(6), seconds)) throw std::invalid_argument("Malformed date in " + term);
+            from = std::max(from, seconds);
+            dated = true;
+        } else if (term.rfind("before:", 0) == 0) {
+            if (!DateIndex::parseSeconds(term.substr(7), seconds)) throw std::invalid_argument("Malformed date in " + term);
+            until = std::min(until, seconds - 1);
+            dated = true;
+        } else if (term[0] == '-') {
+            excluded.push_back(lookup(term.substr(1)));
+        } else {
+            required.push_back(lookup(term));
+        }
+    }
+    std::sort(required.begin(), required.end(), [](const auto& a, const auto& b) { return a->size() < b->size(); });
+    if (!dated) documents = {DateIndex::allDocuments};
+    else if (from > until) documents.clear(); // No document can match
+    else documents = dateIndex.ranges(static_cast<uint32_t>(from), static_cast<uint32_t>(until));
+}
+
+// Evaluates a query's posting algebra: the live documents containing every required term and none of
+// the negated ones, each scored by the summed frequencies of the required terms
+PostingList SearchEngine::evaluate(const std::string& searchTerms) const {
+    std::vector<std::shared_ptr<const PostingList>> required, excluded;
+    std::vector<DateIndex::Range> documents;
+    lookupTerms(searchTerms, required, excluded, documents);
+    if (required.empty()) return PostingList();
+
+    // Intersect from the rarest term up, so every step probes the fewest documents; frequencies are
+    // summed into the relevance score.
+    LiveDocs::Snapshot live = wordMap.liveDocs().snapshot(); // One bitmap version for the whole query
+
+    // Drop deleted documents and those outside the date filter from the rarest list first; later
+    // intersections can then never reach them.
+    PostingList matches;
+    {
+        SUPERSEARCH_TRACE_SPAN("SearchEngine::search intersect");
+        bool dated = documents.size() != 1 || documents[0] != DateIndex::allDocuments;
+        if (dated) matches = PostingList::slice(*required[0], documents);
+        if (live.hasDeletions()) {
+            matches = PostingList::filter(dated ? matches : *required[0], [&](uint32_t doc) { return live.isLive(doc); });
+        } else if (!dated) {
+            matches = *required[0];
+        }
+        for (size_t i = 1; i < required.size() && !matches.empty(); i++) {
+            matches = PostingList::intersect(matches, *required[i]);
+        }
+    }
+
+    // Remove every document that contains a negated term (ANDNOT; O(1) probes against bitmaps).
+    {
+        SUPERSEARCH_TRACE_SPAN("SearchEngine::search subtract");
+        for (const auto& negated : excluded) {
+            matches = PostingList::subtract(matches, *negated);
+        }
+    }
+    return matches;
+}
+
+std::vector<std::string> SearchEngine::search(const std::string& searchTerms) const {
+    SUPERSEARCH_TRACE_SPAN("SearchEngine::search");
+    PostingList matches = evaluate(searchTerms);
+
+    // Order results by descending score, breaking ties by document ID for stable output.
+    std::vector<std::pair<uint32_t, int>> ranked;
+    {
+        SUPERSEARCH_TRACE_SPAN("SearchEngine::search rank");
+        ranked.reserve(matches.size());
+        matches.forEach([&](uint32_t doc, int score) { ranked.emplace_back(doc, score); });
+        std::stable_sort(ranked.begin(), ranked.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+    }
+
+    SUPERSEARCH_TRACE_SPAN("SearchEngine::search paths");
+    std::vector<std::string> results;
+    results.reserve(ranked.size());
+    for (const auto& entry : ranked) {
+        results.push_back(wordMap.documentPath(entry.first));
+    }
+    return results;
+}
+
+// Counts the live documents matching a query without scoring them or looking up their paths. Lists are
+// only read, never copied: one term is its list's size, two terms are counted with popcounts over
+// their dense containers, and anything else (negations, deletions, more terms) is a leapfrog over
+// cursors that counts instead of collecting.
+size_t SearchEngine::count(const std::string& searchTerms) const {
+    SUPERSEARCH_TRACE_SPAN("SearchEngine::count");
+    std::vector<std::shared_ptr<const PostingList>> required, excluded;
+    std::vector<DateIndex::Range> documents;
+    lookupTerms(searchTerms, required, excluded, documents);
+    if (required.empty()) return 0;
+    LiveDocs::Snapshot live = wordMap.liveDocs().snapshot();
+    bool dated = documents.size() != 1 || documents[0] != DateIndex::allDocuments;
+    if (excluded.empty() && !live.hasDeletions() && !dated) {
+        if (required.size() == 1) return required[0]->size();
+        if (required.size() == 2) return PostingList::intersectCount(*required[0], *required[1]);
+    }
+
+    std::vector<const PostingList*> all, none;
+    for (const auto& list : required) all.push_back(list.get());
+    for (const auto& list : excluded) none.push_back(list.get());
+    size_t n = 0;
+    PostingList::forEachMatch(all, none, documents, [&](uint32_t doc) {
+        n += live.isLive(doc);
+        return true;
+    });
+    return n;
+}
+
+// Whether any live document matches a query; stops at the first one found
+bool SearchEngine::exists(const std::string& searchTerms) const {
+    SUPERSEARCH_TRACE_SPAN("SearchEngine::exists");
+    std::vector<std::shared_ptr<const PostingList>> required, excluded;
+    std::vector<DateIndex::Range> documents;
+    lookupTerms(searchTerms, required, excluded, documents);
+    if (required.empty() || required[0]->empty()) return false;
+    LiveDocs::Snapshot live = wordMap.liveDocs().snapshot();
+
+    std::vector<const PostingList*> all, none;
+    for (const auto& list : required) all.push_back(list.get());
+    for (const auto& list : excluded) none.push_back(list.get());
+    bool found = false;
+    PostingList::forEachMatch(all, none, documents, [&](uint32_t doc) {
+        found = live.isLive(doc);
+        return !found;  // Keep going only past deleted documents
+    });
+    return found;
+}
+
+// Counts the most frequent organizations and persons among the live documents matching a query, from
+// the forward lists stored at index time; no document is read. Large result sets are sampled (see
+// FacetIndex::count).
+FacetIndex::Result SearchEngine::facets(const std::string& searchTerms, size_t top, size_t sampleThreshold) const {
+    SUPERSEARCH_TRACE_SPAN("SearchEngine::facets");
+    std::vector<std::shared_ptr<const PostingList>> required, excluded;
+    std::vector<DateIndex::Range> documents;
+    lookupTerms(searchTerms, required, excluded, documents);
+    std::vector<uint32_t> docs;
+    if (!required.empty()) {
+        LiveDocs::Snapshot live = wordMap.liveDocs().snapshot();
+        std::vector<const PostingList*> all, none;
+        for (const auto& list : required) all.push_back(list.get());
+        for (const auto& list : excluded) none.push_back(list.get());
+        docs.reserve(required[0]->size());
+        PostingList::forEachMatch(all, none, documents, [&](uint32_t doc) {
+            if (live.isLive(doc)) docs.push_back(doc);
+            return true;
+        });
+    }
+    SUPERSEARCH_TRACE_SPAN("SearchEngine::facets count");
+    return facetIndex.count(docs, top, sampleThreshold);
+}
+
+// Returns the first page of k results
+SearchEngine::Page SearchEngine::search(const std::string& searchTerms, size_t k) const {
+    return search(searchTerms, k, Cursor());
+}
+
+// Returns the k best results that come after a cursor in (descending score, ascending document ID)
+// order. Matches are streamed from a leapfrog over the term cursors into a k-sized heap, so no match
+// list is built, only the requested page is sorted and only its paths are looked up. Earlier pages are
+// skipped by comparison against the cursor, but every page still scans all the matches.
+SearchEngine::Page SearchEngine::search(const std::string& searchTerms, size_t k, const Cursor& after) const {
+    SUPERSEARCH_TRACE_SPAN("SearchEngine::search page");
+    std::vector<std::shared_ptr<const PostingList>> required, excluded;
+    std::vector<DateIndex::Range> documents;
+    lookupTerms(searchTerms, required, excluded, documents);
+    Page page;
+
+    using Hit = std::pair<int, uint32_t>; // (score, document)
+    auto better = [](const Hit& a, const Hit& b) { return a.first > b.first || (a.first == b.first && a.second < b.second); };
+    std::vector<Hit> best; // Heap whose front is the worst of the k best so far
+    size_t remaining = 0; // Matches after the cursor
+    if (!required.empty()) {
+        SUPERSEARCH_TRACE_SPAN("SearchEngine::search rank");
+        LiveDocs::Snapshot live = wordMap.liveDocs().snapshot(); // One bitmap version for the whole query
+        std::vector<const PostingList*> all, none;
+        for (const auto& list : required) all.push_back(list.get());
+        for (const auto& list : excluded) none.push_back(list.get());
+        best.reserve(std::min(k, required[0]->size()));
+        PostingList::forEachMatch(all, none, documents, [&](uint32_t doc, int score) {
+            if (!live.isLive(doc)) return true;
+            page.totalHits++;
+            Hit hit(score, doc);
+            if (after.started && !better(Hit(after.score, after.doc), hit)) return true; // On an earlier page
+            remaining++;
+            if (k == 0) return true;
+            if (best.size() < k) {
+                best.push_back(hit);
+                std::push_heap(best.begin(), best.end(), better);
+            } else if (better(hit, best.front())) {
+                std::pop_heap(best.begin(), best.end(), better);
+                best.back() = hit;
+                std::push_heap(best.begin(), best.end(), better);
+            }
+            return true;
+        });
+        std::sort_heap(best.begin(), best.end(), better); // Best first
+    }
+
+    SUPERSEARCH_TRACE_SPAN("SearchEngine::search paths");
+    page.results.reserve(best.size());
+    page.scores.reserve(best.size());
+    for (const auto& [score, doc] : best) {
+        page.results.push_back(wordMap.documentPath(doc));
+        page.scores.push_back(score);
+    }
+    page.hasMore = remaining > best.size();
+    page.next = after;
+    if (!best.empty()) page.next = Cursor{best.back().first, best.back().second, true};
+    return page;
+}
+
+// Writes a cursor as "score:doc", or "" before the first page
+std::string SearchEngine::Cursor::toString() const {
+    return started ? std::to_string(score) + ":" + std::to_string(doc) : std::string();
+}
+
+// Reads a cursor written by toString; an empty token is the first page. Anything else toString could
+// not have written (signs, trailing characters, out-of-range numbers) is rejected.
+SearchEngine::Cursor SearchEngine::Cursor::parse(const std::string& token) {
+    Cursor cursor;
+    if (token.empty()) return cursor;
+    size_t colon = token.find(':');
+    std::string score = token.substr(0, colon == std::string::npos ? 0 : colon);
+    std::string doc = colon == std::string::npos ? std::string() : token.substr(colon + 1);
+    auto isNumber = [](const std::string& digits) {
+        return !digits.empty() && std::all_of(digits.begin(), digits.end(), [](char c) { return c >= '0' && c <= '9'; });
+    };
+    if (!isNumber(score) || !isNumber(doc)) throw std::invalid_argument("Malformed cursor " + token);
+    try {
+        size_t scoreEnd = 0, docEnd = 0;
+        cursor.score = std::stoi(score, &scoreEnd);
+        unsigned long id = std::stoul(doc, &docEnd);
+        if (scoreEnd != score.size() || docEnd != doc.size() || id > UINT32_MAX) throw std::out_of_range(token);
+        cursor.doc = static_cast<uint32_t>(id);
+    } catch (const std::out_of_range&) {
+        throw std::invalid_argument("Malformed cursor " + token);
+    }
+    cursor.started = true;
+    return cursor;
+}
@@ -3,11 +3,26 @@
 #define SEARCH_ENGINE_H
 
 #include "avl_tree.h"  // Include the AVLTree class for efficient data indexing
+#include "build_stats.h"  // Include the per-phase timers and counters of an index build
+#include "date_index.h"  // Include the per-document publication times used by date filters
+#include "doc_store.h"  // Include the binary store of displayable document fields
+#include "facet_index.h"  // Include the per-document organization and person lists used for facet counts
+#include "file_manifest.h"  // Include the per-file records used to detect changed documents
+#include "lazy_postings.h"  // Include the on-demand postings and their LRU cache
+#include "live_docs.h"  // Include the bitmap of deleted documents skipped by queries
+#include "memory_stats.h"  // Include the per-component memory report
+#include "posting_list.h"  // Include the adaptive array/bitmap posting lists
+#include "segment.h"  // Include the immutable segments that hold incrementally added documents
+#include "sharded_index.h"  // Include the hash-sharded AVLTree dictionary used for parallel indexing
 #include "text_processor.h"  // Include the TextProcessor class for text preprocessing and stemming
 #include <string>  // Include string library for text handling
 #include <vector>  // Include vector library for dynamic arrays
 #include <unordered_set>  // Include unordered_set for fast lookups of unique elements
 #include <unordered_map>  // Include unordered_map for key-value pair storage and quick access
+#include <memory>  // Include shared_ptr for postings shared between index versions
+#include <shared_mutex>  // Include shared_mutex for the document table read by queries while indexing
+#include <cstdint>  // Include fixed-width integers for document IDs
+#include <atomic>  // Include atomics for the running memory estimate
 
 class SearchEngine {  // Declaration of the SearchEngine class
 private:
@@ -15,15 +30,53 @@ private:
 
     class WordMap {  // Nested WordMap class to manage associations between words and files
 
+    public:
+        using Postings = PostingList;  // Documents (by ID) a term occurs in, with per-document counts
+        using PostingsIndex = ShardedIndex<std::shared_ptr<Postings>>;  // Postings are shared so path copies stay cheap
+
     private:
-        AVLTree<std::unordered_map<std::string, int>> orgIndex;  // AVLTree to index organizations and their occurrences
-        AVLTree<std::unordered_map<std::string, int>> nameIndex;  // AVLTree to index names and their occurrences
-        AVLTree<std::unordered_map<std::string, int>> wordIndex;  // AVLTree to index words and their occurrences
+        PostingsIndex orgIndex;  // AVLTree to index organizations and their occurrences
+        PostingsIndex nameIndex;  // AVLTree to index names and their occurrences
+        PostingsIndex wordIndex;  // AVLTree to index words and their occurrences
+        bool persistent = false;  // When set, published postings are only appended to in place, or copied
+
+        std::vector<std::string> documents;  // File path of every document, indexed by document ID
+        std::unordered_map<std::string, uint32_t> documentIds;  // File path -> document ID
+        mutable std::shared_mutex documentsLock;  // Guards the document table against concurrent indexing
+        FileManifest files;  // Size, modification time and hash of every document's file
+        LiveDocs live;  // Documents deleted or superseded since they were indexed
+        std::atomic<size_t> approxBytes{0};  // Rough size of the in-memory postings, for the build memory budget
+        PostingCache postingCache;  // Postings read on demand when the index is loaded lazily
+        LazyPostingIndex lazyOrg;  // On-disk organization postings, when loaded lazily
+        LazyPostingIndex lazyName;  // On-disk name postings, when loaded lazily
+        LazyPostingIndex lazyWord;  // On-disk word postings, when loaded lazily
+        bool lazy = false;  // When set, load() reads only the term dictionaries
+        bool lazyLoaded = false;  // The last load() was lazy, so lookups consult the on-disk postings
+
+        void associate(PostingsIndex& index, const std::string& key, uint32_t docId, int occurrences);  // Add occurrences to a term's postings
 
     public:
-        void associateOrg(const std::string& org, const std::string& filepath);  // Associate an organization with a file
-        void associateName(const std::string& name, const std::string& filepath);  // Associate a name with a file
-        void associateWord(const std::string& word, const std::string& filepath);  // Associate a word with a file
+        explicit WordMap(size_t shards = 1);  // Split each field's dictionary into this many hash shards
+
+        void setPersistent(bool enabled);  // Let queries run concurrently with indexing threads
+        void setLazy(size_t cacheBytes);  // Load only term dictionaries, caching up to cacheBytes of postings (0 = load everything)
+        PostingCache::Stats postingCacheStats() const;  // Hit and miss counts of the posting cache
+        uint32_t addDocument(const std::string& filepath);  // Assign (or return) the document ID of a file
+        uint32_t replaceDocument(const std::string& filepath);  // Assign a file a fresh document ID for its new contents
+        std::string documentPath(uint32_t docId) const;  // File path of a document ID
+        size_t documentCount() const;  // Number of documents with an ID
+        bool findDocument(const std::string& filepath, uint32_t& docId) const;  // Current document ID of a file, if any
+        FileManifest& manifest();  // Records of the indexed files
+        const FileManifest& manifest() const;  // Read-only records of the indexed files
+        LiveDocs& liveDocs();  // Deleted documents
+        const LiveDocs& liveDocs() const;  // Read-only view of the deleted documents
+        void saveManifest(const std::string& filenamepath) const;  // Write the file manifest and deleted-documents bitmap
+        void saveDocuments(const std::string& fsavePath) const;  // Write the document ID -> file path table
+        bool loadDocuments(const std::string& fsavePath);  // Read the table written by saveDocuments
+
+        void associateOrg(const std::string& org, uint32_t docId, int occurrences = 1);  // Associate an organization with a document
+        void associateName(const std::string& name, uint32_t docId, int occurrences = 1);  // Associate a name with a document
+        void associateWord(const std::string& word, uint32_t docId, int occurrences = 1);  // Associate a word with a document
 
         bool load(const std::string& filenamepath, const std::string& osavePath,  // Load indices from file paths
                   const std::string& nsavePath, const std::string& wsavePath,
@@ -33,27 +86,112 @@ private:
                   const std::string& nsavePath, const std::string& wsavePath,
                   const std::string& fsavePath) const;
 
-        std::unordered_map<std::string, int> getFilesByOrg(const std::string& org) const;  // Retrieve files associated with an organization
-        std::unordered_map<std::string, int> getFilesByName(const std::string& name) const;  // Retrieve files associated with a name
-        std::unordered_map<std::string, int> getFilesByWord(const std::string& word) const;  // Retrieve files associated with a word
-        std::unordered_map<std::string, int> getOtherFilesByWord(const std::string& word) const;  // Retrieve additional files associated with a word
+        size_t memoryEstimate() const;  // Approximate bytes held by the in-memory postings
+        void memoryStats(IndexMemoryStats& stats, size_t top) const;  // Walk the dictionaries and tables, adding their sizes to stats
+        void flushRun(const std::string& runPrefix);  // Write the postings as a sorted run and empty the indices
+        size_t compact();  // Drop the postings of deleted documents; returns how many were dropped
+        void mergeRuns(const std::vector<std::string>& runPrefixes,  // K-way merge runs into the final index files
+                       const std::string& filenamepath, const std::string& osavePath,
+                       const std::string& nsavePath, const std::string& wsavePath,
+                       const std::string& fsavePath) const;
+
+        std::shared_ptr<const Postings> getFilesByOrg(const std::string& org) const;  // Retrieve documents associated with an organization
+        std::shared_ptr<const Postings> getFilesByName(const std::string& name) const;  // Retrieve documents associated with a name
+        std::shared_ptr<const Postings> getFilesByWord(const std::string& word) const;  // Retrieve documents associated with a word
+        std::shared_ptr<const Postings> getOtherFilesByWord(const std::string& word) const;  // Retrieve additional documents associated with a word
+
+        std::shared_ptr<const Postings> getFilesByOrgPrefix(const std::string& prefix) const;  // Union of documents for every organization starting with prefix
+        std::shared_ptr<const Postings> getFilesByNamePrefix(const std::string& prefix) const;  // Union of documents for every name starting with prefix
+        std::shared_ptr<const Postings> getFilesByWordPrefix(const std::string& prefix) const;  // Union of documents for every word starting with prefix
     };
 
-    WordMap wordMap;  // Instance of WordMap to manage word-to-file associations
+    static constexpr size_t maxPrefixExpansions = 128;  // Upper bound on the number of terms a single prefix query may expand to
+
+    static constexpr size_t indexShards = 64;  // Hash shards per field, so parallel indexing threads rarely contend
+
+    WordMap wordMap{indexShards};  // Instance of WordMap to manage word-to-file associations
+    size_t memoryBudget;  // Bytes of postings to hold in memory while building before flushing a run (0 = no limit)
+    std::string runDirectory;  // Temporary directory holding flushed runs during a budgeted build
+    std::vector<std::string> runPrefixes;  // Runs flushed by the current build, in order
+    std::string documentsPath;  // Where the document table is saved (fsavePath)
+    std::string manifestPath;  // Where the file manifest is saved (filenamepath)
+    std::string orgPath;  // Where the organization index is saved (osavePath)
+    std::string namePath;  // Where the name index is saved (nsavePath)
+    std::string wordPath;  // Where the word index is saved (wsavePath)
+    SegmentSet segments;  // Immutable segments of documents added after the base index was built
+    DocStore docStore;  // Title, date, publication, entities and compressed text of every document
+    FacetIndex facetIndex;  // Organization and person IDs of every document, for facet counts
+    DateIndex dateIndex;  // Publication time of every document, for after: and before: filters
+    std::unique_ptr<BuildStats> lastBuild;  // Phase timings of the build done by the constructor, if any
+    static std::vector<std::string> listDocuments(const std::string& folderPath);  // JSON documents under a folder
+    void orderByPublication(std::vector<std::string>& filePaths, size_t threads) const;  // Sort files by their published date
     void buildFromScratch(const std::string& folderPath);  // Build indices from a folder of documents
-    std::vector<std::unordered_set<std::string>> getRelevantData(const std::string& filePath) const;  // Extract relevant data from a file
+    void indexFile(const std::string& filePath, uint32_t docId, WordMap& target);  // Add one document's organizations, names and words to target
+    void publishSegment(WordMap& buffer, size_t documents);  // Write a buffer of new documents as a segment and make it searchable
+    std::vector<std::unordered_set<std::string>> getRelevantData(const std::string& filePath, StoredDocument& stored) const;  // Extract relevant data and stored fields from a file
+    bool resolveDocument(const std::string& filePath, uint32_t& docId) const;  // Document ID of a path as indexed or relative to the folder
+    std::string processPrefixOrWord(const std::string& term) const;  // Stem a word, or normalize a "prefix*" query term
+    std::shared_ptr<const PostingList> lookup(const std::string& term) const;  // Fetch the postings for one parsed term
+    void lookupTerms(const std::string& searchTerms, std::vector<std::shared_ptr<const PostingList>>& required,  // Postings of a query's terms,
+                     std::vector<std::shared_ptr<const PostingList>>& excluded,  // required ones rarest first, and the
+                     std::vector<DateIndex::Range>& documents) const;  // document IDs its date filters allow
     std::unordered_set<std::string> parse(const std::string& searchTerms) const;  // Parse search terms into individual words
+    PostingList evaluate(const std::string& searchTerms) const;  // Live documents matching a query, with their scores
+    friend struct SearchEngineBench;  // Lets supersearch_bench time parse() on its own
 
 public:
+    struct IndexUpdate {  // What an incremental index run found in the folder
+        size_t added = 0;  // New files, indexed into segments
+        size_t changed = 0;  // Modified files, re-indexed under a new document ID
+        size_t deleted = 0;  // Files that disappeared, tombstoned
+        size_t unchanged = 0;  // Files skipped because they are already indexed as they are
+    };
+
+    struct Cursor {  // Where a page of results ended; results are ordered by descending score, then document ID
+        int score = 0;  // Score of the last result returned
+        uint32_t doc = 0;  // Document ID of the last result returned
+        bool started = false;  // False for the first page
+
+        std::string toString() const;  // Compact token for passing the cursor between requests ("" for the first page)
+        static Cursor parse(const std::string& token);  // Reads a token written by toString
+    };
+
+    struct Page {  // One page of search results
+        std::vector<std::string> results;  // File paths, best first
+        std::vector<int> scores;  // Score of each result
+        size_t totalHits = 0;  // Number of documents matching the query, over all pages
+        bool hasMore = false;  // Whether results remain after this page
+        Cursor next;  // Pass to search() to get the following page
+    };
+
     SearchEngine(const std::string& folderPath,  // Constructor to initialize the search engine and indices
                  const std::string& filenamepath = "index.dat",
                  const std::string& osavePath = "org.dat",
                  const std::string& nsavePath = "name.dat",
                  const std::string& wsavePath = "word.dat",
-                 const std::string& fsavePath = "freq.dat");
+                 const std::string& fsavePath = "freq.dat",
+                 size_t memoryBudget = 0,
+                 size_t postingCacheBytes = 0);
     ~SearchEngine();  // Destructor to clean up resources
 
     std::vector<std::string> search(const std::string& searchTerms) const;  // Perform a search and return matching file paths
+    Page search(const std::string& searchTerms, size_t k) const;  // The k best results
+    Page search(const std::string& searchTerms, size_t k, const Cursor& after) const;  // The k best results after a cursor
+    size_t count(const std::string& searchTerms) const;  // Number of matching documents, without materializing results
+    bool exists(const std::string& searchTerms) const;  // Whether any document matches, stopping at the first
+    FacetIndex::Result facets(const std::string& searchTerms, size_t top = 10,  // Most frequent organizations and persons among the matches
+                              size_t sampleThreshold = FacetIndex::defaultSampleThreshold) const;
+
+    void setLiveIndexing(bool enabled);  // Allow search() from any thread while addDocument() runs
+    void addDocument(const std::string& filePath);  // Index one more document; results become visible immediately
+    IndexUpdate updateIndex(const std::string& folderPath);  // Index added or changed files as new segments and tombstone deleted ones
+    bool deleteDocument(const std::string& filePath);  // Remove a document from results; false if it is not indexed
+    bool storedDocument(const std::string& filePath, StoredDocument& document, bool withText = false) const;  // Fetch a result's stored fields
+    size_t compact();  // Rewrite and save the base index without the postings of deleted documents
+    void waitForMerges();  // Block until background segment merges have finished; throws if one failed
+    PostingCache::Stats postingCacheStats() const;  // Hit ratio of the posting cache used when postingCacheBytes > 0
+    const BuildStats* buildStats() const;  // Phase timings and counters of the build, or null if the index was loaded
+    IndexMemoryStats memoryStats(size_t top = 10) const;  // Bytes per index component, term statistics and the top longest posting lists
 };
 
 #endif  // End of include guard
@@ -0,0 +1,305 @@
+// segment.h
+#ifndef SEGMENT_H  // Include guard to prevent multiple inclusions of this header file
+#define SEGMENT_H
+
+#include "avl_tree.h"  // Each field of a segment is a bulk-loaded AVLTree
+#include "live_docs.h"  // Deleted documents are purged when segments merge
+#include "posting_list.h"  // Postings stored in every field
+#include "run_merger.h"  // Streaming merge used to combine segments
+#include <algorithm>  // For sorting segments into tiers
+#include <atomic>  // For atomic publication of the live segment list
+#include <condition_variable>  // For waking the background merge thread
+#include <cstdio>  // For std::remove and std::rename
+#include <exception>  // For handing merge failures to waitForMerges
+#include <fstream>  // For the segment manifest
+#include <functional>  // For the hook that supplies the deleted documents
+#include <iostream>  // For reporting failed merges
+#include <memory>  // For shared ownership of segments by queries
+#include <mutex>  // For serializing publications
+#include <stdexcept>  // For reporting damaged manifests
+#include <string>  // For file prefixes and keys
+#include <thread>  // For the background merge thread
+#include <utility>  // For taking the reported merge failure
+#include <vector>  // For segment lists
+
+// An immutable piece of the index covering a batch of documents added after the base index was built.
+// Its three fields are loaded once from "<prefix>.org", "<prefix>.name" and "<prefix>.word" (the run
+// format written by WordMap::flushRun) and never modified, so any number of queries may read it.
+class Segment {
+public:
+    using Index = AVLTree<std::shared_ptr<PostingList>>;  // Same value type as the base index
+    enum Field { Org, Name, Word, FieldCount };  // Dictionaries held by every segment
+
+    // File suffix of each field
+    static const char* suffix(Field field) {
+        static const char* suffixes[FieldCount] = {".org", ".name", ".word"};
+        return suffixes[field];
+    }
+
+private:
+    std::string prefix;  // Path prefix of the segment's files
+    size_t docCount;  // Documents indexed in the segment, used by the merge policy
+    Index fields[FieldCount];  // One dictionary per field
+
+public:
+    // Loads the segment's three field files
+    Segment(const std::string& filePrefix, size_t documents) : prefix(filePrefix), docCount(documents) {
+        for (int f = 0; f < FieldCount; f++) {
+            fields[f].loadFromFile(prefix + suffix(static_cast<Field>(f)));
+        }
+    }
+
+    const std::string& filePrefix() const { return prefix; }  // Path prefix of the segment's files
+    size_t documentCount() const { return docCount; }  // Documents in the segment
+    const Index& field(Field f) const { return fields[f]; }  // Dictionary for one field
+
+    // Deletes the files of the segment stored under a prefix
+    static void removeFiles(const std::string& filePrefix) {
+        for (int f = 0; f < FieldCount; f++) {
+            std::remove((filePrefix + suffix(static_cast<Field>(f))).c_str());
+        }
+    }
+
+    // Deletes this segment's files; the loaded dictionaries stay usable
+    void removeFiles() const { removeFiles(prefix); }
+};
+
+// The list of live segments. Queries take a snapshot of the list, which keeps every segment in it
+// alive until the query finishes. New segments and merge results are published by swapping in a new
+// list, so neither adding documents nor merging ever blocks a query.
+//
+// Merging follows a tiered policy: a segment's tier is floor(log_mergeFactor(documents)), and whenever
+// one tier holds mergeFactor segments they are merged into one segment of the next tier on a background
+// thread. Tiers alone would still let up to mergeFactor - 1 segments pile up in every tier, so a final
+// tier caps the list: beyond maxSegments live segments, the smallest are merged into one whatever their
+// tiers, and a query never fans out to more than maxSegments segments once merges catch up.
+// Postings of deleted documents are dropped while merging, so deletions are reclaimed over time.
+class SegmentSet {
+public:
+    using List = std::vector<std::shared_ptr<const Segment>>;
+
+private:
+    std::shared_ptr<const List> live = std::make_shared<const List>();  // Read with std::atomic_load
+    std::mutex publishLock;  // Serializes adds and merge results
+    std::string manifestPath;  // File listing the live segments
+    std::string directory;  // Directory the segment files live in
+    size_t nextId = 0;  // Number used for the next segment's file prefix
+    size_t mergeFactor;  // Segments per tier that trigger a merge
+    size_t maxSegments;  // Live segments beyond which the smallest are merged regardless of tier
+    std::function<LiveDocs::Snapshot()> liveDocs;  // Supplies the deleted documents to purge; may be empty
+
+    std::thread merger;  // Background merge thread, started on first use
+    std::mutex wakeLock;  // Guards the flags below
+    std::condition_variable wake;  // Signals the merge thread
+    bool mergeRequested = false;  // A publication may have filled a tier
+    bool stopping = false;  // Set by the destructor
+    bool merging = false;  // The merge thread is working on a tier
+    std::exception_ptr mergeError;  // First merge failure not yet reported by waitForMerges
+
+    // Writes the manifest for a list: next segment number, segment count, then (prefix, documents) per
+    // segment, all as little-endian 64-bit fields. Written to a temporary file and renamed, so a crash
+    // never leaves a torn manifest.
+    void saveManifest(const List& list) const {
+        std::string temporary = manifestPath + ".tmp";
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            BinaryWriter out(file);
+            out.writeFixed<uint64_t>(nextId);
+            out.writeFixed<uint64_t>(list.size());
+            for (const auto& segment : list) {
+                out.writeString(segment->filePrefix());
+                out.writeFixed<uint64_t>(segment->documentCount());
+            }
+            out.flush();
+            if (!file) throw std::runtime_error("Cannot write segment manifest " + temporary);
+        }
+        std::rename(temporary.c_str(), manifestPath.c_str());
+    }
+
+    // Finds a tier holding at least mergeFactor segments or, failing that, the smallest segments to merge
+    // to bring the list down to maxSegments; returns an empty list if neither applies
+    List pickMerge(const List& list) const {
+        std::vector<std::pair<size_t, std::shared_ptr<const Segment>>> tiered;
+        for (const auto& segment : list) {
+            size_t tier = 0;
+            for (size_t size = std::max<size_t>(1, segment->documentCount()); size >= mergeFactor; size /= mergeFactor) {
+                tier++;
+            }
+            tiered.emplace_back(tier, segment);
+        }
+        std::stable_sort(tiered.begin(), tiered.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+        for (size_t start = 0; start < tiered.size();) {
+            size_t end = start;
+            while (end < tiered.size() && tiered[end].first == tiered[start].first) end++;
+            if (end - start >= mergeFactor) {
+                List picked;
+                for (size_t i = start; i < start + mergeFactor; i++) picked.push_back(tiered[i].second);
+                return picked;
+            }
+            start = end;
+        }
+        if (list.size() > maxSegments) {  // Final tier: the fewest, smallest segments that reach the cap
+            std::stable_sort(tiered.begin(), tiered.end(), [](const auto& a, const auto& b) {
+                return a.second->documentCount() < b.second->documentCount();
+            });
+            List picked;
+            for (size_t i = 0; i < list.size() - maxSegments + 1; i++) picked.push_back(tiered[i].second);
+            return picked;
+        }
+        return List();
+    }
+
+    // Merges one full tier, if any, and publishes the result. Returns false when nothing was merged.
+    bool mergeOnce() {
+        List inputs = pickMerge(*snapshot());
+        if (inputs.empty()) return false;
+
+        std::string prefix = reservePrefix();
+        size_t documents = 0;
+        for (const auto& segment : inputs) documents += segment->documentCount();
+        auto unite = [](const std::shared_ptr<PostingList>& a, const std::shared_ptr<PostingList>& b) {
+            return std::make_shared<PostingList>(PostingList::unite(*a, *b));
+        };
+        LiveDocs::Snapshot deleted = liveDocs ? liveDocs() : LiveDocs::Snapshot();
+        auto purge = [&](std::shared_ptr<PostingList>& files) {
+            if (!deleted.hasDeletions()) return true;
+            files = std::make_shared<PostingList>(PostingList::filter(*files, [&](uint32_t doc) { return deleted.isLive(doc); }));
+            return !files->empty();  // Drop terms that only occurred in deleted documents
+        };
+        std::shared_ptr<const Segment> merged;
+        try {
+            for (int f = 0; f < Segment::FieldCount; f++) {
+                std::vector<std::string> runs;
+                for (const auto& segment : inputs) runs.push_back(segment->filePrefix() + Segment::suffix(static_cast<Segment::Field>(f)));
+                mergeTreeFiles<std::shared_ptr<PostingList>>(runs, prefix + Segment::suffix(static_cast<Segment::Field>(f)), unite, purge);
+            }
+            merged = std::make_shared<const Segment>(prefix, documents);  // Built while queries keep running
+        } catch (...) {
+            Segment::removeFiles(prefix);  // Leave no partial output behind
+            throw;
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(publishLock);
+            auto next = std::make_shared<List>();
+            for (const auto& segment : *snapshot()) {
+                if (std::find(inputs.begin(), inputs.end(), segment) == inputs.end()) next->push_back(segment);
+            }
+            next->push_back(merged);
+            saveManifest(*next);
+            std::atomic_store(&live, std::shared_ptr<const List>(std::move(next)));
+        }
+        for (const auto& segment : inputs) segment->removeFiles();  // Queries still holding them use memory only
+        return true;
+    }
+
+    // Body of the background merge thread
+    void mergeLoop() {
+        std::unique_lock<std::mutex> lock(wakeLock);
+        while (true) {
+            wake.wait(lock, [&] { return mergeRequested || stopping; });
+            if (stopping) return;
+            mergeRequested = false;
+            merging = true;
+            lock.unlock();
+            std::exception_ptr error;
+            try {
+                while (mergeOnce()) {}  // A merge can fill the next tier up
+            } catch (const std::exception& e) {
+                // The inputs stay live and the next publication retries the merge
+                std::cerr << "Segment merge failed: " << e.what() << "\n";
+                error = std::current_exception();
+            }
+            lock.lock();
+            if (error && !mergeError) mergeError = error;
+            merging = false;
+            wake.notify_all();
+        }
+    }
+
+public:
+    explicit SegmentSet(size_t factor = 8, size_t cap = 16)
+        : mergeFactor(std::max<size_t>(2, factor)), maxSegments(std::max<size_t>(1, cap)) {}
+
+    SegmentSet(const SegmentSet&) = delete;
+    SegmentSet& operator=(const SegmentSet&) = delete;
+
+    // Stops the merge thread; an in-flight merge finishes first
+    ~SegmentSet() {
+        {
+            std::lock_guard<std::mutex> guard(wakeLock);
+            stopping = true;
+        }
+        wake.notify_all();
+        if (merger.joinable()) merger.join();
+    }
+
+    // Sets the source of deleted documents to purge while merging
+    void setLiveDocs(std::function<LiveDocs::Snapshot()> source) { liveDocs = std::move(source); }
+
+    // Opens the segments listed in a manifest. A missing manifest means no segments. With discard set,
+    // the listed segments are deleted instead (the base index was rebuilt and already covers them), so
+    // a damaged manifest only stops the cleanup; otherwise it is an error.
+    void open(const std::string& manifest, bool discard) {
+        manifestPath = manifest;
+        size_t slash = manifest.find_last_of("/\\");
+        directory = slash == std::string::npos ? std::string() : manifest.substr(0, slash + 1);
+
+        auto list = std::make_shared<List>();
+        std::ifstream file(manifest, std::ios::binary | std::ios::ate);
+        if (file) {
+            std::vector<char> image(static_cast<size_t>(file.tellg()));  // Whole file, so lengths are checked against it
+            file.seekg(0);
+            file.read(image.data(), image.size());
+            BinaryReader in(image.data(), file ? image.size() : 0);
+            nextId = static_cast<size_t>(in.readFixed<uint64_t>());
+            uint64_t count = in.readFixed<uint64_t>();
+            bool intact = in && count <= image.size() / 16;  // Every segment takes at least 16 bytes
+            for (uint64_t i = 0; intact && i < count; i++) {
+                std::string prefix = in.readString();
+                uint64_t documents = in.readFixed<uint64_t>();
+                intact = static_cast<bool>(in);
+                if (!intact) break;
+                if (discard) Segment::removeFiles(prefix);
+                else list->push_back(std::make_shared<const Segment>(prefix, static_cast<size_t>(documents)));
+            }
+            if (!intact && !discard) throw std::runtime_error("Corrupt segment manifest " + manifest);
+        }
+        std::lock_guard<std::mutex> guard(publishLock);
+        if (discard) saveManifest(*list);
+        std::atomic_store(&live, std::shared_ptr<const List>(std::move(list)));
+    }
+
+    // Live segments at this instant; the caller's copy stays valid however the set changes afterwards
+    std::shared_ptr<const List> snapshot() const { return std::atomic_load(&live); }
+
+    // Reserves a file prefix for a new segment
+    std::string reservePrefix() {
+        std::lock_guard<std::mutex> guard(publishLock);
+        return directory + "seg" + std::to_string(nextId++);
+    }
+
+    // Publishes a newly built segment and schedules a merge check
+    void add(std::shared_ptr<const Segment> segment) {
+        {
+            std::lock_guard<std::mutex> guard(publishLock);
+            auto next = std::make_shared<List>(*snapshot());
+            next->push_back(std::move(segment));
+            saveManifest(*next);
+            std::atomic_store(&live, std::shared_ptr<const List>(std::move(next)));
+        }
+        std::lock_guard<std::mutex> guard(wakeLock);
+        if (!merger.joinable()) merger = std::thread(&SegmentSet::mergeLoop, this);
+        mergeRequested = true;
+        wake.notify_all();
+    }
+
+    // Blocks until no merge is running or pending, then rethrows the first merge failure since the last call
+    void waitForMerges() {
+        std::unique_lock<std::mutex> lock(wakeLock);
+        wake.wait(lock, [&] { return !mergeRequested && !merging; });
+        if (mergeError) std::rethrow_exception(std::exchange(mergeError, nullptr));
+    }
+};
+
+#endif  // End of include guard
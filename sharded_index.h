@@ -0,0 +1,225 @@
+// sharded_index.h
+#ifndef SHARDED_INDEX_H  // Include guard to prevent multiple inclusions of this header file
+#define SHARDED_INDEX_H
+
+#include "avl_tree.h"  // Each shard is an ordinary AVLTree
+#include "run_merger.h"  // For writing the merged shards in the tree file format
+#include <algorithm>  // For moving decoded nodes into each shard's arena
+#include <atomic>  // For handing out chunks and shards to loading threads
+#include <exception>  // For reporting errors from loading threads
+#include <fstream>  // For reading the tree file
+#include <functional>  // For std::hash routing of keys to shards
+#include <iterator>  // For appending to the shard arenas
+#include <memory>  // For owning the (immovable) shards
+#include <mutex>  // For the per-shard writer lock
+#include <queue>  // For the k-way merge heap
+#include <stdexcept>  // For reporting unreadable files
+#include <string>  // For string keys
+#include <thread>  // For loading shards in parallel
+#include <utility>  // For std::pair and std::move
+#include <vector>  // For the shard table and k-way merge cursors
+
+// A term dictionary split into N AVLTrees by key hash. Writers lock only the shard a key routes to,
+// so threads indexing different terms rarely contend. Reads never lock: they are safe alongside
+// writers when the index is persistent, and otherwise must not overlap writes (as with AVLTree).
+template<typename T>
+class ShardedIndex {
+private:
+    struct alignas(64) Shard {  // Own cache line for the lock so neighbouring shards do not false-share
+        std::mutex lock;  // Serializes writers of this shard
+        AVLTree<T> tree;  // Keys that hash to this shard
+    };
+
+    std::vector<std::unique_ptr<Shard>> shards;  // Fixed at construction; keys never move between shards
+
+    // Routes a key to the shard that owns it
+    Shard& shardFor(const std::string& key) const {
+        return *shards[std::hash<std::string>()(key) % shards.size()];
+    }
+
+    // Runs job(i) for every i in [0, jobs) on up to threads threads, the calling thread included, and
+    // rethrows the first exception a job threw
+    template<typename Job>
+    static void parallelFor(size_t threads, size_t jobs, Job job) {
+        std::atomic<size_t> next{0};
+        std::atomic<bool> failed{false};
+        std::exception_ptr error;
+        std::mutex errorLock;
+        auto work = [&]() {
+            try {
+                for (size_t i = next++; i < jobs && !failed; i = next++) job(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> guard(errorLock);
+                if (!error) error = std::current_exception();
+                failed = true;
+            }
+        };
+        std::vector<std::thread> workers;
+        for (size_t t = 1; t < std::min(threads, jobs); t++) workers.emplace_back(work);
+        work();
+        for (auto& worker : workers) worker.join();
+        if (error) std::rethrow_exception(error);
+    }
+
+public:
+    // Creates an index with the given number of shards (at least one)
+    explicit ShardedIndex(size_t shardCount = 1) {
+        if (shardCount == 0) shardCount = 1;
+        shards.reserve(shardCount);
+        for (size_t i = 0; i < shardCount; i++) {
+            shards.push_back(std::make_unique<Shard>());
+        }
+    }
+
+    // Number of shards keys are spread over
+    size_t shardCount() const { return shards.size(); }
+
+    // Removes every key from every shard
+    void clear() {
+        for (auto& shard : shards) {
+            std::lock_guard<std::mutex> guard(shard->lock);
+            shard->tree.bulkLoad(std::vector<std::pair<std::string, T>>());
+        }
+    }
+
+    // Switches every shard between in-place and path-copying updates
+    void setPersistent(bool enabled) {
+        for (auto& shard : shards) shard->tree.setPersistent(enabled);
+    }
+
+    // Atomically replaces the value under key with update(current), where current is nullptr if the key
+    // is absent. An unchanged value (say, the same pointer to a list updated in place) is not written
+    // back, so a persistent shard is not path-copied for it. Safe to call from many threads at once.
+    template<typename Update>
+    void update(const std::string& key, Update&& update) {
+        Shard& shard = shardFor(key);
+        std::lock_guard<std::mutex> guard(shard.lock);
+        T current;
+        bool found = shard.tree.find(key, current);
+        T next = update(found ? &current : nullptr);
+        if (!found || !(next == current)) shard.tree.insert(key, std::move(next));
+    }
+
+    // Inserts or replaces a value. Safe to call from many threads at once.
+    void insert(const std::string& key, const T& value) {
+        Shard& shard = shardFor(key);
+        std::lock_guard<std::mutex> guard(shard.lock);
+        shard.tree.insert(key, value);
+    }
+
+    // Copies the value stored under a key; returns false if the key is absent
+    bool find(const std::string& key, T& value) const {
+        return shardFor(key).tree.find(key, value);
+    }
+
+    // Calls visit(node) for every key starting with prefix in ascending key order, merging the shards'
+    // ranges. Stops early when visit returns false.
+    template<typename Visit>
+    void forEachWithPrefix(const std::string& prefix, Visit&& visit) const {
+        using Snapshot = typename AVLTree<T>::Snapshot;
+        using Iterator = typename AVLTree<T>::const_iterator;
+
+        std::vector<Snapshot> snapshots;  // One pinned version per shard for the whole walk
+        std::vector<std::pair<Iterator, Iterator>> cursors;
+        snapshots.reserve(shards.size());
+        cursors.reserve(shards.size());
+        for (const auto& shard : shards) {
+            snapshots.push_back(shard->tree.snapshot());
+            auto range = snapshots.back().range(prefix);
+            if (range.begin() != range.end()) cursors.emplace_back(range.begin(), range.end());
+        }
+
+        // Min-heap of shard cursors ordered by their current key
+        auto greater = [&](size_t a, size_t b) { return cursors[a].first->key > cursors[b].first->key; };
+        std::priority_queue<size_t, std::vector<size_t>, decltype(greater)> heap(greater);
+        for (size_t i = 0; i < cursors.size(); i++) heap.push(i);
+        while (!heap.empty()) {
+            size_t smallest = heap.top();  // Shard cursor holding the next key in sorted order
+            heap.pop();
+            if (!visit(*cursors[smallest].first)) return;
+            if (++cursors[smallest].first != cursors[smallest].second) heap.push(smallest);  // Else this shard has no more matches
+        }
+    }
+
+    // Passes every value through keep(value), which may rewrite it and returns false to drop the key, and
+    // bulk loads each shard with the result in turn. Writers of a shard wait while it is rebuilt.
+    template<typename Keep>
+    void rewrite(Keep keep) {
+        for (auto& shard : shards) {
+            std::lock_guard<std::mutex> guard(shard->lock);
+            std::vector<AVLNode<T>> nodes;
+            for (const auto& node : shard->tree) {
+                T value = node.value;
+                if (keep(value)) nodes.emplace_back(node.key, value);
+            }
+            shard->tree.bulkLoad(std::move(nodes));
+        }
+    }
+
+    // Saves all shards as a single tree file, so the on-disk format does not depend on the shard count.
+    // Entries are merged from the shards straight into the file, in key order.
+    void saveToFile(const std::string& filename) const {
+        TreeFileWriter<T> writer(filename);
+        forEachWithPrefix("", [&](const AVLNode<T>& node) {
+            writer.write(node.key, node.value);
+            return true;
+        });
+        writer.finish();
+    }
+
+    // Loads a tree file, decoding each entry straight into the node arena of the shard its key routes to.
+    // With a chunk table, chunks are decoded on up to threads threads and the shards are then linked in parallel.
+    void loadFromFile(const std::string& filename, size_t threads = std::thread::hardware_concurrency()) {
+        std::ifstream file(filename, std::ios::binary | std::ios::ate);
+        if (!file) throw std::runtime_error("ShardedIndex: cannot read " + filename);
+        std::vector<char> image(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(image.data(), image.size());  // One read for the whole file
+        if (!file) throw std::runtime_error("ShardedIndex: cannot read " + filename);
+
+        BinaryReader header(image.data(), image.size());
+        uint64_t count = header.readFixed<uint64_t>();
+        if (!header || count > image.size()) throw std::runtime_error("ShardedIndex: truncated index file " + filename);
+        std::vector<uint64_t> chunkOffsets;
+        uint64_t chunkEntries = 0, tableStart = 0;
+        if (threads <= 1 || count <= treeFileChunkEntries ||
+            !TreeFileChunks::read(image.data(), image.size(), count, chunkOffsets, chunkEntries, tableStart)) {
+            chunkOffsets.assign(1, sizeof(uint64_t));  // Everything as one chunk, decoded on this thread
+            chunkEntries = count;
+            tableStart = image.size();
+        }
+
+        // parts[chunk][shard] holds a chunk's entries for one shard, still in key order
+        using Nodes = std::vector<AVLNode<T>>;
+        std::vector<std::vector<Nodes>> parts(chunkOffsets.size(), std::vector<Nodes>(shards.size()));
+        std::atomic<bool> truncated{false};
+        parallelFor(threads, chunkOffsets.size(), [&](size_t c) {
+            uint64_t stop = c + 1 < chunkOffsets.size() ? chunkOffsets[c + 1] : tableStart;
+            BinaryReader in(image.data() + chunkOffsets[c], static_cast<size_t>(stop - chunkOffsets[c]));
+            uint64_t last = std::min<uint64_t>(count, (c + 1) * chunkEntries);
+            for (uint64_t i = c * chunkEntries; i < last && in; i++) {
+                std::string key = in.readString();
+                Nodes& part = parts[c][std::hash<std::string>()(key) % shards.size()];
+                part.emplace_back(std::string(), T());
+                part.back().key = std::move(key);
+                part.back().load(in);  // Read the value in place
+            }
+            if (!in) truncated = true;
+        });
+        if (truncated) throw std::runtime_error("ShardedIndex: truncated index file " + filename);
+
+        parallelFor(threads, shards.size(), [&](size_t s) {
+            Nodes nodes = std::move(parts[0][s]);  // With one chunk, the shard's arena is used as decoded
+            size_t total = nodes.size();
+            for (size_t c = 1; c < parts.size(); c++) total += parts[c][s].size();
+            nodes.reserve(total);
+            for (size_t c = 1; c < parts.size(); c++) {
+                std::move(parts[c][s].begin(), parts[c][s].end(), std::back_inserter(nodes));
+            }
+            std::lock_guard<std::mutex> guard(shards[s]->lock);
+            shards[s]->tree.bulkLoad(std::move(nodes));
+        });
+    }
+};
+
+#endif  // End of include guard
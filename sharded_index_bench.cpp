@@ -0,0 +1,106 @@
+// sharded_index_bench.cpp
+// Measures how indexing throughput scales with thread count for a sharded versus unsharded dictionary.
+// Each association goes through the same update as WordMap::associate: in build mode the term's
+// PostingList is appended to in place, in live mode (queries may be reading) it is appended into a
+// spare slot and published, and copied only when it runs out of room.
+// Usage: sharded_index_bench [term occurrences]
+#include "posting_list.h" // The posting lists updated in place
+#include "sharded_index.h" // The sharded dictionary under test
+#include <algorithm> // For the doubling room of live lists
+#include <atomic> // For starting all threads together
+#include <chrono> // For timing each run
+#include <cmath> // For building the Zipf distribution
+#include <iomanip> // For formatting the results table
+#include <iostream> // For printing results
+#include <memory> // For the shared posting lists
+#include <random> // For the seeded term and document generator
+#include <string> // For term keys
+#include <thread> // For the ingest threads
+#include <vector> // For the vocabulary and workloads
+
+using Index = ShardedIndex<std::shared_ptr<PostingList>>;
+
+static constexpr size_t tokensPerDocument = 200; // About 200 terms per article, some repeated
+
+struct Association {
+    std::string term; // Term key
+    uint32_t docId; // Document the term occurs in
+    int occurrences; // Times it occurs there
+};
+
+// Builds a deterministic workload of Zipf-distributed terms, tokensPerDocument per document, added once
+// per (term, document) with their count as indexFile adds them. Returns one list per document.
+static std::vector<std::vector<Association>> makeWorkload(size_t tokens, size_t vocabulary) {
+    std::vector<double> weights(vocabulary);
+    for (size_t rank = 0; rank < vocabulary; rank++) {
+        weights[rank] = 1.0 / static_cast<double>(rank + 1); // Zipf exponent 1, like natural language
+    }
+    std::discrete_distribution<size_t> pickTerm(weights.begin(), weights.end());
+    std::mt19937_64 rng(42);
+
+    std::vector<std::vector<Association>> documents((tokens + tokensPerDocument - 1) / tokensPerDocument);
+    for (size_t doc = 0; doc < documents.size(); doc++) {
+        std::vector<size_t> ranks(std::min(tokensPerDocument, tokens - doc * tokensPerDocument));
+        for (auto& rank : ranks) rank = pickTerm(rng);
+        std::sort(ranks.begin(), ranks.end());
+        for (size_t i = 0; i < ranks.size();) {
+            size_t run = i;
+            while (run < ranks.size() && ranks[run] == ranks[i]) run++;
+            documents[doc].push_back({"term" + std::to_string(ranks[i]), static_cast<uint32_t>(doc), static_cast<int>(run - i)});
+            i = run;
+        }
+    }
+    return documents;
+}
+
+// Inserts the workload with the given number of threads, each indexing whole documents as the build
+// does, and returns the elapsed seconds
+static double run(const std::vector<std::vector<Association>>& documents, size_t threads, size_t shards, bool live) {
+    Index index(shards);
+    index.setPersistent(live);
+    std::atomic<bool> go{false};
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; t++) {
+        workers.emplace_back([&, t]() {
+            while (!go) std::this_thread::yield(); // Start every thread at once
+            for (size_t doc = t; doc < documents.size(); doc += threads) { // Interleaved slice of the documents
+                for (const auto& [term, docId, occurrences] : documents[doc]) {
+                    index.update(term, [&](const std::shared_ptr<PostingList>* files) {
+                        if (files && *files && !live) { // As WordMap::associate: build mode updates in place
+                            (*files)->add(docId, occurrences);
+                            return *files;
+                        }
+                        if (files && *files && (*files)->appendInPlace(docId, occurrences)) return *files;
+                        auto updated = files && *files ? std::make_shared<PostingList>(**files) : std::make_shared<PostingList>();
+                        updated->reserveAppends(std::max<size_t>(updated->size() + 1, 4));
+                        if (!updated->appendInPlace(docId, occurrences)) updated->add(docId, occurrences);
+                        return updated;
+                    });
+                }
+            }
+        });
+    }
+    auto start = std::chrono::steady_clock::now();
+    go = true;
+    for (auto& worker : workers) worker.join();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+int main(int argc, char* argv[]) {
+    size_t associations = argc > 1 ? std::stoul(argv[1]) : 400000; // Term occurrences
+    auto workload = makeWorkload(associations, 50000);
+
+    std::cout << "mode,threads,shards,associations,seconds,assoc_per_sec\n"; // CSV so runs can be diffed and plotted
+    for (bool live : {false, true}) {
+        for (size_t shards : {size_t(1), size_t(64)}) {
+            for (size_t threads : {1, 2, 4, 8, 16, 32}) {
+                double seconds = run(workload, threads, shards, live);
+                std::cout << (live ? "live" : "build") << "," << threads << "," << shards << "," << associations << ","
+                          << std::fixed << std::setprecision(4) << seconds << ","
+                          << std::setprecision(0) << associations / seconds << "\n";
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,312 @@
+// supersearch_bench.cpp
+// Microbenchmarks for the hot paths of indexing and querying, each measured in isolation:
+// AVLTree insert/find on a realistic vocabulary, TextProcessor stem/processWord, SearchEngine::parse,
+// unordered_map (de)serialization (the old saveMap/loadMap), tree file save/load, and posting list
+// intersect/unite/subtract. Results are printed as CSV (default) or JSON so runs can be stored and
+// diffed across releases.
+// Usage: supersearch_bench [--json] [name-filter]
+#include "avl_tree.h" // The term dictionary under test
+#include "binary_io.h" // The serializers under test
+#include "posting_list.h" // The posting lists under test
+#include "searchEngine.h" // Query parsing under test
+#include "text_processor.h" // Stemming under test
+#include <algorithm> // For shuffling and sorting generated words
+#include <chrono> // For timing each benchmark
+#include <cmath> // For building the Zipf distribution
+#include <filesystem> // For the scratch directory
+#include <iostream> // For printing results
+#include <memory> // For shared posting lists
+#include <random> // For the seeded vocabulary and workload generators
+#include <sstream> // For in-memory serialization
+#include <string> // For terms and benchmark names
+#include <unordered_map> // For the serialized maps
+#include <unordered_set> // For parsed query terms
+#include <vector> // For vocabularies and workloads
+
+namespace fs = std::filesystem;
+
+// One measured benchmark
+struct Result {
+    std::string name; // Benchmark name, stable across releases
+    size_t size; // Problem size (vocabulary, list length, ...)
+    double nsPerOp; // Mean nanoseconds per operation
+};
+
+// Runs fn (which performs opsPerCall operations and returns a value to keep alive) repeatedly for a
+// fixed time budget and returns nanoseconds per operation
+template<typename Fn>
+static double timePerOp(size_t opsPerCall, Fn&& fn) {
+    size_t calls = 0;
+    volatile size_t sink = 0; // Keeps results alive so the work is not optimized away
+    auto start = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed{};
+    do {
+        sink = sink + fn();
+        calls++;
+        elapsed = std::chrono::steady_clock::now() - start;
+    } while (elapsed.count() < 0.2 || calls < 3);
+    return elapsed.count() * 1e9 / (static_cast<double>(calls) * opsPerCall);
+}
+
+// Builds a deterministic vocabulary of English-looking words with inflected endings, so the stemmer
+// and the dictionary see key lengths and shared prefixes like those of news text
+static std::vector<std::string> makeVocabulary(size_t count, std::mt19937_64& rng) {
+    static const char* onsets[] = {"b", "c", "d", "f", "g", "h", "l", "m", "n", "p", "r", "s", "t", "v", "st", "tr", "pr", "gr", "ch", "sh"};
+    static const char* vowels[] = {"a", "e", "i", "o", "u", "ea", "ou", "io"};
+    static const char* codas[] = {"", "n", "r", "t", "s", "l", "nd", "st", "ck", "m"};
+    static const char* endings[] = {"", "", "", "s", "ed", "ing", "ation", "ness", "ly", "er", "ies", "ment"};
+    std::unordered_map<std::string, bool> seen;
+    std::vector<std::string> words;
+    while (words.size() < count) {
+        std::string word;
+        size_t syllables = 1 + rng() % 3;
+        for (size_t s = 0; s < syllables; s++) {
+            word += onsets[rng() % 20];
+            word += vowels[rng() % 8];
+            word += codas[rng() % 10];
+        }
+        word += endings[rng() % 12];
+        if (seen.emplace(word, true).second) words.push_back(std::move(word));
+    }
+    return words;
+}
+
+// Draws `count` words from the vocabulary with Zipf-distributed ranks (exponent 1, like natural language)
+static std::vector<std::string> zipfSample(const std::vector<std::string>& vocabulary, size_t count, std::mt19937_64& rng) {
+    std::vector<double> weights(vocabulary.size());
+    for (size_t rank = 0; rank < weights.size(); rank++) weights[rank] = 1.0 / static_cast<double>(rank + 1);
+    std::discrete_distribution<size_t> pick(weights.begin(), weights.end());
+    std::vector<std::string> sample;
+    sample.reserve(count);
+    for (size_t i = 0; i < count; i++) sample.push_back(vocabulary[pick(rng)]);
+    return sample;
+}
+
+// Builds a list of `size` distinct random documents below `universe`
+static PostingList makeList(size_t size, uint32_t universe, std::mt19937_64& rng) {
+    std::vector<char> taken(universe, 0);
+    std::vector<uint32_t> docs;
+    std::uniform_int_distribution<uint32_t> pick(0, universe - 1);
+    while (docs.size() < size) {
+        uint32_t doc = pick(rng);
+        if (!taken[doc]) {
+            taken[doc] = 1;
+            docs.push_back(doc);
+        }
+    }
+    std::sort(docs.begin(), docs.end());
+    PostingList list;
+    for (uint32_t doc : docs) list.add(doc, 1 + doc % 3);
+    return list;
+}
+
+// Reaches the private query parser, which has no public entry point that does not also look up postings
+struct SearchEngineBench {
+    static std::unordered_set<std::string> parse(const SearchEngine& engine, const std::string& query) {
+        return engine.parse(query);
+    }
+};
+
+int main(int argc, char* argv[]) {
+    bool json = false;
+    std::string filter;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--json") {
+            json = true;
+        } else if (arg.rfind("--", 0) == 0 || !filter.empty()) { // --help, unknown options, a second filter
+            std::cerr << "Usage: " << argv[0] << " [--json] [name-filter]\n"
+                      << "Runs the benchmarks whose names contain name-filter (all by default) and prints\n"
+                      << "name, size and ns/op as CSV, or as JSON with --json.\n";
+            return arg == "--help" ? 0 : 1;
+        } else {
+            filter = arg;
+        }
+    }
+
+    std::vector<Result> results;
+    auto wanted = [&](const std::string& name) { return filter.empty() || name.find(filter) != std::string::npos; };
+    auto record = [&](const std::string& name, size_t size, double nsPerOp) {
+        results.push_back({name, size, nsPerOp});
+        std::cerr << name << " (" << size << "): " << nsPerOp << " ns/op\n"; // Progress; results go to stdout
+    };
+
+    std::mt19937_64 rng(42);
+    const size_t vocabularySize = 50000;
+    std::vector<std::string> vocabulary = makeVocabulary(vocabularySize, rng);
+    std::vector<std::string> tokens = zipfSample(vocabulary, 100000, rng);
+    std::vector<std::string> misses = makeVocabulary(vocabularySize + 10000, rng);
+    misses.erase(misses.begin(), misses.begin() + vocabularySize); // Mostly words the tree does not hold
+
+    // AVLTree: insert every vocabulary word in random order, then look up Zipf-distributed tokens
+    if (wanted("avl_insert")) {
+        std::vector<std::string> shuffled = vocabulary;
+        std::shuffle(shuffled.begin(), shuffled.end(), rng);
+        record("avl_insert", vocabularySize, timePerOp(shuffled.size(), [&]() {
+            AVLTree<int> tree;
+            for (const auto& word : shuffled) tree.insert(word, 1);
+            return static_cast<size_t>(tree.begin() != tree.end());
+        }));
+    }
+    AVLTree<int> dictionary;
+    for (const auto& word : vocabulary) dictionary.insert(word, 1);
+    if (wanted("avl_find_hit")) {
+        record("avl_find_hit", vocabularySize, timePerOp(tokens.size(), [&]() {
+            size_t found = 0;
+            int value;
+            for (const auto& token : tokens) found += dictionary.find(token, value);
+            return found;
+        }));
+    }
+    if (wanted("avl_find_miss")) {
+        record("avl_find_miss", vocabularySize, timePerOp(misses.size(), [&]() {
+            size_t found = 0;
+            int value;
+            for (const auto& word : misses) found += dictionary.find(word, value);
+            return found;
+        }));
+    }
+
+    // TextProcessor: stem alone, and the full per-word path (stopwords, cleanup, stemming)
+    TextProcessor textProcessor;
+    if (wanted("text_stem")) {
+        record("text_stem", tokens.size(), timePerOp(tokens.size(), [&]() {
+            size_t length = 0;
+            for (const auto& token : tokens) length += textProcessor.stem(token).size();
+            return length;
+        }));
+    }
+    if (wanted("text_process_word")) {
+        record("text_process_word", tokens.size(), timePerOp(tokens.size(), [&]() {
+            size_t length = 0;
+            for (const auto& token : tokens) length += textProcessor.processWord(token).size();
+            return length;
+        }));
+    }
+
+    // SearchEngine::parse on mixed queries, using an empty index in a scratch directory
+    if (wanted("engine_parse")) {
+        fs::path scratch = fs::temp_directory_path() / ("supersearch_bench_" + std::to_string(rng()));
+        fs::create_directories(scratch);
+        std::vector<std::string> queries;
+        for (size_t i = 0; i < 1000; i++) {
+            queries.push_back(tokens[i * 5] + " " + tokens[i * 5 + 1] + " -" + tokens[i * 5 + 2] + " org:" +
+                              tokens[i * 5 + 3] + " " + tokens[i * 5 + 4].substr(0, 3) + "*");
+        }
+        {
+            std::streambuf* console = std::cout.rdbuf(nullptr); // The constructor reports its progress
+            SearchEngine engine(scratch.string(), (scratch / "index.dat").string(), (scratch / "org.dat").string(),
+                                (scratch / "name.dat").string(), (scratch / "word.dat").string(),
+                                (scratch / "freq.dat").string());
+            std::cout.rdbuf(console);
+            record("engine_parse", queries.size(), timePerOp(queries.size(), [&]() {
+                size_t terms = 0;
+                for (const auto& query : queries) terms += SearchEngineBench::parse(engine, query).size();
+                return terms;
+            }));
+        }
+        fs::remove_all(scratch);
+    }
+
+    // Map (de)serialization: the per-term maps once written with saveMap/loadMap, now Serializer<unordered_map>
+    std::unordered_map<std::string, int> map;
+    for (size_t i = 0; i < 10000; i++) map[vocabulary[i]] = static_cast<int>(i);
+    std::string encoded;
+    {
+        std::ostringstream out;
+        BinaryWriter writer(out);
+        Serializer<std::unordered_map<std::string, int>>::write(writer, map);
+        writer.flush();
+        encoded = out.str();
+    }
+    if (wanted("map_save")) {
+        record("map_save", map.size(), timePerOp(map.size(), [&]() {
+            std::ostringstream out;
+            BinaryWriter writer(out);
+            Serializer<std::unordered_map<std::string, int>>::write(writer, map);
+            writer.flush();
+            return static_cast<size_t>(out.tellp());
+        }));
+    }
+    if (wanted("map_load")) {
+        record("map_load", map.size(), timePerOp(map.size(), [&]() {
+            std::istringstream in(encoded);
+            BinaryReader reader(in);
+            std::unordered_map<std::string, int> loaded;
+            Serializer<std::unordered_map<std::string, int>>::read(reader, loaded);
+            return loaded.size();
+        }));
+    }
+
+    // Index file I/O: a posting tree written and read the way the field indexes are
+    if (wanted("tree_save") || wanted("tree_load")) {
+        std::vector<std::pair<std::string, std::shared_ptr<PostingList>>> entries;
+        std::vector<std::string> sorted = vocabulary;
+        std::sort(sorted.begin(), sorted.end());
+        for (size_t rank = 0; rank < sorted.size(); rank++) {
+            auto list = std::make_shared<PostingList>();
+            size_t documents = 1 + 20000 / (1 + rng() % 2000); // Most terms are rare, a few are common
+            for (uint32_t doc = 0; list->size() < documents; doc += 1 + rng() % 7) list->add(doc, 1);
+            entries.emplace_back(sorted[rank], std::move(list));
+        }
+        AVLTree<std::shared_ptr<PostingList>> tree;
+        tree.bulkLoad(entries);
+        std::string file = (fs::temp_directory_path() / ("supersearch_bench_" + std::to_string(rng()) + ".dat")).string();
+        if (wanted("tree_save")) {
+            record("tree_save", entries.size(), timePerOp(entries.size(), [&]() {
+                tree.saveToFile(file);
+                return static_cast<size_t>(fs::file_size(file));
+            }));
+        }
+        tree.saveToFile(file);
+        if (wanted("tree_load")) {
+            record("tree_load", entries.size(), timePerOp(entries.size(), [&]() {
+                AVLTree<std::shared_ptr<PostingList>> loaded;
+                loaded.loadFromFile(file);
+                return static_cast<size_t>(loaded.begin() != loaded.end());
+            }));
+        }
+        fs::remove(file);
+    }
+
+    // Posting combination: a rare, a medium and a common term, in both layouts
+    const uint32_t universe = 1000000;
+    PostingList rare = makeList(100, universe, rng);
+    PostingList medium = makeList(3000, universe, rng);
+    PostingList otherMedium = makeList(3000, universe, rng);
+    PostingList common = makeList(universe / 3, universe, rng);
+    struct Pair {
+        const char* name;
+        const PostingList& a;
+        const PostingList& b;
+    };
+    for (const Pair& pair : {Pair{"rare_common", rare, common}, Pair{"medium_common", medium, common}, Pair{"medium_medium", medium, otherMedium}}) {
+        std::string suffix = std::string("_") + pair.name;
+        size_t size = pair.a.size() + pair.b.size();
+        if (wanted("posting_intersect" + suffix)) {
+            record("posting_intersect" + suffix, size, timePerOp(1, [&]() { return PostingList::intersect(pair.a, pair.b).size(); }));
+        }
+        if (wanted("posting_unite" + suffix)) {
+            record("posting_unite" + suffix, size, timePerOp(1, [&]() { return PostingList::unite(pair.a, pair.b).size(); }));
+        }
+        if (wanted("posting_subtract" + suffix)) {
+            record("posting_subtract" + suffix, size, timePerOp(1, [&]() { return PostingList::subtract(pair.a, pair.b).size(); }));
+        }
+    }
+
+    // Machine-readable output: CSV with a header, or a JSON array
+    if (json) {
+        std::cout << "[\n";
+        for (size_t i = 0; i < results.size(); i++) {
+            std::cout << "  {\"name\": \"" << results[i].name << "\", \"size\": " << results[i].size
+                      << ", \"ns_per_op\": " << results[i].nsPerOp << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+        }
+        std::cout << "]\n";
+    } else {
+        std::cout << "name,size,ns_per_op\n";
+        for (const auto& result : results) {
+            std::cout << result.name << "," << result.size << "," << result.nsPerOp << "\n";
+        }
+    }
+    return 0;
+}
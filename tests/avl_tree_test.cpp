@@ -0,0 +1,96 @@
+// avl_tree_test.cpp
+// A persistent tree read while it is written: readers take snapshots while one writer inserts keys in
+// random order, and every snapshot must be one complete version, i.e. exactly the first n keys inserted,
+// in order, with their values, for an n no smaller than what the writer had finished before it was taken.
+// The tree is then saved, and loading its chunks on several threads must give what one thread loads.
+// Usage: avl_tree_test <scratch directory>
+#include "check.h" // Test assertions
+#include "avl_tree.h" // The tree under test
+#include <algorithm> // For shuffling the insertion order
+#include <atomic> // For the writer's progress
+#include <cstdio> // For formatting keys
+#include <filesystem> // For the scratch directory
+#include <random> // For the seeded shuffle
+#include <string> // For keys
+#include <thread> // For the readers and the writer
+#include <vector> // For the insertion order and threads
+
+static std::string keyOf(uint32_t i) {
+    char key[16];
+    std::snprintf(key, sizeof(key), "k%06u", i);
+    return key;
+}
+
+namespace fs = std::filesystem;
+
+// Checks that a tree holds exactly keys 0..count-1, each with its own number as value
+static void checkSequence(const AVLTree<uint32_t>& tree, uint32_t count) {
+    uint32_t n = 0;
+    for (auto it = tree.begin(); it != tree.end(); ++it) {
+        CHECK(it->key == keyOf(n) && it->value == n);
+        n++;
+    }
+    CHECK(n == count);
+}
+
+int main(int argc, char* argv[]) {
+    const uint32_t keys = 20000;
+    std::vector<uint32_t> order(keys), rank(keys);  // order[r] = key inserted r-th; rank is its inverse
+    for (uint32_t i = 0; i < keys; i++) order[i] = i;
+    std::shuffle(order.begin(), order.end(), std::mt19937(42));
+    for (uint32_t r = 0; r < keys; r++) rank[order[r]] = r;
+
+    AVLTree<uint32_t> tree;
+    tree.setPersistent(true);
+    std::atomic<uint32_t> inserted{0};  // Keys the writer has finished inserting
+    std::atomic<bool> failed{false};
+    std::atomic<size_t> snapshots{0};
+
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 3; t++) {
+        readers.emplace_back([&]() {
+            while (!failed) {
+                uint32_t before = inserted.load();
+                auto snapshot = tree.snapshot();
+                uint32_t n = 0, latest = 0;
+                std::string previous;
+                for (auto it = snapshot.begin(); it != snapshot.end(); ++it) {
+                    uint32_t value = it->value;
+                    bool consistent = value < keys && it->key == keyOf(value) && (n == 0 || previous < it->key);
+                    if (!consistent) failed = true;
+                    if (!consistent) break;
+                    latest = std::max(latest, rank[value]);
+                    previous = it->key;
+                    n++;
+                }
+                if (n < before || (n > 0 && latest != n - 1)) failed = true;  // Not one whole version
+                uint32_t value = 0;
+                if (before > 0 && !snapshot.find(keyOf(order[before - 1]), value)) failed = true;
+                snapshots++;
+                if (before == keys) break;
+            }
+        });
+    }
+    for (uint32_t r = 0; r < keys; r++) {
+        tree.insert(keyOf(order[r]), order[r]);
+        inserted = r + 1;
+    }
+    for (auto& reader : readers) reader.join();
+    CHECK(!failed);
+    CHECK(snapshots >= readers.size());
+
+    checkSequence(tree, keys);
+
+    fs::path directory = argc > 1 ? fs::path(argv[1]) : fs::temp_directory_path() / "avl_tree_test";
+    fs::remove_all(directory);
+    fs::create_directories(directory);
+    std::string file = (directory / "tree.dat").string();
+    tree.saveToFile(file);  // Several chunks of treeFileChunkEntries entries, the last one partial
+    static_assert(treeFileChunkEntries * 3 < keys, "the tree must span several chunks");
+    AVLTree<uint32_t> serial, parallel;
+    serial.loadFromFile(file, 1);
+    parallel.loadFromFile(file, 4);
+    checkSequence(serial, keys);
+    checkSequence(parallel, keys);
+    return 0;
+}
@@ -0,0 +1,48 @@
+# Builds the same corpus twice, once under a 1 MB memory budget that forces postings to be flushed as
+# runs and merged, and once entirely in memory, and fails unless the two indexes are the same: equal
+# term dictionaries and document files, and equal query results.
+# Usage: cmake -DSUPERSEARCH=<exe> -DCORPUS=<generated corpus> -DWORK=<dir> -P build_budget.cmake
+function(run directory)
+    execute_process(COMMAND ${SUPERSEARCH} ${ARGN}
+                    WORKING_DIRECTORY ${directory}
+                    OUTPUT_VARIABLE text
+                    ERROR_VARIABLE text
+                    RESULT_VARIABLE result
+                    TIMEOUT 300)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "supersearch ${ARGN} in ${directory} exited with ${result}:\n${text}")
+    endif()
+    set(output "${text}" PARENT_SCOPE)
+endfunction()
+
+set(budgeted ${WORK}/budgeted)
+set(unbudgeted ${WORK}/unbudgeted)
+file(REMOVE_RECURSE ${budgeted} ${unbudgeted})
+file(COPY ${CORPUS}/ DESTINATION ${budgeted})
+file(COPY ${CORPUS}/ DESTINATION ${unbudgeted})
+
+run(${budgeted} index ${budgeted} 1 --stats-json ${WORK}/budgeted.json)
+file(READ ${WORK}/budgeted.json stats)
+if(NOT stats MATCHES "\"flush_run\": [0-9.e-]+" OR stats MATCHES "\"flush_run\": 0[,}]")
+    message(FATAL_ERROR "The 1 MB budget flushed no runs, so run merging is not exercised:\n${stats}")
+endif()
+run(${unbudgeted} index ${unbudgeted})
+
+# index.dat is left out: it records file modification times, which differ between the two copies
+foreach(file org.dat name.dat word.dat freq.dat docs.dat docs.idx)
+    file(SHA256 ${budgeted}/${file} budgetedHash)
+    file(SHA256 ${unbudgeted}/${file} unbudgetedHash)
+    if(NOT budgetedHash STREQUAL unbudgetedHash)
+        message(FATAL_ERROR "${file} differs between the budgeted and the in-memory build")
+    endif()
+endforeach()
+
+foreach(query "stock" "market -stock" "org:g*" "person:a* bank")
+    run(${budgeted} query ${query} --limit 1000000)
+    string(REGEX MATCHALL "File: [^\n]*" budgetedFound "${output}")
+    run(${unbudgeted} query ${query} --limit 1000000)
+    string(REGEX MATCHALL "File: [^\n]*" unbudgetedFound "${output}")
+    if(NOT budgetedFound OR NOT budgetedFound STREQUAL unbudgetedFound)
+        message(FATAL_ERROR "\"${query}\" finds nothing or differs between the budgeted and the in-memory build")
+    endif()
+endforeach()
@@ -0,0 +1,17 @@
+// check.h
+#ifndef CHECK_H  // Include guard to prevent multiple inclusions of this header file
+#define CHECK_H
+
+#include <cstdlib>  // For failing the test process
+#include <iostream>  // For reporting the failed condition
+
+// Fails the test with the condition and its location unless it holds
+#define CHECK(condition)                                                                      \
+    do {                                                                                      \
+        if (!(condition)) {                                                                   \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition "\n";   \
+            std::exit(1);                                                                     \
+        }                                                                                     \
+    } while (0)
+
+#endif  // End of include guard
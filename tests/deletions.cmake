@@ -0,0 +1,83 @@
+# Deletes a document from an index and fails unless queries stop finding it, deleting it again is
+# refused, compacting keeps the results, an update leaves it deleted while its file is unchanged, and
+# editing the file brings it back.
+# Usage: cmake -DSUPERSEARCH=<exe> -DCORPUS=<generated corpus> -DWORK=<dir> -P deletions.cmake
+function(run directory)
+    execute_process(COMMAND ${SUPERSEARCH} ${ARGN}
+                    WORKING_DIRECTORY ${directory}
+                    OUTPUT_VARIABLE text
+                    ERROR_VARIABLE text
+                    RESULT_VARIABLE result
+                    TIMEOUT 120)
+    set(output "${text}" PARENT_SCOPE)
+    set(status "${result}" PARENT_SCOPE)
+endfunction()
+
+# Runs supersearch and fails unless it succeeds
+function(check directory)
+    run(${directory} ${ARGN})
+    if(NOT status EQUAL 0)
+        message(FATAL_ERROR "supersearch ${ARGN} exited with ${status}:\n${output}")
+    endif()
+    set(output "${output}" PARENT_SCOPE)
+endfunction()
+
+# Sets matches to the number of documents matching "stock" and found to whether file is among them
+function(find_stock directory file)
+    check(${directory} query stock --limit 1000000)
+    string(REGEX MATCHALL "File: [^\n]*" files "${output}")
+    list(LENGTH files count)
+    list(FIND files "File: ${file}" position)
+    set(matches ${count} PARENT_SCOPE)
+    if(position EQUAL -1)
+        set(found FALSE PARENT_SCOPE)
+    else()
+        set(found TRUE PARENT_SCOPE)
+    endif()
+endfunction()
+
+set(index ${WORK}/index)
+file(REMOVE_RECURSE ${index})
+file(COPY ${CORPUS}/ DESTINATION ${index})
+check(${index} index ${index})
+check(${index} query stock --limit 1)
+if(NOT output MATCHES "File: ([^\n]*)")
+    message(FATAL_ERROR "\"stock\" matches nothing:\n${output}")
+endif()
+set(victim ${CMAKE_MATCH_1})
+find_stock(${index} ${victim})
+set(before ${matches})
+
+check(${index} delete ${victim})
+find_stock(${index} ${victim})
+math(EXPR expected "${before} - 1")
+if(found OR NOT matches EQUAL expected)
+    message(FATAL_ERROR "After deleting ${victim}, \"stock\" finds ${matches} of ${before} documents")
+endif()
+
+run(${index} delete ${victim})
+if(status EQUAL 0 OR NOT output MATCHES "Not in the index")
+    message(FATAL_ERROR "Deleting ${victim} twice was not refused:\n${output}")
+endif()
+
+check(${index} compact)
+if(NOT output MATCHES "Dropped [1-9][0-9]* postings")
+    message(FATAL_ERROR "Compacting dropped no postings of ${victim}:\n${output}")
+endif()
+find_stock(${index} ${victim})
+if(found OR NOT matches EQUAL expected)
+    message(FATAL_ERROR "After compacting, \"stock\" finds ${matches} instead of ${expected} documents")
+endif()
+
+check(${index} index ${index})
+find_stock(${index} ${victim})
+if(found)
+    message(FATAL_ERROR "An update brought back ${victim}, whose file did not change")
+endif()
+
+file(APPEND ${index}/${victim} " ")
+check(${index} index ${index})
+find_stock(${index} ${victim})
+if(NOT found OR NOT matches EQUAL before)
+    message(FATAL_ERROR "After editing ${victim}, \"stock\" finds ${matches} of ${before} documents")
+endif()
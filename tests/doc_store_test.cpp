@@ -0,0 +1,131 @@
+// doc_store_test.cpp
+// Round trip of the document store: records with newlines and other control bytes in their fields are
+// read back unchanged, after a flush and after reopening (which loads the whole offsets table at once).
+// Damaged files are then reported instead of trusted: a bad offsets table fails open, and records or
+// text blocks whose lengths point past the data file read as missing.
+// Usage: doc_store_test <scratch directory>
+#include "check.h" // Test assertions
+#include "doc_store.h" // The store under test
+#include <cstring> // For patching bytes of the stored files
+#include <filesystem> // For the scratch directory
+#include <fstream> // For damaging the stored files
+#include <stdexcept> // For the error a damaged offsets table raises
+#include <string> // For fields
+#include <vector> // For the documents written
+
+namespace fs = std::filesystem;
+
+static StoredDocument makeDocument(uint32_t docId) {
+    StoredDocument document;
+    document.title = "Title " + std::to_string(docId) + "\nsecond line\r\n";  // Newlines were the text format's weak spot
+    document.published = "2018-01-0" + std::to_string(1 + docId % 9) + "T00:00:00.000+00:00";
+    document.publication = docId % 2 ? "reuters.com" : "";
+    document.path = "./news_" + std::to_string(docId) + ".json";
+    document.organizations = {"Goldman Sachs", std::string("Null\0Byte", 9)};
+    if (docId % 3) document.persons = {"Jane Doe"};
+    document.text = std::string(docId * 97 % 5000, static_cast<char>('a' + docId % 26)) + "\nend";
+    return document;
+}
+
+static void checkDocument(const DocStore& store, uint32_t docId) {
+    StoredDocument expected = makeDocument(docId), found;
+    CHECK(store.find(docId, found));
+    CHECK(found.title == expected.title);
+    CHECK(found.published == expected.published);
+    CHECK(found.publication == expected.publication);
+    CHECK(found.path == expected.path);
+    CHECK(found.organizations == expected.organizations);
+    CHECK(found.persons == expected.persons);
+    std::string text;
+    CHECK(store.text(docId, text));
+    CHECK(text == expected.text);
+}
+
+int main(int argc, char* argv[]) {
+    fs::path directory = argc > 1 ? fs::path(argv[1]) : fs::temp_directory_path() / "doc_store_test";
+    fs::remove_all(directory);
+    fs::create_directories(directory);
+    std::string prefix = (directory / "docs").string();
+    const uint32_t documents = 300;  // Several text blocks
+
+    {
+        DocStore store;
+        store.open(prefix, true);
+        for (uint32_t docId = 0; docId < documents; docId += 2) store.add(docId, makeDocument(docId));  // Gaps stay missing
+        store.flush();
+        for (uint32_t docId = 0; docId < documents; docId += 2) checkDocument(store, docId);
+        StoredDocument absent;
+        CHECK(!store.find(1, absent));
+        CHECK(!store.find(documents + 10, absent));
+    }
+
+    DocStore reopened;
+    reopened.open(prefix, false);
+    for (uint32_t docId = 0; docId < documents; docId += 2) checkDocument(reopened, docId);
+    reopened.add(1, makeDocument(1));  // Appending after a reopen keeps the earlier records
+    reopened.flush();
+    checkDocument(reopened, 1);
+    checkDocument(reopened, 0);
+
+    // Overwrites 4 or 8 bytes of a file at a position
+    auto patch = [](const std::string& file, uint64_t position, uint64_t value, size_t bytes) {
+        std::fstream stream(file, std::ios::binary | std::ios::in | std::ios::out);
+        char encoded[8];
+        std::memcpy(encoded, &value, sizeof(encoded));  // Little-endian hosts, like the store itself here
+        stream.seekp(static_cast<std::streamoff>(position));
+        stream.write(encoded, static_cast<std::streamsize>(bytes));
+    };
+    std::string index = prefix + ".idx", data = prefix + ".dat";
+    fs::copy_file(index, index + ".good");
+    patch(index, 0, uint64_t(1) << 60, 8);  // Offsets table claiming more entries than the file holds
+    bool rejected = false;
+    try {
+        DocStore damaged;
+        damaged.open(prefix, false);
+    } catch (const std::runtime_error&) {
+        rejected = true;
+    }
+    CHECK(rejected);
+    fs::copy_file(index + ".good", index, fs::copy_options::overwrite_existing);
+
+    uint64_t dataSize = fs::file_size(data);
+    patch(index, 8 + 2 * 8, dataSize + 100, 8);  // Document 2's record placed past the end of the data
+    {
+        DocStore damaged;
+        damaged.open(prefix, false);
+        StoredDocument found;
+        std::string text;
+        CHECK(!damaged.find(2, found));
+        CHECK(!damaged.text(2, text));
+        checkDocument(damaged, 4);
+    }
+    fs::copy_file(index + ".good", index, fs::copy_options::overwrite_existing);
+
+    uint64_t record;  // Offset of document 4's record, whose title length comes first
+    {
+        std::ifstream offsets(index, std::ios::binary);
+        offsets.seekg(8 + 4 * 8);
+        offsets.read(reinterpret_cast<char*>(&record), sizeof(record));
+    }
+    patch(data, record, 0xFFFFFFF0u, 4);  // A title longer than the data file
+    {
+        DocStore damaged;
+        damaged.open(prefix, false);
+        StoredDocument found;
+        std::string text;
+        CHECK(!damaged.find(4, found));
+        CHECK(!damaged.text(4, text));
+        checkDocument(damaged, 6);
+    }
+
+    patch(data, 12, 0xFFFFFF00u, 4);  // The first block's first text end, far past its raw size
+    {
+        DocStore damaged;
+        damaged.open(prefix, false);
+        StoredDocument found;
+        std::string text;
+        CHECK(damaged.find(0, found));  // The record itself is intact
+        CHECK(!damaged.text(0, text));
+    }
+    return 0;
+}
@@ -0,0 +1,35 @@
+// posting_list_test.cpp
+// Moved-from posting lists, in both layouts, read as empty lists and can be reused.
+#include "check.h" // Test assertions
+#include "posting_list.h" // The lists under test
+#include <utility> // For std::move
+
+int main() {
+    for (size_t n : {10, 5000, 100000}) {  // Array layout, just past the Roaring threshold, and well past it
+        PostingList source;
+        for (uint32_t i = 0; i < n; i++) source.add(i * 3, 1);
+        bool roaring = source.isRoaring();
+
+        PostingList constructed(std::move(source));
+        CHECK(constructed.size() == n && constructed.isRoaring() == roaring);
+        CHECK(source.size() == 0 && !source.isRoaring());
+        size_t visited = 0;
+        source.forEach([&](uint32_t, int) { visited++; });
+        CHECK(visited == 0);
+        CHECK(source.frequency(3) == 0);
+        source.add(7, 2);  // A moved-from list is usable again
+        CHECK(source.size() == 1 && source.frequency(7) == 2);
+
+        PostingList assigned;
+        assigned = std::move(constructed);
+        CHECK(assigned.size() == n && assigned.frequency(3) == 1);
+        CHECK(constructed.size() == 0 && !constructed.isRoaring());
+        constructed.forEach([&](uint32_t, int) { visited++; });
+        CHECK(visited == 0);
+
+        PostingList& alias = assigned;
+        assigned = std::move(alias);  // Self-move keeps the list
+        CHECK(assigned.size() == n && assigned.frequency(3 * (n - 1)) == 1);
+    }
+    return 0;
+}
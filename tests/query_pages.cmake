@@ -0,0 +1,40 @@
+# Pages through "supersearch query QUERY" LIMIT results at a time, following the printed cursors, and
+# fails unless the pages list the same files, in the same order, as a single page holding every result.
+# Usage: cmake -DSUPERSEARCH=<exe> -DQUERY=<query> -DLIMIT=<n> -DWORK=<indexed corpus> -P query_pages.cmake
+function(run_query output)
+    execute_process(COMMAND ${SUPERSEARCH} query ${QUERY} ${ARGN}
+                    WORKING_DIRECTORY ${WORK}
+                    OUTPUT_VARIABLE text
+                    RESULT_VARIABLE result
+                    TIMEOUT 60)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "supersearch query ${ARGN} exited with ${result}:\n${text}")
+    endif()
+    set(${output} "${text}" PARENT_SCOPE)
+endfunction()
+
+run_query(whole --limit 1000000)
+string(REGEX MATCHALL "File: [^\n]*" expected "${whole}")
+list(LENGTH expected total)
+if(total EQUAL 0)
+    message(FATAL_ERROR "\"${QUERY}\" matches nothing, so paging is not exercised")
+endif()
+
+set(paged "")
+set(after "")
+foreach(page RANGE ${total})
+    if(after STREQUAL "")
+        run_query(text --limit ${LIMIT})
+    else()
+        run_query(text --limit ${LIMIT} --after ${after})
+    endif()
+    string(REGEX MATCHALL "File: [^\n]*" files "${text}")
+    list(APPEND paged ${files})
+    if(NOT text MATCHES "Next page: --after ([^\n]*)")
+        break()
+    endif()
+    set(after "${CMAKE_MATCH_1}")
+endforeach()
+if(NOT paged STREQUAL expected)
+    message(FATAL_ERROR "Pages of ${LIMIT} differ from the whole result list of \"${QUERY}\"")
+endif()
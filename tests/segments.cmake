@@ -0,0 +1,74 @@
+# Builds one index in rounds, so new documents land in segments that the tiered policy merges, deletes
+# two documents and compacts it, and fails unless its queries match those of an index built in one go
+# with the same deletions. Document IDs differ between the two, so results are compared as sorted lists,
+# and prefixes are kept short of the expansion cap, which applies to every segment separately.
+# Usage: cmake -DSUPERSEARCH=<exe> -DCORPUS=<generated corpus> -DWORK=<dir> -P segments.cmake
+function(run directory)
+    execute_process(COMMAND ${SUPERSEARCH} ${ARGN}
+                    WORKING_DIRECTORY ${directory}
+                    OUTPUT_VARIABLE text
+                    ERROR_VARIABLE text
+                    RESULT_VARIABLE result
+                    TIMEOUT 120)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "supersearch ${ARGN} in ${directory} exited with ${result}:\n${text}")
+    endif()
+    set(output "${text}" PARENT_SCOPE)
+endfunction()
+
+file(GLOB files RELATIVE ${CORPUS} ${CORPUS}/part_0/*.json)
+list(LENGTH files total)
+if(NOT total EQUAL 300)
+    message(FATAL_ERROR "Expected 300 documents in ${CORPUS}")
+endif()
+list(SORT files)
+set(rounded ${WORK}/rounds)
+set(single ${WORK}/single)
+file(REMOVE_RECURSE ${rounded} ${single})
+
+# A base index of 100 documents, then ten rounds of 20 new ones: each round publishes a segment
+set(first 0)
+foreach(last 99 119 139 159 179 199 219 239 259 279 299)
+    foreach(i RANGE ${first} ${last})
+        list(GET files ${i} file)
+        configure_file(${CORPUS}/${file} ${rounded}/${file} COPYONLY)
+    endforeach()
+    run(${rounded} index ${rounded})
+    math(EXPR first "${last} + 1")
+endforeach()
+run(${rounded} stats)
+if(NOT output MATCHES "Terms: 300 documents, ([0-9]+) segments")
+    message(FATAL_ERROR "Expected 300 documents in segments:\n${output}")
+endif()
+if(CMAKE_MATCH_1 GREATER_EQUAL 10)
+    message(FATAL_ERROR "Expected the 10 segments to have been merged:\n${output}")
+endif()
+
+foreach(file ${files})
+    configure_file(${CORPUS}/${file} ${single}/${file} COPYONLY)
+endforeach()
+run(${single} index ${single})
+
+# The deleted documents are one from the base index and one from a segment
+list(GET files 5 base)
+list(GET files 150 segment)
+foreach(directory ${rounded} ${single})
+    run(${directory} delete ./${base})
+    run(${directory} delete ./${segment})
+endforeach()
+run(${rounded} compact)
+
+foreach(query "stock" "market -stock" "org:g*" "person:a*" "marke*")
+    run(${rounded} query ${query} --limit 1000000)
+    string(REGEX MATCHALL "File: [^\n]*" roundsFound "${output}")
+    run(${single} query ${query} --limit 1000000)
+    string(REGEX MATCHALL "File: [^\n]*" singleFound "${output}")
+    list(SORT roundsFound)
+    list(SORT singleFound)
+    if(NOT roundsFound OR NOT roundsFound STREQUAL singleFound)
+        message(FATAL_ERROR "\"${query}\" finds nothing or differs between the merged segments and a single build")
+    endif()
+    if(roundsFound MATCHES "${base}|${segment}")
+        message(FATAL_ERROR "\"${query}\" still finds a deleted document")
+    endif()
+endforeach()
@@ -0,0 +1,77 @@
+// sharded_index_test.cpp
+// Parallel insertion into a sharded index: several threads update overlapping keys at once, and the
+// result must match a serial reference, both for whole walks and for prefix walks merged across shards.
+// The index is then saved, and loading it on several threads, into any number of shards, must give
+// what one thread loads.
+// Usage: sharded_index_test <scratch directory>
+#include "check.h" // Test assertions
+#include "sharded_index.h" // The index under test
+#include <cstdio> // For formatting keys
+#include <filesystem> // For the scratch directory
+#include <map> // For the serial reference
+#include <string> // For keys
+#include <thread> // For the inserting threads
+#include <utility> // For std::pair
+#include <vector> // For threads and walks
+
+static std::string keyOf(uint32_t i) {
+    char key[16];
+    std::snprintf(key, sizeof(key), "k%05u", i);
+    return key;
+}
+
+using Nodes = std::vector<std::pair<std::string, uint32_t>>;  // (key, value) pairs in walk order
+
+// Every node of the index whose key starts with prefix
+static Nodes walk(const ShardedIndex<uint32_t>& index, const std::string& prefix) {
+    Nodes nodes;
+    index.forEachWithPrefix(prefix, [&](const AVLNode<uint32_t>& node) {
+        nodes.emplace_back(node.key, node.value);
+        return true;
+    });
+    return nodes;
+}
+
+namespace fs = std::filesystem;
+
+int main(int argc, char* argv[]) {
+    const uint32_t threads = 4, updates = 50000, keys = 20000;
+    auto keyFor = [&](uint32_t thread, uint32_t i) { return (i * 7919 + thread * 13) % keys; };  // Threads share keys
+
+    ShardedIndex<uint32_t> index(8);
+    std::vector<std::thread> writers;
+    for (uint32_t t = 0; t < threads; t++) {
+        writers.emplace_back([&, t]() {
+            for (uint32_t i = 0; i < updates; i++) {
+                index.update(keyOf(keyFor(t, i)), [&](const uint32_t* current) { return (current ? *current : 0) + t + 1; });
+            }
+        });
+    }
+    for (auto& writer : writers) writer.join();
+
+    std::map<std::string, uint32_t> expected;
+    for (uint32_t t = 0; t < threads; t++) {
+        for (uint32_t i = 0; i < updates; i++) expected[keyOf(keyFor(t, i))] += t + 1;
+    }
+
+    auto all = walk(index, "");
+    CHECK(all == Nodes(expected.begin(), expected.end()));
+    auto some = walk(index, "k123");
+    CHECK(some == Nodes(expected.lower_bound("k123"), expected.lower_bound("k124")));
+    CHECK(!some.empty());
+    uint32_t value = 0;
+    CHECK(index.find(keyOf(keyFor(0, 0)), value) && value == expected[keyOf(keyFor(0, 0))]);
+    CHECK(!index.find("absent", value));
+
+    fs::path directory = argc > 1 ? fs::path(argv[1]) : fs::temp_directory_path() / "sharded_index_test";
+    fs::remove_all(directory);
+    fs::create_directories(directory);
+    std::string file = (directory / "index.dat").string();
+    index.saveToFile(file);
+    ShardedIndex<uint32_t> serial(8), parallel(3);
+    serial.loadFromFile(file, 1);
+    parallel.loadFromFile(file, 4);
+    CHECK(walk(serial, "") == all);
+    CHECK(walk(parallel, "") == all);
+    return 0;
+}
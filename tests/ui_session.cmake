@@ -0,0 +1,17 @@
+# Runs "supersearch ui" with INPUT (lines separated by |) on standard input and fails unless it exits
+# cleanly and its output matches EXPECT.
+# Usage: cmake -DSUPERSEARCH=<exe> -DINPUT=<lines> -DEXPECT=<regex> -DWORK=<dir> -P ui_session.cmake
+string(REPLACE "|" "\n" lines "${INPUT}")
+file(WRITE ${WORK}/ui_input.txt "${lines}\n")
+execute_process(COMMAND ${SUPERSEARCH} ui
+                INPUT_FILE ${WORK}/ui_input.txt
+                OUTPUT_VARIABLE output
+                ERROR_VARIABLE output
+                RESULT_VARIABLE result
+                TIMEOUT 60)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "supersearch ui exited with ${result}:\n${output}")
+endif()
+if(NOT output MATCHES "${EXPECT}")
+    message(FATAL_ERROR "supersearch ui output does not match ${EXPECT}:\n${output}")
+endif()
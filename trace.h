@@ -0,0 +1,156 @@
+// trace.h
+#ifndef TRACE_H  // Include guard to prevent multiple inclusions of this header file
+#define TRACE_H
+
+// Scoped spans for diagnosing where time goes inside one build or query, exported in the Chrome trace
+// event format (load the file in Perfetto or chrome://tracing). Spans are compiled in only when
+// SUPERSEARCH_TRACING is defined; otherwise SUPERSEARCH_TRACE_SPAN expands to nothing and costs nothing.
+//
+//     void SearchEngine::parse(...) {
+//         SUPERSEARCH_TRACE_SPAN("SearchEngine::parse");  // Span names must be string literals
+//
+// Each thread appends finished spans to its own fixed-size ring buffer without locking, overwriting its
+// oldest spans once the ring is full, so long builds keep their most recent history.
+
+#ifdef SUPERSEARCH_TRACING
+
+#include <algorithm>  // For std::max
+#include <atomic>  // For the lock-free rings
+#include <chrono>  // For span timestamps
+#include <cstdint>  // For nanosecond timestamps
+#include <cstdio>  // For formatting timestamps
+#include <fstream>  // For writing trace files
+#include <memory>  // For rings that outlive their threads
+#include <mutex>  // For registering threads
+#include <ostream>  // For writing the trace
+#include <stdexcept>  // For reporting unwritable trace files
+#include <string>  // For file names
+#include <vector>  // For the ring registry
+
+class Tracer {
+public:
+    static constexpr size_t ringCapacity = 1 << 16;  // Spans kept per thread
+
+private:
+    struct Event {  // One finished span; fields are atomic so export may run while threads trace
+        std::atomic<const char*> name{nullptr};
+        std::atomic<uint64_t> start{0};  // Nanoseconds since the tracer started
+        std::atomic<uint64_t> duration{0};  // Nanoseconds
+    };
+
+    struct Ring {  // Written only by its thread
+        uint32_t threadId = 0;  // Small ID shown as the trace's thread
+        std::unique_ptr<Event[]> events{new Event[ringCapacity]};
+        std::atomic<uint64_t> written{0};  // Spans ever recorded; the next goes to written % ringCapacity
+    };
+
+    std::vector<std::shared_ptr<Ring>> rings;  // Every thread that has traced, including finished ones
+    std::mutex ringsLock;  // Guards rings while threads register
+    std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();  // Time zero of the trace
+
+    static Tracer& instance() {
+        static Tracer tracer;
+        return tracer;
+    }
+
+    // The calling thread's ring, registered on first use
+    static Ring& local() {
+        thread_local std::shared_ptr<Ring> ring = [] {
+            Tracer& tracer = instance();
+            auto created = std::make_shared<Ring>();
+            std::lock_guard<std::mutex> guard(tracer.ringsLock);
+            created->threadId = static_cast<uint32_t>(tracer.rings.size() + 1);
+            tracer.rings.push_back(created);
+            return created;
+        }();
+        return *ring;
+    }
+
+public:
+    // Nanoseconds since the tracer started
+    static uint64_t now() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - instance().epoch).count());
+    }
+
+    // Appends a finished span to the calling thread's ring
+    static void record(const char* name, uint64_t start, uint64_t end) {
+        Ring& ring = local();
+        uint64_t n = ring.written.load(std::memory_order_relaxed);
+        Event& event = ring.events[n % ringCapacity];
+        event.name.store(name, std::memory_order_relaxed);
+        event.start.store(start, std::memory_order_relaxed);
+        event.duration.store(end - start, std::memory_order_relaxed);
+        ring.written.store(n + 1, std::memory_order_release);
+    }
+
+    // Times the enclosing scope; use through SUPERSEARCH_TRACE_SPAN
+    class Span {
+    private:
+        const char* name;
+        uint64_t start;
+
+    public:
+        explicit Span(const char* spanName) : name(spanName), start(now()) {}
+        ~Span() { record(name, start, now()); }
+        Span(const Span&) = delete;
+        Span& operator=(const Span&) = delete;
+    };
+
+    // Writes every span still held by the rings as a Chrome trace JSON object. Spans a thread overwrote
+    // while they were being copied are dropped rather than written torn.
+    static void writeChromeTrace(std::ostream& out) {
+        Tracer& tracer = instance();
+        std::vector<std::shared_ptr<Ring>> snapshot;
+        {
+            std::lock_guard<std::mutex> guard(tracer.ringsLock);
+            snapshot = tracer.rings;
+        }
+        out << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [";
+        bool first = true;
+        char buffer[64];
+        for (const auto& ring : snapshot) {
+            uint64_t end = ring->written.load(std::memory_order_acquire);
+            uint64_t begin = end > ringCapacity ? end - ringCapacity : 0;
+            struct Copy { const char* name; uint64_t start, duration; };
+            std::vector<Copy> copies;
+            copies.reserve(static_cast<size_t>(end - begin));
+            for (uint64_t i = begin; i < end; i++) {
+                const Event& event = ring->events[i % ringCapacity];
+                copies.push_back({event.name.load(std::memory_order_relaxed), event.start.load(std::memory_order_relaxed),
+                                  event.duration.load(std::memory_order_relaxed)});
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            uint64_t after = ring->written.load(std::memory_order_relaxed);
+            uint64_t firstIntact = after > ringCapacity ? after - ringCapacity + 1 : 0;  // Older slots may have been reused
+            for (uint64_t i = std::max(begin, firstIntact); i < end; i++) {
+                const Copy& span = copies[static_cast<size_t>(i - begin)];
+                out << (first ? "\n" : ",\n") << "{\"name\": \"" << span.name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": "
+                    << ring->threadId;
+                std::snprintf(buffer, sizeof(buffer), ", \"ts\": %.3f, \"dur\": %.3f}", span.start / 1000.0, span.duration / 1000.0);
+                out << buffer;
+                first = false;
+            }
+        }
+        out << "\n]}\n";
+    }
+
+    // Writes the trace to a file
+    static void writeChromeTrace(const std::string& filename) {
+        std::ofstream out(filename);
+        writeChromeTrace(out);
+        if (!out) throw std::runtime_error("Cannot write trace " + filename);
+    }
+};
+
+#define SUPERSEARCH_TRACE_CONCAT_(a, b) a##b
+#define SUPERSEARCH_TRACE_CONCAT(a, b) SUPERSEARCH_TRACE_CONCAT_(a, b)
+#define SUPERSEARCH_TRACE_SPAN(name) Tracer::Span SUPERSEARCH_TRACE_CONCAT(traceSpan, __LINE__)(name)
+
+#else
+
+#define SUPERSEARCH_TRACE_SPAN(name) static_cast<void>(0)
+
+#endif
+
+#endif  // End of include guard